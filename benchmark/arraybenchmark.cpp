@@ -0,0 +1,103 @@
+// Array algorithms on packed int arrays from 1e3 to 1e8 items, serial and
+// parallel, to find where the parallel cutoffs in algorithms.h should be.
+// Times are in ns per item. The largest size can be given as an argument,
+// 1e8 items take about 2.5 GB while sorting
+
+#include "algorithms.h"
+#include "threadpool.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <vector>
+
+namespace {
+
+using vm::algorithms::Execution;
+
+template <typename F>
+double measure(int iterations, F f) {
+    auto best = std::chrono::duration<double>::max();
+    for (int i = 0; i < iterations; ++i) {
+        auto start = std::chrono::steady_clock::now();
+        f();
+        best = std::min<std::chrono::duration<double>>(
+            best, std::chrono::steady_clock::now() - start);
+    }
+    return best.count();
+}
+
+/// Every run sorts a new copy of `unsorted`
+template <typename F>
+double measureSort(int iterations, const vm::Array &unsorted, F sort) {
+    auto best = std::chrono::duration<double>::max();
+    for (int i = 0; i < iterations; ++i) {
+        auto array = unsorted;
+        auto start = std::chrono::steady_clock::now();
+        sort(array);
+        best = std::min<std::chrono::duration<double>>(
+            best, std::chrono::steady_clock::now() - start);
+    }
+    return best.count();
+}
+
+vm::Array randomInts(size_t size) {
+    auto random = std::mt19937_64{size};
+    auto array = vm::Array{};
+    for (size_t i = 0; i < size; ++i) {
+        array.push(vm::Int{static_cast<int64_t>(random() >> 16)});
+    }
+    return array;
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+    auto largest = argc > 1 ? std::atof(argv[1]) : 1e8;
+
+    std::cout << "threads: " << ThreadPool::global().size() << "\n";
+    std::cout << "ns per item    sort   psort stdsort     sum    psum"
+                 "     min   count\n";
+    std::cout << std::fixed << std::setprecision(2);
+
+    for (auto size = size_t{1000}; size <= largest; size *= 10) {
+        auto iterations = static_cast<int>(
+            std::clamp<size_t>(10'000'000 / size, 1, 20));
+        auto unsorted = randomInts(size);
+        auto item = vm::Value{vm::Int{42}};
+
+        auto sort = measureSort(iterations, unsorted, [](vm::Array &a) {
+            vm::algorithms::sort(a, Execution::Serial);
+        });
+        auto parallelSort =
+            measureSort(iterations, unsorted, [](vm::Array &a) {
+                vm::algorithms::sort(a, Execution::Parallel);
+            });
+        auto stdSort = measureSort(iterations, unsorted, [](vm::Array &a) {
+            std::ranges::sort(a.ints());
+        });
+        auto sum = measure(iterations, [&] {
+            vm::algorithms::sum(unsorted, Execution::Serial);
+        });
+        auto parallelSum = measure(iterations, [&] {
+            vm::algorithms::sum(unsorted, Execution::Parallel);
+        });
+        auto min = measure(iterations, [&] {
+            vm::algorithms::min(unsorted, Execution::Automatic);
+        });
+        auto count = measure(iterations, [&] {
+            vm::algorithms::count(unsorted, item, Execution::Automatic);
+        });
+
+        std::cout << std::setw(11) << size;
+        for (auto seconds :
+             {sort, parallelSort, stdSort, sum, parallelSum, min, count}) {
+            std::cout << std::setw(8) << seconds * 1e9 / size;
+        }
+        std::cout << "\n";
+    }
+
+    return 0;
+}
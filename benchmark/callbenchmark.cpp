@@ -0,0 +1,172 @@
+// Function calls with the syntax tree, the byte code interpreter and the jit: a
+// tight recursive script function, a hot loop that calls a native function
+// and a native iterator for every iteration, and native calls made directly
+// from C++. Also loops over `std.range` and arrays, which are run without
+// calls
+
+#include "bytecode.h"
+#include "parser.h"
+#include "tokenizer.h"
+#include <array>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <string_view>
+#include <vector>
+
+namespace {
+
+constexpr auto script = std::string_view{R"(
+fn fib(n) {
+    if (n < 2) {
+        return n;
+    }
+    return fib(n - 1) + fib(n - 2);
+}
+
+fn rangeLoop(n) {
+    let sum = 0;
+    for (let i in std.range(0, n)) {
+        sum += i;
+    }
+    return sum;
+}
+
+fn arrayLoop(values) {
+    let sum = 0;
+    for (let value in values) {
+        sum += value;
+    }
+    return sum;
+}
+
+let sum = 0;
+for (let i in counter) {
+    sum += std.abs(-1);
+}
+sum
+)"};
+
+template <typename F>
+double measure(int iterations, F f) {
+    auto best = std::chrono::duration<double>::max();
+    for (int i = 0; i < iterations; ++i) {
+        auto start = std::chrono::steady_clock::now();
+        f();
+        best = std::min<std::chrono::duration<double>>(
+            best, std::chrono::steady_clock::now() - start);
+    }
+    return best.count();
+}
+
+const auto left = Symbol{"left"};
+
+/// Iterator that the for loop runs `left` times. Loops end when `next`
+/// returns void
+vm::Ref<vm::Map> createCounter() {
+    auto counter = vm::make<vm::Map>();
+    (*counter)[left] = vm::Int{};
+    (*counter)[symbols::Next] = vm::make<vm::Function>(
+        std::vector<Symbol>{}, [](vm::Context &context) -> vm::Value {
+            auto &value = context.self().as<vm::Map>().at(left);
+            auto n = value.as<vm::Int>().value;
+            if (n <= 0) {
+                return {};
+            }
+            value = vm::Int{n - 1};
+            return vm::Int{n};
+        });
+    return counter;
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+    auto loops = argc > 1 ? std::atol(argv[1]) : 1'000'000;
+    auto fibArgument = argc > 2 ? std::atol(argv[2]) : 25;
+    auto iterations = 5;
+
+    auto arena = Arena{};
+    auto tokenizer = Tokenizer{script, "benchmark"};
+    auto module = parseRoot(tokenizer, arena);
+    auto counter = createCounter();
+    (*module)[symbols::Std] = vm::getStd();
+    (*module)[Symbol{"counter"}] = counter;
+
+    auto context = vm::Context{.closure = module.get()};
+    auto &main = module->at<vm::Function>(symbols::Main);
+    auto &fib = module->at<vm::Function>(Symbol{"fib"});
+    auto fibArguments = std::array{vm::Value{vm::Int{fibArgument}}};
+    auto &rangeLoop = module->at<vm::Function>(Symbol{"rangeLoop"});
+    auto rangeArguments = std::array{vm::Value{vm::Int{loops}}};
+    auto &arrayLoop = module->at<vm::Function>(Symbol{"arrayLoop"});
+    auto array = vm::make<vm::Array>();
+    for (long i = 0; i < loops; ++i) {
+        array->push(vm::Int{i});
+    }
+    auto arrayArguments = std::array{vm::Value{array}};
+    auto &abs = vm::getStd()->at<vm::Function>(symbols::Abs);
+    auto absArguments = std::array{vm::Value{vm::Int{-1}}};
+
+    auto interpreter = bytecode::Interpreter{};
+    auto jit = bytecode::Interpreter{bytecode::jit::Mode::Always};
+
+    auto loop = [&](auto &&call) {
+        counter->at(left) = vm::Int{loops};
+        call();
+    };
+
+    auto astLoop = measure(iterations, [&] {
+        loop([&] { vm::call(main, {}, context); });
+    });
+    auto bytecodeLoop = measure(iterations, [&] {
+        loop([&] { interpreter.call(main, {}, context); });
+    });
+    auto jitLoop = measure(iterations, [&] {
+        loop([&] { jit.call(main, {}, context); });
+    });
+    auto astFib = measure(
+        iterations, [&] { vm::call(fib, fibArguments, context); });
+    auto bytecodeFib = measure(
+        iterations, [&] { interpreter.call(fib, fibArguments, context); });
+    auto jitFib =
+        measure(iterations, [&] { jit.call(fib, fibArguments, context); });
+    auto astRange = measure(
+        iterations, [&] { vm::call(rangeLoop, rangeArguments, context); });
+    auto bytecodeRange = measure(iterations, [&] {
+        interpreter.call(rangeLoop, rangeArguments, context);
+    });
+    auto jitRange = measure(
+        iterations, [&] { jit.call(rangeLoop, rangeArguments, context); });
+    auto astArray = measure(
+        iterations, [&] { vm::call(arrayLoop, arrayArguments, context); });
+    auto bytecodeArray = measure(iterations, [&] {
+        interpreter.call(arrayLoop, arrayArguments, context);
+    });
+    auto jitArray = measure(
+        iterations, [&] { jit.call(arrayLoop, arrayArguments, context); });
+    auto nativeCalls = measure(iterations, [&] {
+        for (long i = 0; i < loops; ++i) {
+            vm::call(abs, absArguments, context);
+        }
+    });
+
+    std::cout << "loop iterations: " << loops << "\n";
+    std::cout << "ast loop:        " << astLoop << " s\n";
+    std::cout << "bytecode loop:   " << bytecodeLoop << " s\n";
+    std::cout << "jit loop:        " << jitLoop << " s\n";
+    std::cout << "ast range:       " << astRange << " s\n";
+    std::cout << "bytecode range:  " << bytecodeRange << " s\n";
+    std::cout << "jit range:       " << jitRange << " s\n";
+    std::cout << "ast array:       " << astArray << " s\n";
+    std::cout << "bytecode array:  " << bytecodeArray << " s\n";
+    std::cout << "jit array:       " << jitArray << " s\n";
+    std::cout << "fib(" << fibArgument << ")\n";
+    std::cout << "ast fib:         " << astFib << " s\n";
+    std::cout << "bytecode fib:    " << bytecodeFib << " s\n";
+    std::cout << "jit fib:         " << jitFib << " s\n";
+    std::cout << "native abs:      " << nativeCalls * 1e9 / loops
+              << " ns per call\n";
+
+    return 0;
+}
@@ -0,0 +1,81 @@
+// Histograms with Dictionary::increment, with int and string keys, against
+// std::unordered_map. Every run counts 1e7 items spread over 1e3 to 1e7
+// different keys. Times are in ns per item
+
+#include "dictionary.h"
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace {
+
+template <typename F>
+double measure(int iterations, F f) {
+    auto best = std::chrono::duration<double>::max();
+    for (int i = 0; i < iterations; ++i) {
+        auto start = std::chrono::steady_clock::now();
+        f();
+        best = std::min<std::chrono::duration<double>>(
+            best, std::chrono::steady_clock::now() - start);
+    }
+    return best.count();
+}
+
+constexpr size_t itemCount = 10'000'000;
+
+} // namespace
+
+int main() {
+    std::cout << "ns per item   dict int  std int  dict str     keys\n";
+    std::cout << std::fixed << std::setprecision(2);
+
+    for (auto keyCount = size_t{1000}; keyCount <= itemCount; keyCount *= 10) {
+        auto random = std::mt19937_64{keyCount};
+        auto ints = std::vector<vm::Value>{};
+        auto numbers = std::vector<int64_t>{};
+        auto strings = std::vector<vm::Value>{};
+        for (size_t i = 0; i < itemCount; ++i) {
+            auto key = static_cast<int64_t>(random() % keyCount);
+            ints.push_back(vm::Int{key});
+            numbers.push_back(key);
+        }
+        // Fewer strings, since every one is an object
+        for (size_t i = 0; i < itemCount / 10; ++i) {
+            strings.push_back(vm::String{"key" + std::to_string(numbers[i])});
+        }
+
+        auto keys = size_t{};
+        auto dictionaryInts = measure(3, [&] {
+            auto histogram = vm::make<vm::Dictionary>();
+            for (auto &key : ints) {
+                histogram->increment(key);
+            }
+            keys = histogram->size();
+        });
+        auto stdInts = measure(3, [&] {
+            auto histogram = std::unordered_map<int64_t, int64_t>{};
+            for (auto key : numbers) {
+                ++histogram[key];
+            }
+        });
+        auto dictionaryStrings = measure(3, [&] {
+            auto histogram = vm::make<vm::Dictionary>();
+            for (auto &key : strings) {
+                histogram->increment(key);
+            }
+        });
+
+        std::cout << std::setw(11) << keyCount << std::setw(11)
+                  << dictionaryInts * 1e9 / ints.size() << std::setw(9)
+                  << stdInts * 1e9 / numbers.size() << std::setw(10)
+                  << dictionaryStrings * 1e9 / strings.size() << std::setw(9)
+                  << keys << "\n";
+    }
+
+    return 0;
+}
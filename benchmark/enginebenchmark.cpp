@@ -0,0 +1,89 @@
+// Run the same generated script with the syntax tree interpreter and with the
+// byte code interpreter
+
+#include "bytecode.h"
+#include "parser.h"
+#include "tokenizer.h"
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace {
+
+std::string generateScript(size_t repetitions) {
+    auto script = std::string{"let a = 1;\nlet b = 2.5;\nlet sum = 0;\n"};
+    for (size_t i = 0; i < repetitions; ++i) {
+        script += "sum += a * b - (a - 1) / 2;\n";
+        script += "a = a + 1;\n";
+        script += "b -= 0.5;\n";
+    }
+    return script;
+}
+
+template <typename F>
+double measure(int iterations, F f) {
+    auto best = std::chrono::duration<double>::max();
+    for (int i = 0; i < iterations; ++i) {
+        auto start = std::chrono::steady_clock::now();
+        f();
+        best = std::min<std::chrono::duration<double>>(
+            best, std::chrono::steady_clock::now() - start);
+    }
+    return best.count();
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+    auto repetitions = argc > 1 ? std::atol(argv[1]) : 100'000;
+    auto iterations = 5;
+
+    auto script = generateScript(repetitions);
+
+    auto arena = Arena{};
+    auto tokenizer = Tokenizer{std::string_view{script}, "benchmark"};
+    auto module = parseRoot(tokenizer, arena);
+    auto &main = module->at<vm::Function>(symbols::Main);
+
+    // Each run gets a fresh module scope so the variables are created again
+    auto run = [&](auto &&call) {
+        auto scope = vm::Map{};
+        auto slots = std::vector<vm::Value>(main.body->slotCount);
+        auto context = vm::Context{.closure = &scope, .slots = slots};
+        return call(context);
+    };
+
+    auto astResult = vm::Value{};
+    auto astTime = measure(iterations, [&] {
+        run([&](vm::Context &context) {
+            astResult = vm::call(main, {}, context);
+        });
+    });
+
+    auto compileTime =
+        measure(iterations, [&] { bytecode::compile(*main.body); });
+
+    auto chunk = bytecode::compile(*main.body);
+    auto interpreter = bytecode::Interpreter{};
+    auto bytecodeResult = vm::Value{};
+    auto bytecodeTime = measure(iterations, [&] {
+        run([&](vm::Context &context) {
+            bytecodeResult = interpreter.run(chunk, context);
+        });
+    });
+
+    if (vm::binaryOperation(TokenType::ExclaimEqual, astResult, bytecodeResult)
+            .asBool()) {
+        std::cerr << "the engines gave different results\n";
+        return 1;
+    }
+
+    std::cout << "statements:       " << repetitions * 3 << "\n";
+    std::cout << "ast:              " << astTime << " s\n";
+    std::cout << "bytecode:         " << bytecodeTime << " s\n";
+    std::cout << "bytecode compile: " << compileTime << " s\n";
+
+    return 0;
+}
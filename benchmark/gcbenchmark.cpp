@@ -0,0 +1,75 @@
+// Allocation and garbage collection: short lived strings like the lines of a
+// file, maps in reference cycles that only the collector can free, and the
+// pause of a full collection with a large live heap
+
+#include "gc.h"
+#include "vm.h"
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+
+namespace {
+
+template <typename F>
+double measure(int iterations, F f) {
+    auto best = std::chrono::duration<double>::max();
+    for (int i = 0; i < iterations; ++i) {
+        auto start = std::chrono::steady_clock::now();
+        f();
+        best = std::min<std::chrono::duration<double>>(
+            best, std::chrono::steady_clock::now() - start);
+    }
+    return best.count();
+}
+
+const auto other = Symbol{"other"};
+
+/// Two maps that reference each other, and are leaked by reference counting
+void makeCycle() {
+    auto a = vm::make<vm::Map>();
+    auto b = vm::make<vm::Map>();
+    (*a)[other] = b;
+    (*b)[other] = a;
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+    auto count = argc > 1 ? std::atol(argv[1]) : 1'000'000;
+    auto liveCount = argc > 2 ? std::atol(argv[2]) : 100'000;
+    auto iterations = 5;
+
+    auto strings = measure(iterations, [&] {
+        for (long i = 0; i < count; ++i) {
+            auto value = vm::Value{vm::String{"a line of text"}};
+        }
+    });
+
+    auto cycles = measure(iterations, [&] {
+        for (long i = 0; i < count; ++i) {
+            makeCycle();
+        }
+        vm::gc::collect();
+    });
+
+    auto live = vm::make<vm::Array>();
+    for (long i = 0; i < liveCount; ++i) {
+        auto map = vm::make<vm::Map>();
+        (*map)[other] = live;
+        live->push(map);
+    }
+    auto youngPause = measure(iterations, [] { vm::gc::collect(0); });
+    auto fullPause = measure(iterations, [] { vm::gc::collect(); });
+
+    std::cout << "objects:         " << count << "\n";
+    std::cout << "strings:         " << strings * 1e9 / count
+              << " ns per string\n";
+    std::cout << "cycles:          " << cycles * 1e9 / count
+              << " ns per cycle\n";
+    std::cout << "live containers: " << liveCount + 1 << "\n";
+    std::cout << "young pause:     " << youngPause * 1e3 << " ms\n";
+    std::cout << "full pause:      " << fullPause * 1e3 << " ms\n";
+    vm::gc::printStats(std::cout);
+
+    return 0;
+}
@@ -0,0 +1,121 @@
+// Compare parsing through the virtual `TokenIterator` interface with the
+// statically dispatched `Tokenizer` path on a large generated script, and
+// measure the time it takes to free the syntax tree and to load it from the
+// module cache instead
+
+#include "modulecache.h"
+#include "parser.h"
+#include "tokenizer.h"
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <type_traits>
+
+namespace {
+
+std::string generateScript(size_t repetitions) {
+    auto script = std::string{};
+    for (size_t i = 0; i < repetitions; ++i) {
+        // Reuse names like a real script would
+        auto n = std::to_string(i % 1000);
+        script += "let value" + n + " = \"some text " + n + "\";\n";
+        script += "std.println(\"line\", value" + n + ");\n";
+        script += "for (let line in file.lines()) {\n";
+        script += "    v" + n + ".push(line);\n";
+        script += "}\n";
+    }
+    return script;
+}
+
+/// Best time of all iterations. If `f` returns a duration that is used instead
+/// of the time for the whole call
+template <typename F>
+double measure(int iterations, F f) {
+    auto best = std::chrono::duration<double>::max();
+    for (int i = 0; i < iterations; ++i) {
+        auto start = std::chrono::steady_clock::now();
+        auto duration = std::chrono::duration<double>{};
+        if constexpr (std::is_void_v<decltype(f())>) {
+            f();
+            duration = std::chrono::steady_clock::now() - start;
+        }
+        else {
+            duration = f();
+        }
+        best = std::min(best, duration);
+    }
+    return best.count();
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+    auto repetitions = argc > 1 ? std::atol(argv[1]) : 200'000;
+    auto iterations = 5;
+
+    auto script = generateScript(repetitions);
+    auto megabytes = static_cast<double>(script.size()) / 1'000'000.;
+
+    std::cout << "script size: " << megabytes << " MB\n";
+
+    auto virtualTime = measure(iterations, [&] {
+        auto arena = Arena{};
+        auto tokenizer = Tokenizer{std::string_view{script}, "benchmark"};
+        auto &it = static_cast<TokenIterator &>(tokenizer);
+        auto module = parseRoot(it, arena);
+    });
+
+    auto staticTime = measure(iterations, [&] {
+        auto arena = Arena{};
+        auto tokenizer = Tokenizer{std::string_view{script}, "benchmark"};
+        auto module = parseRoot(tokenizer, arena);
+    });
+
+    auto teardownTime = measure(iterations, [&] {
+        auto arena = std::make_unique<Arena>();
+        auto tokenizer = Tokenizer{std::string_view{script}, "benchmark"};
+        auto module = parseRoot(tokenizer, *arena);
+
+        auto start = std::chrono::steady_clock::now();
+        module = nullptr;
+        arena.reset();
+        return std::chrono::steady_clock::now() - start;
+    });
+
+    auto source = SourceBuffer::borrow(script);
+    auto cachePath =
+        std::filesystem::temp_directory_path() / "parse-benchmark.cache";
+    {
+        auto arena = Arena{};
+        auto tokenizer = Tokenizer{source, "benchmark"};
+        auto module = parseRoot(tokenizer, arena);
+        if (!modulecache::save(cachePath, *source, *module)) {
+            std::cerr << "could not write " << cachePath << "\n";
+            return 1;
+        }
+    }
+
+    auto cacheTime = measure(iterations, [&] {
+        auto arena = Arena{};
+        auto module =
+            modulecache::load(cachePath, source, "benchmark", arena);
+        if (!module) {
+            std::cerr << "could not load " << cachePath << "\n";
+            std::exit(1);
+        }
+    });
+
+    std::filesystem::remove(cachePath);
+
+    std::cout << "virtual TokenIterator: " << virtualTime << " s ("
+              << megabytes / virtualTime << " MB/s)\n";
+    std::cout << "static Tokenizer:      " << staticTime << " s ("
+              << megabytes / staticTime << " MB/s)\n";
+    std::cout << "free syntax tree:      " << teardownTime << " s\n";
+    std::cout << "load module cache:     " << cacheTime << " s\n";
+
+    return 0;
+}
@@ -0,0 +1,125 @@
+// Fill, sum and copy large arrays, to show the size of vm::Value, the cost of
+// creating and copying values, and what packed arrays save over arrays of
+// Values
+
+#include "vm.h"
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <numeric>
+#include <string>
+
+namespace {
+
+template <typename F>
+double measure(int iterations, F f) {
+    auto best = std::chrono::duration<double>::max();
+    for (int i = 0; i < iterations; ++i) {
+        auto start = std::chrono::steady_clock::now();
+        f();
+        best = std::min<std::chrono::duration<double>>(
+            best, std::chrono::steady_clock::now() - start);
+    }
+    return best.count();
+}
+
+/// A leading Bool keeps the array from being packed
+template <typename T>
+vm::Array fill(size_t size, bool packed = true) {
+    auto array = vm::Array{};
+    if (!packed) {
+        array.push(vm::Bool{});
+    }
+    for (size_t i = 0; i < size; ++i) {
+        array.push(T{static_cast<decltype(T{}.value)>(i)});
+    }
+    return array;
+}
+
+vm::Array fillStrings(size_t size, bool packed = true) {
+    auto array = vm::Array{};
+    if (!packed) {
+        array.push(vm::Bool{});
+    }
+    for (size_t i = 0; i < size; ++i) {
+        array.push(vm::String{std::to_string(i)});
+    }
+    return array;
+}
+
+vm::Value sum(const vm::Array &array) {
+    auto sum = vm::Value{vm::Int{}};
+    for (size_t i = 0; i < array.size(); ++i) {
+        sum = vm::binaryOperation(TokenType::Plus, sum, array.at(i));
+    }
+    return sum;
+}
+
+/// Keeps the packed sum from being optimized away
+volatile int64_t packedSum = 0;
+
+void sumPacked(const vm::Array &array) {
+    auto values = array.ints();
+    packedSum = std::accumulate(values.begin(), values.end(), int64_t{});
+}
+
+/// Strings that are objects are counted with the object, and with the heap
+/// buffer of the ones that are too long for the small string buffer
+double megabytes(const vm::Array &array) {
+    auto bytes = array.memory();
+    if (array.storage() == vm::Array::Storage::Values) {
+        for (size_t i = 0; i < array.size(); ++i) {
+            auto item = array.at(i);
+            if (item.is<vm::String>()) {
+                auto &text = item.as<vm::String>().value;
+                bytes += sizeof(vm::StringObject);
+                if (text.capacity() > std::string{}.capacity()) {
+                    bytes += text.capacity() + 1;
+                }
+            }
+        }
+    }
+    return bytes / 1e6;
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+    auto size = argc > 1 ? std::atol(argv[1]) : 10'000'000;
+    auto iterations = 5;
+
+    auto ints = fill<vm::Int>(size);
+    auto floats = fill<vm::Float>(size);
+    auto mixed = fill<vm::Int>(size, false);
+    auto strings = fillStrings(size);
+    auto mixedStrings = fillStrings(size, false);
+
+    std::cout << "values:           " << size << "\n";
+    std::cout << "sizeof Value:     " << sizeof(vm::Value) << " bytes\n";
+    std::cout << "int array:        " << megabytes(ints) << " MB\n";
+    std::cout << "mixed int array:  " << megabytes(mixed) << " MB\n";
+    std::cout << "string array:     " << megabytes(strings) << " MB\n";
+    std::cout << "mixed strings:    " << megabytes(mixedStrings) << " MB\n";
+    std::cout << "fill ints:        "
+              << measure(iterations, [&] { fill<vm::Int>(size); }) << " s\n";
+    std::cout << "fill mixed:       "
+              << measure(iterations, [&] { fill<vm::Int>(size, false); })
+              << " s\n";
+    std::cout << "fill floats:      "
+              << measure(iterations, [&] { fill<vm::Float>(size); })
+              << " s\n";
+    std::cout << "sum ints:         "
+              << measure(iterations, [&] { sum(ints); }) << " s\n";
+    std::cout << "sum mixed:        "
+              << measure(iterations, [&] { sum(mixed); }) << " s\n";
+    std::cout << "sum packed ints:  "
+              << measure(iterations, [&] { sumPacked(ints); }) << " s\n";
+    std::cout << "sum floats:       "
+              << measure(iterations, [&] { sum(floats); }) << " s\n";
+    std::cout << "copy ints:        "
+              << measure(iterations, [&] { auto copy = ints; }) << " s\n";
+    std::cout << "copy mixed:       "
+              << measure(iterations, [&] { auto copy = mixed; }) << " s\n";
+
+    return 0;
+}
@@ -0,0 +1,402 @@
+#include "algorithms.h"
+#include "threadpool.h"
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <functional>
+#include <numeric>
+#include <ranges>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace vm::algorithms {
+
+namespace {
+
+using Storage = Array::Storage;
+
+/// Below this std::sort is faster than the radix sort
+constexpr size_t radixSortCutoff = 256;
+
+bool inParallel(size_t size, size_t cutoff, Execution execution) {
+    switch (execution) {
+    case Execution::Serial:
+        return false;
+    case Execution::Parallel:
+        return true;
+    default:
+        return size >= cutoff && ThreadPool::global().size() > 1;
+    }
+}
+
+/// One part per thread. Part `i` is [bounds[i], bounds[i + 1])
+std::vector<size_t> partition(size_t size) {
+    auto parts = std::clamp<size_t>(ThreadPool::global().size(), 1, size);
+    auto bounds = std::vector<size_t>(parts + 1);
+    for (size_t i = 0; i <= parts; ++i) {
+        bounds[i] = size * i / parts;
+    }
+    return bounds;
+}
+
+/// `f(part)` for one part of `items` per thread, or for all of them at once
+template <typename T, typename F>
+auto reduceParts(std::span<const T> items, bool parallel, F f) {
+    using Result = decltype(f(items));
+    if (!parallel || items.empty()) {
+        return std::vector<Result>{f(items)};
+    }
+
+    auto bounds = partition(items.size());
+    auto results = std::vector<Result>(bounds.size() - 1);
+    ThreadPool::global().parallelFor(results.size(), [&](size_t i) {
+        results[i] = f(items.subspan(bounds[i], bounds[i + 1] - bounds[i]));
+    });
+    return results;
+}
+
+/// Sort one part per thread, then merge neighbouring parts in parallel until
+/// one is left
+template <typename T, typename Sort, typename Less>
+void parallelSort(std::span<T> items, Sort sortPart, Less less) {
+    auto bounds = partition(items.size());
+    auto parts = bounds.size() - 1;
+    ThreadPool::global().parallelFor(parts, [&](size_t i) {
+        sortPart(items.subspan(bounds[i], bounds[i + 1] - bounds[i]));
+    });
+
+    auto buffer = std::vector<T>(items.size());
+    auto from = items;
+    auto to = std::span{buffer};
+    for (size_t width = 1; width < parts; width *= 2) {
+        auto merges = (parts + 2 * width - 1) / (2 * width);
+        ThreadPool::global().parallelFor(merges, [&](size_t i) {
+            auto first = bounds[i * 2 * width];
+            auto middle = bounds[std::min(i * 2 * width + width, parts)];
+            auto last = bounds[std::min(i * 2 * width + 2 * width, parts)];
+            std::merge(from.begin() + first,
+                       from.begin() + middle,
+                       from.begin() + middle,
+                       from.begin() + last,
+                       to.begin() + first,
+                       less);
+        });
+        std::swap(from, to);
+    }
+
+    if (from.data() != items.data()) {
+        std::ranges::copy(from, items.begin());
+    }
+}
+
+/// Orders NaN last, so that sorting floats is well defined
+bool floatLess(double a, double b) {
+    return a < b || (std::isnan(b) && !std::isnan(a));
+}
+
+void sortInts(std::span<int64_t> ints) {
+    if (ints.size() < radixSortCutoff) {
+        std::ranges::sort(ints);
+    }
+    else {
+        radixSort(ints);
+    }
+}
+
+void sortFloats(std::span<double> floats) {
+    std::ranges::sort(floats, floatLess);
+}
+
+bool isNan(const Value &value) {
+    return value.is<Float>() && std::isnan(value.as<Float>().value);
+}
+
+bool isNumber(const Value &value) {
+    return value.is<Int>() || value.is<Float>();
+}
+
+/// Script `<`, with NaN ordered after the other numbers like `floatLess`.
+/// Plain `<` is false for NaN, which is not a strict weak ordering
+bool less(const Value &a, const Value &b) {
+    if (isNan(b) && isNumber(a)) {
+        return !isNan(a);
+    }
+    if (isNan(a) && isNumber(b)) {
+        return false;
+    }
+    return binaryOperation(TokenType::Less, a, b).asBool();
+}
+
+/// `<` for packed numbers and for Values, or `>` if `greater`
+template <bool greater>
+struct Compare {
+    template <typename T>
+    bool operator()(const T &a, const T &b) const {
+        if constexpr (std::same_as<T, Value>) {
+            return greater ? less(b, a) : less(a, b);
+        }
+        else {
+            return greater ? b < a : a < b;
+        }
+    }
+};
+
+/// Sorting the positions keeps the array as it was if `<` throws
+template <typename Less>
+void sortByOrder(Array &array, Less itemLess) {
+    auto order = std::vector<size_t>(array.size());
+    std::iota(order.begin(), order.end(), size_t{0});
+    std::ranges::sort(order, itemLess);
+    array.permute(order);
+}
+
+/// The item that `better` prefers over all the others
+template <typename Better>
+Value extreme(const Array &array, Execution execution, Better better) {
+    if (!array.size()) {
+        throw std::runtime_error{"array is empty"};
+    }
+
+    auto parallel = inParallel(array.size(), parallelReduceCutoff, execution);
+    auto pick = [better](auto part) {
+        return *std::ranges::min_element(part, better);
+    };
+
+    switch (array.storage()) {
+    case Storage::Int: {
+        auto parts = reduceParts(array.ints(), parallel, pick);
+        return Int{std::ranges::min(parts, better)};
+    }
+    case Storage::Float: {
+        auto parts = reduceParts(array.floats(), parallel, pick);
+        return Float{std::ranges::min(parts, better)};
+    }
+    default: {
+        auto result = array.at(0);
+        for (size_t i = 1; i < array.size(); ++i) {
+            auto item = array.at(i);
+            if (better(item, result)) {
+                result = std::move(item);
+            }
+        }
+        return result;
+    }
+    }
+}
+
+} // namespace
+
+void radixSort(std::span<int64_t> values) {
+    if (values.size() < 2) {
+        return;
+    }
+
+    // Flipping the sign bit orders the values as unsigned keys
+    constexpr auto sign = uint64_t{1} << 63;
+    auto keys = std::span{reinterpret_cast<uint64_t *>(values.data()),
+                          values.size()};
+
+    auto counts = std::array<std::array<size_t, 256>, 8>{};
+    for (auto &key : keys) {
+        key ^= sign;
+        for (size_t byte = 0; byte < 8; ++byte) {
+            ++counts[byte][(key >> (8 * byte)) & 0xff];
+        }
+    }
+
+    auto buffer = std::vector<uint64_t>(keys.size());
+    auto from = keys;
+    auto to = std::span{buffer};
+    for (size_t byte = 0; byte < 8; ++byte) {
+        auto shift = 8 * byte;
+        auto &count = counts[byte];
+        if (count[(from.front() >> shift) & 0xff] == keys.size()) {
+            continue;
+        }
+
+        auto offsets = std::array<size_t, 256>{};
+        std::exclusive_scan(
+            count.begin(), count.end(), offsets.begin(), size_t{0});
+        for (auto key : from) {
+            to[offsets[(key >> shift) & 0xff]++] = key;
+        }
+        std::swap(from, to);
+    }
+
+    if (from.data() != keys.data()) {
+        std::ranges::copy(from, keys.begin());
+    }
+    for (auto &key : keys) {
+        key ^= sign;
+    }
+}
+
+void sort(Array &array, Execution execution) {
+    auto parallel = inParallel(array.size(), parallelSortCutoff, execution);
+
+    switch (array.storage()) {
+    case Storage::Empty:
+        return;
+    case Storage::Int:
+        if (parallel) {
+            parallelSort(array.ints(), sortInts, std::less<int64_t>{});
+        }
+        else {
+            sortInts(array.ints());
+        }
+        return;
+    case Storage::Float:
+        if (parallel) {
+            parallelSort(array.floats(), sortFloats, floatLess);
+        }
+        else {
+            sortFloats(array.floats());
+        }
+        return;
+    case Storage::String:
+        sortByOrder(array, [&array](size_t a, size_t b) {
+            return array.string(a) < array.string(b);
+        });
+        return;
+    case Storage::Values: {
+        auto values = array.values();
+        sortByOrder(array, [values](size_t a, size_t b) {
+            return less(values[a], values[b]);
+        });
+        return;
+    }
+    }
+}
+
+Value sum(const Array &array, Execution execution) {
+    auto parallel = inParallel(array.size(), parallelReduceCutoff, execution);
+
+    switch (array.storage()) {
+    case Storage::Empty:
+        return Int{};
+    case Storage::Int: {
+        // Unsigned, so that overflow wraps around like the Int operators
+        auto parts = reduceParts(array.ints(), parallel, [](auto part) {
+            return std::accumulate(part.begin(), part.end(), uint64_t{});
+        });
+        auto total = std::accumulate(parts.begin(), parts.end(), uint64_t{});
+        return Int{static_cast<int64_t>(total)};
+    }
+    case Storage::Float: {
+        auto parts = reduceParts(array.floats(), parallel, [](auto part) {
+            return std::accumulate(part.begin(), part.end(), 0.);
+        });
+        return Float{std::accumulate(parts.begin(), parts.end(), 0.)};
+    }
+    default: {
+        auto total = array.at(0);
+        for (size_t i = 1; i < array.size(); ++i) {
+            total = binaryOperation(TokenType::Plus, total, array.at(i));
+        }
+        return total;
+    }
+    }
+}
+
+Value min(const Array &array, Execution execution) {
+    return extreme(array, execution, Compare<false>{});
+}
+
+Value max(const Array &array, Execution execution) {
+    return extreme(array, execution, Compare<true>{});
+}
+
+size_t count(const Array &array, const Value &value, Execution execution) {
+    auto parallel = inParallel(array.size(), parallelReduceCutoff, execution);
+    auto countParts = [parallel](auto items, auto item) {
+        auto parts = reduceParts(items, parallel, [item](auto part) {
+            return static_cast<size_t>(std::ranges::count(part, item));
+        });
+        return std::accumulate(parts.begin(), parts.end(), size_t{});
+    };
+
+    switch (array.storage()) {
+    case Storage::Empty:
+        return 0;
+    case Storage::Int:
+        return value.is<Int>() ? countParts(array.ints(), value.as<Int>().value)
+                               : 0;
+    case Storage::Float:
+        return value.is<Float>()
+                   ? countParts(array.floats(), value.as<Float>().value)
+                   : 0;
+    case Storage::String: {
+        if (!value.is<String>()) {
+            return 0;
+        }
+        auto &text = value.as<String>().value;
+        auto n = size_t{0};
+        for (size_t i = 0; i < array.size(); ++i) {
+            n += array.string(i) == text;
+        }
+        return n;
+    }
+    case Storage::Values:
+        return static_cast<size_t>(
+            std::ranges::count_if(array.values(), [&value](auto &item) {
+                return same(item, value);
+            }));
+    }
+    return 0;
+}
+
+bool binarySearch(const Array &array, const Value &value) {
+    switch (array.storage()) {
+    case Storage::Empty:
+        return false;
+    case Storage::Int:
+        return value.is<Int>() &&
+               std::ranges::binary_search(array.ints(), value.as<Int>().value);
+    case Storage::Float:
+        return value.is<Float>() &&
+               std::ranges::binary_search(
+                   array.floats(), value.as<Float>().value, floatLess);
+    case Storage::String: {
+        if (!value.is<String>()) {
+            return false;
+        }
+        auto text = std::string_view{value.as<String>().value};
+        auto positions = std::views::iota(size_t{0}, array.size());
+        return std::ranges::binary_search(
+            positions, text, std::less<>{}, [&array](size_t i) {
+                return array.string(i);
+            });
+    }
+    case Storage::Values: {
+        auto values = array.values();
+        auto found = std::ranges::lower_bound(values, value, less);
+        return found != values.end() && !less(value, *found);
+    }
+    }
+    return false;
+}
+
+Ref<Array> zip(const Array &a, const Array &b) {
+    auto result = make<Array>();
+    auto size = std::min(a.size(), b.size());
+    for (size_t i = 0; i < size; ++i) {
+        auto pair = make<Array>();
+        pair->push(a.at(i));
+        pair->push(b.at(i));
+        result->push(std::move(pair));
+    }
+    return result;
+}
+
+Ref<Array> map(const Array &array, const Function &f, Context &context) {
+    auto result = make<Array>();
+    for (size_t i = 0; i < array.size(); ++i) {
+        auto item = array.at(i);
+        result->push(call(f, std::span{&item, 1}, context));
+    }
+    return result;
+}
+
+} // namespace vm::algorithms
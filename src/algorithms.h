@@ -0,0 +1,56 @@
+#pragma once
+
+#include "vm.h"
+#include <cstddef>
+#include <cstdint>
+#include <span>
+
+// Algorithms behind the array methods. Packed arrays are worked on as plain
+// numbers, and large ones are split over the global thread pool. Other threads
+// only ever see the packed numbers, since Values and their reference counts
+// belong to the thread that made them
+
+namespace vm::algorithms {
+
+enum class Execution {
+    /// Parallel when the array is larger than the cutoff and there is more
+    /// than one thread
+    Automatic,
+    Serial,
+    Parallel,
+};
+
+/// Items where the parallel variants take over, see array-benchmark
+constexpr size_t parallelSortCutoff = size_t{1} << 17;
+constexpr size_t parallelReduceCutoff = size_t{1} << 18;
+
+/// Ascending. Ints are radix sorted, floats and strings are sorted with
+/// std::sort, and other values are compared with `<`
+void sort(Array &array, Execution execution = Execution::Automatic);
+
+/// Int 0 for empty arrays
+Value sum(const Array &array, Execution execution = Execution::Automatic);
+
+/// Throws for empty arrays
+Value min(const Array &array, Execution execution = Execution::Automatic);
+Value max(const Array &array, Execution execution = Execution::Automatic);
+
+/// Items equal to `value` and of the same type
+size_t count(const Array &array,
+             const Value &value,
+             Execution execution = Execution::Automatic);
+
+/// Search an array that is sorted with `sort`
+bool binarySearch(const Array &array, const Value &value);
+
+/// Pairs of the items at the same positions, as long as the shortest array
+Ref<Array> zip(const Array &a, const Array &b);
+
+/// Results of calling `f` with each item
+Ref<Array> map(const Array &array, const Function &f, Context &context);
+
+/// LSD radix sort, one byte at a time. Bytes that are the same in all values
+/// are skipped
+void radixSort(std::span<int64_t> values);
+
+} // namespace vm::algorithms
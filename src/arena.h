@@ -0,0 +1,117 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <span>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+/// Allocates objects back to back in large blocks and frees all of them at
+/// once when the arena is destroyed. Objects are never freed individually, and
+/// pointers to them are valid for the lifetime of the arena
+class Arena {
+public:
+    Arena(const Arena &) = delete;
+    Arena(Arena &&) = delete;
+    Arena &operator=(const Arena &) = delete;
+    Arena &operator=(Arena &&) = delete;
+
+    Arena() = default;
+
+    ~Arena() {
+        for (auto it = _destructors.rbegin(); it != _destructors.rend(); ++it) {
+            it->destroy(it->object);
+        }
+    }
+
+    template <typename T, typename... Args>
+    T *create(Args &&...args) {
+        auto object = new (allocate(sizeof(T), alignof(T)))
+            T(std::forward<Args>(args)...);
+        if constexpr (!std::is_trivially_destructible_v<T>) {
+            _destructors.push_back({
+                .destroy = [](void *p) { static_cast<T *>(p)->~T(); },
+                .object = object,
+            });
+        }
+        return object;
+    }
+
+    /// Copy a range into the arena. Used for lists of child nodes
+    template <typename T>
+    std::span<T> copy(std::span<const T> source) {
+        static_assert(std::is_trivially_destructible_v<T>);
+        if (source.empty()) {
+            return {};
+        }
+        auto data = static_cast<T *>(
+            allocate(sizeof(T) * source.size(), alignof(T)));
+        std::uninitialized_copy(source.begin(), source.end(), data);
+        return {data, source.size()};
+    }
+
+    /// Value initialized array, for lists that are filled in afterwards
+    template <typename T>
+    std::span<T> createArray(size_t size) {
+        static_assert(std::is_trivially_destructible_v<T>);
+        if (size == 0) {
+            return {};
+        }
+        auto data = static_cast<T *>(allocate(sizeof(T) * size, alignof(T)));
+        std::uninitialized_value_construct_n(data, size);
+        return {data, size};
+    }
+
+    template <typename T>
+    std::span<T> copy(const std::vector<T> &source) {
+        return copy(std::span<const T>{source});
+    }
+
+    std::string_view copy(std::string_view text) {
+        auto data = copy(std::span<const char>{text});
+        return {data.data(), data.size()};
+    }
+
+    /// Bytes in use, not counting unused space at the end of blocks
+    size_t bytesUsed() const {
+        return _bytesUsed;
+    }
+
+private:
+    static constexpr size_t blockSize = 64 * 1024;
+
+    struct Block {
+        std::unique_ptr<std::byte[]> data;
+        size_t size = 0;
+    };
+
+    struct Destructor {
+        void (*destroy)(void *);
+        void *object;
+    };
+
+    void *allocate(size_t size, size_t alignment) {
+        auto offset = (_used + alignment - 1) & ~(alignment - 1);
+        if (_blocks.empty() || offset + size > _blocks.back().size) {
+            // Objects that does not fit in a normal block gets their own
+            auto newSize = std::max(blockSize, size + alignment);
+            _blocks.push_back(
+                {std::make_unique_for_overwrite<std::byte[]>(newSize),
+                 newSize});
+            _used = 0;
+            offset = 0;
+        }
+        _used = offset + size;
+        _bytesUsed += size;
+        return _blocks.back().data.get() + offset;
+    }
+
+    std::vector<Block> _blocks;
+    std::vector<Destructor> _destructors;
+    size_t _used = 0;
+    size_t _bytesUsed = 0;
+};
@@ -0,0 +1,912 @@
+#include "bytecode.h"
+#include "commands.h"
+#include "scriptprofiler.h"
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+
+#if defined(__GNUC__)
+#define MATSCRIPT_COMPUTED_GOTO
+#endif
+
+namespace bytecode {
+
+namespace {
+
+class Compiler {
+public:
+    Chunk compile(const vm::Section &s) {
+        section(s);
+        emit(Op::Return);
+        return std::move(_chunk);
+    }
+
+private:
+    void section(const vm::Section &s) {
+        if (s.commands.empty()) {
+            emit(Op::Void);
+            return;
+        }
+        for (size_t i = 0; i < s.commands.size(); ++i) {
+            if (i) {
+                emit(Op::Pop);
+            }
+            if (scriptprofiler::enabled) {
+                emit(Op::Statement,
+                     static_cast<uint32_t>(_chunk.statements.size()));
+                _chunk.statements.push_back(s.commands[i]);
+            }
+            expression(*s.commands[i]);
+        }
+    }
+
+    void expression(vm::Expression &e) {
+        switch (e.kind()) {
+        case vm::NodeKind::VariableDeclaration:
+            emit(Op::DefineSlot,
+                 static_cast<vm::VariableDeclaration &>(e).slot);
+            return;
+        case vm::NodeKind::DestructuringDeclaration: {
+            auto &d = static_cast<vm::DestructuringDeclaration &>(e);
+            for (uint32_t i = 0; i < d.names.size(); ++i) {
+                emit(Op::DefineSlot, d.firstSlot + i);
+                emit(Op::Pop);
+            }
+            emit(Op::Void);
+            return;
+        }
+        case vm::NodeKind::Assignment: {
+            auto &a = static_cast<vm::Assignment &>(e);
+            expression(*a.right);
+            emit(Op::Dup);
+            store(*a.left);
+            return;
+        }
+        case vm::NodeKind::CompoundAssignment: {
+            auto &a = static_cast<vm::CompoundAssignment &>(e);
+            // The array and the index are only run once
+            if (a.left->kind() == vm::NodeKind::IndexAccessor) {
+                auto &index = static_cast<vm::IndexAccessor &>(*a.left);
+                expression(*index.object);
+                expression(*index.index);
+                emit(Op::DupTwo);
+                emit(Op::LoadIndex);
+                expression(*a.right);
+                emit(Op::Binary, static_cast<uint8_t>(a.op));
+                emit(Op::StoreIndexKeep);
+                return;
+            }
+            expression(*a.left);
+            expression(*a.right);
+            emit(Op::Binary, static_cast<uint8_t>(a.op));
+            emit(Op::Dup);
+            store(*a.left);
+            return;
+        }
+        case vm::NodeKind::BinaryOperation: {
+            auto &b = static_cast<vm::BinaryOperation &>(e);
+            expression(*b.left);
+            // `n - 1`, without pushing the constant
+            if (b.right->kind() == vm::NodeKind::Constant) {
+                emit(Op::BinaryConstant, static_cast<uint8_t>(b.op));
+                put(constant(static_cast<vm::Constant &>(*b.right).value()));
+                return;
+            }
+            expression(*b.right);
+            emit(Op::Binary, static_cast<uint8_t>(b.op));
+            return;
+        }
+        case vm::NodeKind::UnaryOperation: {
+            auto &u = static_cast<vm::UnaryOperation &>(e);
+            expression(*u.operand);
+            emit(Op::Unary, static_cast<uint8_t>(u.op));
+            return;
+        }
+        case vm::NodeKind::VariableAccessor: {
+            auto &v = static_cast<vm::VariableAccessor &>(e);
+            if (!v.address.isResolved()) {
+                emit(Op::Load, v.name);
+            }
+            else if (v.address.depth == 0) {
+                emit(Op::LoadLocal, v.address.slot);
+            }
+            else {
+                emit(Op::LoadSlot, v.address.depth);
+                put(v.address.slot);
+            }
+            return;
+        }
+        case vm::NodeKind::FunctionCall: {
+            auto &call = static_cast<vm::FunctionCall &>(e);
+            expression(*call.functionValue);
+            for (auto a : call.arguments) {
+                expression(*a);
+            }
+            emit(Op::Call, static_cast<uint32_t>(call.arguments.size()));
+            return;
+        }
+        case vm::NodeKind::StringLiteral:
+            emitConstant(vm::String{
+                std::string{static_cast<vm::StringLiteral &>(e).text}});
+            return;
+        case vm::NodeKind::Constant:
+            emitConstant(static_cast<vm::Constant &>(e).value());
+            return;
+        case vm::NodeKind::ArrayDeclaration:
+            emit(Op::NewArray);
+            return;
+        case vm::NodeKind::DictionaryDeclaration:
+            emit(Op::NewDictionary);
+            return;
+        case vm::NodeKind::ForDeclaration:
+            forLoop(static_cast<vm::ForDeclaration &>(e));
+            return;
+        case vm::NodeKind::IndexAccessor: {
+            auto &index = static_cast<vm::IndexAccessor &>(e);
+            expression(*index.object);
+            expression(*index.index);
+            emit(Op::LoadIndex);
+            return;
+        }
+        case vm::NodeKind::FunctionDeclaration:
+            // Added to the module by createModule
+            emit(Op::Void);
+            return;
+        case vm::NodeKind::IfStatement:
+            ifStatement(static_cast<vm::IfStatement &>(e));
+            return;
+        case vm::NodeKind::ReturnStatement: {
+            auto &r = static_cast<vm::ReturnStatement &>(e);
+            if (r.value) {
+                expression(*r.value);
+            }
+            else {
+                emit(Op::Void);
+            }
+            // Loop scopes and values below are dropped by the interpreter
+            emit(Op::Return);
+            return;
+        }
+        case vm::NodeKind::MemberFunctionCall: {
+            auto &call = static_cast<vm::MemberFunctionCall &>(e);
+            expression(*call.object);
+            for (auto a : call.arguments) {
+                expression(*a);
+            }
+            emit(Op::CallMember, call.memberName);
+            put(static_cast<uint32_t>(call.arguments.size()));
+            put(memberCache());
+            return;
+        }
+        }
+
+        throw std::runtime_error{"cannot compile expression"};
+    }
+
+    /// Pop the value on top of the stack and store it in `target`
+    void store(vm::Expression &target) {
+        switch (target.kind()) {
+        case vm::NodeKind::VariableDeclaration:
+            emit(Op::StoreSlot, uint32_t{0});
+            put(static_cast<vm::VariableDeclaration &>(target).slot);
+            return;
+        case vm::NodeKind::DestructuringDeclaration: {
+            auto &d = static_cast<vm::DestructuringDeclaration &>(target);
+            auto count = static_cast<uint32_t>(d.names.size());
+            emit(Op::Unpack, count);
+            for (uint32_t i = 0; i < count; ++i) {
+                emit(Op::StoreSlot, uint32_t{0});
+                put(d.firstSlot + i);
+            }
+            return;
+        }
+        case vm::NodeKind::VariableAccessor: {
+            auto &v = static_cast<vm::VariableAccessor &>(target);
+            if (v.address.isResolved()) {
+                emit(Op::StoreSlot, v.address.depth);
+                put(v.address.slot);
+            }
+            else {
+                emit(Op::Store, v.name);
+            }
+            return;
+        }
+        case vm::NodeKind::IndexAccessor: {
+            auto &index = static_cast<vm::IndexAccessor &>(target);
+            expression(*index.object);
+            expression(*index.index);
+            emit(Op::StoreIndex);
+            return;
+        }
+        default:
+            throw std::runtime_error{"expression is not assignable"};
+        }
+    }
+
+    // Stack during the loop: [result, iterator, end]. The result of the last
+    // iteration is kept below the iterator, like ForDeclaration::run
+    void forLoop(vm::ForDeclaration &f) {
+        emit(Op::Void);
+        emit(Op::PushScope, f.section->slotCount);
+        expression(*f.declaration);
+        emit(Op::Pop);
+        expression(*f.range);
+        emit(Op::IterStart);
+
+        auto loop = _chunk.code.size();
+        auto exit = size_t{};
+        if (f.declaration->kind() == vm::NodeKind::VariableDeclaration) {
+            // `let i` is written directly to its slot
+            emit(Op::IterNextLocal,
+                 static_cast<vm::VariableDeclaration &>(*f.declaration).slot);
+            put(memberCache());
+            exit = _chunk.code.size();
+            put(uint32_t{0});
+        }
+        else {
+            emit(Op::IterNext, memberCache());
+            exit = _chunk.code.size();
+            put(uint32_t{0});
+            store(*f.declaration);
+        }
+
+        section(*f.section);
+        emit(Op::StoreUnder, uint32_t{2});
+        emit(Op::Jump, static_cast<uint32_t>(loop));
+
+        patch(exit, static_cast<uint32_t>(_chunk.code.size()));
+        emit(Op::Pop);
+        emit(Op::Pop);
+        emit(Op::PopScope);
+    }
+
+    void ifStatement(vm::IfStatement &i) {
+        expression(*i.condition);
+        emit(Op::JumpIfFalse);
+        auto otherwise = _chunk.code.size();
+        put(uint32_t{0});
+
+        section(*i.then);
+        emit(Op::Jump);
+        auto end = _chunk.code.size();
+        put(uint32_t{0});
+
+        patch(otherwise, static_cast<uint32_t>(_chunk.code.size()));
+        if (i.otherwise) {
+            section(*i.otherwise);
+        }
+        else {
+            emit(Op::Void);
+        }
+        patch(end, static_cast<uint32_t>(_chunk.code.size()));
+    }
+
+    void emit(Op op) {
+        _chunk.code.push_back(static_cast<uint8_t>(op));
+    }
+
+    template <typename T>
+    void emit(Op op, T operand) {
+        emit(op);
+        put(operand);
+    }
+
+    void emit(Op op, Symbol symbol) {
+        emit(op, symbol.id());
+    }
+
+    /// Equal constants share the same slot
+    void emitConstant(vm::Value value) {
+        emit(Op::Constant, constant(std::move(value)));
+    }
+
+    /// Index of `value` in the constants of the chunk
+    uint32_t constant(vm::Value value) {
+        auto index = static_cast<uint32_t>(_chunk.constants.size());
+        auto [it, inserted] = _constants.try_emplace(constantKey(value), index);
+        if (inserted) {
+            _chunk.constants.push_back(std::move(value));
+        }
+        return it->second;
+    }
+
+    static std::string constantKey(const vm::Value &value) {
+        auto key = std::string{};
+        auto append = [&key](char type, const auto &bytes) {
+            key.push_back(type);
+            key.append(reinterpret_cast<const char *>(&bytes), sizeof(bytes));
+        };
+        if (value.is<vm::String>()) {
+            key = "s" + value.as<vm::String>().value;
+        }
+        else if (value.is<vm::Int>()) {
+            append('i', value.as<vm::Int>().value);
+        }
+        else if (value.is<vm::Float>()) {
+            append('f', value.as<vm::Float>().value);
+        }
+        else if (value.is<vm::Bool>()) {
+            append('b', value.as<vm::Bool>().value);
+        }
+        else if (value.is<vm::Void>()) {
+            key = "v";
+        }
+        else {
+            throw std::runtime_error{"value can not be a constant"};
+        }
+        return key;
+    }
+
+    uint32_t memberCache() {
+        auto index = static_cast<uint32_t>(_chunk.memberCaches.size());
+        _chunk.memberCaches.emplace_back();
+        return index;
+    }
+
+    void put(Symbol symbol) {
+        put(symbol.id());
+    }
+
+    template <typename T>
+    void put(T value) {
+        auto bytes = reinterpret_cast<const uint8_t *>(&value);
+        _chunk.code.insert(_chunk.code.end(), bytes, bytes + sizeof(T));
+    }
+
+    void patch(size_t position, uint32_t value) {
+        std::memcpy(_chunk.code.data() + position, &value, sizeof(value));
+    }
+
+    Chunk _chunk;
+    std::unordered_map<std::string, uint32_t> _constants;
+};
+
+/// The most common operators on small ints, without calling
+/// `vm::binaryOperation`. False if the operator or the types are not handled
+bool intBinary(TokenType op, vm::Value &left, const vm::Value &right) {
+    if (!left.isImmediateInt() || !right.isImmediateInt()) {
+        return false;
+    }
+
+    auto a = left.as<vm::Int>().value;
+    auto b = right.as<vm::Int>().value;
+    switch (op) {
+    case TokenType::Plus:
+        left = vm::Int{a + b};
+        return true;
+    case TokenType::Minus:
+        left = vm::Int{a - b};
+        return true;
+    case TokenType::Star:
+        left = vm::Int{a * b};
+        return true;
+    case TokenType::Less:
+        left = vm::Bool{a < b};
+        return true;
+    case TokenType::LessEqual:
+        left = vm::Bool{a <= b};
+        return true;
+    case TokenType::Greater:
+        left = vm::Bool{a > b};
+        return true;
+    case TokenType::GreaterEqual:
+        left = vm::Bool{a >= b};
+        return true;
+    case TokenType::EqualEqual:
+        left = vm::Bool{a == b};
+        return true;
+    case TokenType::ExclaimEqual:
+        left = vm::Bool{a != b};
+        return true;
+    default:
+        return false;
+    }
+}
+
+template <typename T>
+T read(const uint8_t *&pc) {
+    auto value = T{};
+    std::memcpy(&value, pc, sizeof(T));
+    pc += sizeof(T);
+    return value;
+}
+
+} // namespace
+
+Chunk compile(const vm::Section &section) {
+    return Compiler{}.compile(section);
+}
+
+Interpreter::Interpreter(jit::Mode jit)
+    : _jit{jit} {
+    static auto nextId = std::atomic<uint32_t>{1};
+    _id = nextId++;
+}
+
+vm::Value Interpreter::call(const vm::Function &f,
+                            std::span<const vm::Value> values,
+                            vm::Context &context,
+                            vm::Value self) {
+    auto frame = vm::Frame{vm::frameSize(f)};
+    frame.slots[0] = std::move(self);
+    auto count = std::min<size_t>(values.size(), f.argumentCount);
+    std::ranges::copy(values.first(count), frame.slots.begin() + 1);
+    return call(f, frame, context);
+}
+
+vm::Value Interpreter::call(const vm::Function &f,
+                            vm::Frame &frame,
+                            vm::Context &context) {
+    if (f.native) {
+        return vm::call(f, frame, context);
+    }
+
+    auto profile = scriptprofiler::Call{f};
+    auto newContext = vm::Context{
+        .parent = f.module ? nullptr : &context.root(),
+        .slots = frame.slots,
+    };
+    if (f.module) {
+        newContext.closure = context.root().closure;
+        newContext.engine = this;
+    }
+
+    return run(chunk(*f.body), newContext);
+}
+
+Chunk &Interpreter::chunk(const vm::Section &section) {
+    if (section.chunkOwner == _id) {
+        return *section.chunk;
+    }
+
+    auto &chunk = _chunks[&section];
+    if (!chunk) {
+        chunk = std::make_unique<Chunk>(compile(section));
+    }
+    section.chunk = chunk.get();
+    section.chunkOwner = _id;
+    return *chunk;
+}
+
+const void *Interpreter::nativeEntry(Chunk &chunk, size_t offset) {
+    if (!chunk.native) {
+        auto threshold = _jit == jit::Mode::Always ? 1 : jit::hotThreshold;
+        // Compiled once when the threshold is reached, so that unsupported
+        // platforms do not try again
+        if (++chunk.hotness != threshold) {
+            return nullptr;
+        }
+        chunk.native = jit::compile(chunk);
+        if (!chunk.native) {
+            return nullptr;
+        }
+    }
+    return chunk.native->entry(offset);
+}
+
+bool Interpreter::runNative(Chunk &chunk,
+                            const void *entry,
+                            vm::Context *&context,
+                            const uint8_t *&pc,
+                            vm::Value &result) {
+    auto state = jit::State{
+        .interpreter = this,
+        .stack = &_stack,
+        .context = context,
+    };
+    auto exit = chunk.native->run(state, entry);
+    context = state.context;
+
+    switch (exit) {
+    case jit::Exit::Return:
+        result = std::move(state.result);
+        return true;
+    case jit::Exit::Error:
+        std::rethrow_exception(state.error);
+    case jit::Exit::Deoptimize:
+        break;
+    }
+
+    pc = chunk.code.data() + state.resume;
+    return false;
+}
+
+Interpreter::Scope &Interpreter::pushScope(size_t size, vm::Context *parent) {
+    if (_scopeCount == _scopes.size()) {
+        _scopes.emplace_back();
+    }
+    auto &scope = _scopes[_scopeCount++];
+    scope.frame.emplace(size);
+    scope.context = {
+        .parent = parent,
+        .slots = scope.frame->slots,
+    };
+    return scope;
+}
+
+void Interpreter::popScope() {
+    // Frames are freed in the reverse order of creation
+    _scopes[--_scopeCount].frame.reset();
+}
+
+void Interpreter::popArguments(const vm::Function &f,
+                               vm::Frame &frame,
+                               size_t count) {
+    auto first = _stack.size() - count;
+    for (size_t i = 0; i < count && i < f.argumentCount; ++i) {
+        frame.slots[1 + i] = std::move(_stack[first + i]);
+    }
+    _stack.resize(first - 1);
+}
+
+void Interpreter::iterStart() {
+    auto &it = _stack.back();
+    if (it.is<vm::Range>()) {
+        auto &range = it.as<vm::Range>();
+        auto end = vm::Value{vm::Int{range.end}};
+        it = vm::Int{range.begin};
+        _stack.push_back(std::move(end));
+        return;
+    }
+    it = vm::iterator(it);
+    _stack.emplace_back();
+}
+
+bool Interpreter::advance(vm::Value &it,
+                          const vm::Value &end,
+                          vm::MemberCache &cache,
+                          vm::Value &value,
+                          vm::Context &context) {
+    if (end.is<vm::Int>()) {
+        auto i = it.as<vm::Int>().value;
+        if (i >= end.as<vm::Int>().value) {
+            return false;
+        }
+        value = vm::Int{i};
+        it = vm::Int{i + 1};
+        return true;
+    }
+
+    if (!it.is<vm::Map>()) {
+        return vm::advance(it, value);
+    }
+
+    // `it` can be on the stack, which the call can move
+    auto next = it.as<vm::Map>().at(symbols::Next, cache);
+    auto &f = next.as<vm::Function>();
+    auto frame = vm::Frame{vm::frameSize(f)};
+    frame.slots[0] = it;
+    value = call(f, frame, context);
+    return !value.is<vm::Void>();
+}
+
+vm::Value Interpreter::run(Chunk &called, vm::Context &context) {
+    auto &stack = _stack;
+    auto chunk = &called;
+    auto ctx = &context;
+    auto pc = static_cast<const uint8_t *>(chunk->code.data());
+
+    // Script functions called from here run in this loop, except when their
+    // time is measured by the profiler or the jit may run them
+    auto inlineCalls = _jit == jit::Mode::Off && !scriptprofiler::enabled;
+    auto firstCall = _calls.size();
+
+    // Nested calls use the same stacks. Leave them as they were when returning
+    // or when an exception is thrown
+    struct Restore {
+        Interpreter &interpreter;
+        size_t stackSize;
+        size_t scopeCount;
+        size_t callCount;
+
+        ~Restore() {
+            while (interpreter._scopeCount > scopeCount) {
+                interpreter.popScope();
+            }
+            interpreter._stack.resize(stackSize);
+            interpreter._calls.resize(callCount);
+        }
+    } restore{*this, stack.size(), _scopeCount, _calls.size()};
+
+    auto pop = [&stack] {
+        auto value = std::move(stack.back());
+        stack.pop_back();
+        return value;
+    };
+
+    if (_jit != jit::Mode::Off) {
+        if (auto entry = nativeEntry(*chunk, 0)) {
+            auto result = vm::Value{};
+            if (runNative(*chunk, entry, ctx, pc, result)) {
+                return result;
+            }
+        }
+    }
+
+    // Every handler is a block that ends before DISPATCH, since leaving a
+    // block with a computed goto does not run the destructors of its variables
+#ifdef MATSCRIPT_COMPUTED_GOTO
+#define OPCODE(x) &&op_##x,
+    static void *const labels[] = {OPCODE_LIST};
+#undef OPCODE
+#define TARGET(x) op_##x:
+#define DISPATCH() goto *labels[*pc++]
+    DISPATCH();
+#else
+#define TARGET(x) case Op::x:
+#define DISPATCH() continue
+    for (;;) {
+        switch (static_cast<Op>(*pc++)) {
+#endif
+
+    TARGET(Constant) {
+        stack.push_back(chunk->constants[read<uint32_t>(pc)]);
+    }
+    DISPATCH();
+    TARGET(Void) {
+        stack.emplace_back();
+    }
+    DISPATCH();
+    TARGET(Pop) {
+        stack.pop_back();
+    }
+    DISPATCH();
+    TARGET(Dup) {
+        stack.push_back(vm::Value{stack.back()});
+    }
+    DISPATCH();
+    TARGET(DupTwo) {
+        auto size = stack.size();
+        stack.push_back(vm::Value{stack[size - 2]});
+        stack.push_back(vm::Value{stack[size - 1]});
+    }
+    DISPATCH();
+    TARGET(Load) {
+        auto name = Symbol::fromId(read<uint32_t>(pc));
+        stack.push_back(ctx->at(name));
+    }
+    DISPATCH();
+    TARGET(Store) {
+        auto name = Symbol::fromId(read<uint32_t>(pc));
+        ctx->at(name) = pop();
+    }
+    DISPATCH();
+    TARGET(LoadSlot) {
+        auto depth = read<uint32_t>(pc);
+        auto slot = read<uint32_t>(pc);
+        stack.push_back(ctx->at(vm::SlotAddress{depth, slot}));
+    }
+    DISPATCH();
+    TARGET(LoadLocal) {
+        stack.push_back(ctx->slots[read<uint32_t>(pc)]);
+    }
+    DISPATCH();
+    TARGET(StoreSlot) {
+        auto depth = read<uint32_t>(pc);
+        auto slot = read<uint32_t>(pc);
+        ctx->at(vm::SlotAddress{depth, slot}) = pop();
+    }
+    DISPATCH();
+    TARGET(DefineSlot) {
+        // Declaring a variable again, like in a loop body, resets it
+        auto &value = ctx->slots[read<uint32_t>(pc)];
+        value = {};
+        stack.push_back(value);
+    }
+    DISPATCH();
+    TARGET(Unpack) {
+        auto count = read<uint32_t>(pc);
+        auto value = pop();
+        auto &array = value.as<vm::Array>();
+        if (array.size() < count) {
+            throw std::runtime_error{"not enough values to unpack"};
+        }
+        // The first value ends up on top
+        for (auto i = count; i-- > 0;) {
+            stack.push_back(array.at(i));
+        }
+    }
+    DISPATCH();
+    TARGET(LoadIndex) {
+        auto index = pop();
+        auto array = pop();
+        stack.push_back(vm::element(array, index));
+    }
+    DISPATCH();
+    TARGET(StoreIndex) {
+        auto index = pop();
+        auto array = pop();
+        vm::setElement(array, index, pop());
+    }
+    DISPATCH();
+    TARGET(StoreIndexKeep) {
+        auto value = pop();
+        auto index = pop();
+        vm::setElement(stack.back(), index, value);
+        stack.back() = std::move(value);
+    }
+    DISPATCH();
+    TARGET(Binary) {
+        auto op = static_cast<TokenType>(read<uint8_t>(pc));
+        auto &left = stack[stack.size() - 2];
+        if (!intBinary(op, left, stack.back())) {
+            left = vm::binaryOperation(op, left, stack.back());
+        }
+        stack.pop_back();
+    }
+    DISPATCH();
+    TARGET(BinaryConstant) {
+        auto op = static_cast<TokenType>(read<uint8_t>(pc));
+        auto &right = chunk->constants[read<uint32_t>(pc)];
+        auto &left = stack.back();
+        if (!intBinary(op, left, right)) {
+            left = vm::binaryOperation(op, left, right);
+        }
+    }
+    DISPATCH();
+    TARGET(Unary) {
+        auto op = static_cast<TokenType>(read<uint8_t>(pc));
+        stack.back() = vm::unaryOperation(op, stack.back());
+    }
+    DISPATCH();
+    TARGET(NewArray) {
+        stack.emplace_back(vm::make<vm::Array>());
+    }
+    DISPATCH();
+    TARGET(NewDictionary) {
+        stack.emplace_back(vm::make<vm::Dictionary>());
+    }
+    DISPATCH();
+    TARGET(Call) {
+        auto count = read<uint32_t>(pc);
+        auto function = std::move(stack[stack.size() - count - 1]);
+        auto &f = function.as<vm::Function>();
+        if (f.native || f.module || !inlineCalls) {
+            auto frame = vm::Frame{vm::frameSize(f)};
+            popArguments(f, frame, count);
+            stack.push_back(call(f, frame, *ctx));
+        }
+        else {
+            // The frame is a scope that Return removes together with the
+            // scopes of the function
+            auto &scope = pushScope(vm::frameSize(f), &ctx->root());
+            popArguments(f, *scope.frame, count);
+            _calls.push_back({
+                .chunk = chunk,
+                .pc = pc,
+                .context = ctx,
+                .stackSize = stack.size(),
+                .scopeCount = _scopeCount - 1,
+            });
+            chunk = &this->chunk(*f.body);
+            ctx = &scope.context;
+            pc = chunk->code.data();
+        }
+    }
+    DISPATCH();
+    TARGET(CallMember) {
+        auto name = Symbol::fromId(read<uint32_t>(pc));
+        auto count = read<uint32_t>(pc);
+        auto &cache = chunk->memberCaches[read<uint32_t>(pc)];
+        auto &object = stack[stack.size() - count - 1];
+        auto member = vm::members(object).at(name, cache);
+        auto &f = member.as<vm::Function>();
+        auto frame = vm::Frame{vm::frameSize(f)};
+        frame.slots[0] = std::move(object);
+        popArguments(f, frame, count);
+        stack.push_back(call(f, frame, *ctx));
+    }
+    DISPATCH();
+    TARGET(PushScope) {
+        ctx = &pushScope(read<uint32_t>(pc), ctx).context;
+    }
+    DISPATCH();
+    TARGET(PopScope) {
+        ctx = ctx->parent;
+        popScope();
+    }
+    DISPATCH();
+    TARGET(Jump) {
+        auto target = read<uint32_t>(pc);
+        auto loops = chunk->code.data() + target < pc;
+        pc = chunk->code.data() + target;
+
+        // Hot loops continue in machine code
+        if (loops && _jit != jit::Mode::Off) {
+            if (auto entry = nativeEntry(*chunk, target)) {
+                auto result = vm::Value{};
+                if (runNative(*chunk, entry, ctx, pc, result)) {
+                    return result;
+                }
+            }
+        }
+    }
+    DISPATCH();
+    TARGET(JumpIfTrue) {
+        auto target = read<uint32_t>(pc);
+        if (pop().asBool()) {
+            pc = chunk->code.data() + target;
+        }
+    }
+    DISPATCH();
+    TARGET(JumpIfFalse) {
+        auto target = read<uint32_t>(pc);
+        if (!pop().asBool()) {
+            pc = chunk->code.data() + target;
+        }
+    }
+    DISPATCH();
+    TARGET(IterStart) {
+        iterStart();
+    }
+    DISPATCH();
+    TARGET(IterNext) {
+        auto &cache = chunk->memberCaches[read<uint32_t>(pc)];
+        auto exit = read<uint32_t>(pc);
+        auto value = vm::Value{};
+        auto size = stack.size();
+        if (advance(stack[size - 2], stack[size - 1], cache, value, *ctx)) {
+            stack.push_back(std::move(value));
+        }
+        else {
+            pc = chunk->code.data() + exit;
+        }
+    }
+    DISPATCH();
+    TARGET(IterNextLocal) {
+        auto slot = read<uint32_t>(pc);
+        auto &cache = chunk->memberCaches[read<uint32_t>(pc)];
+        auto exit = read<uint32_t>(pc);
+        auto value = vm::Value{};
+        auto size = stack.size();
+        if (advance(stack[size - 2], stack[size - 1], cache, value, *ctx)) {
+            ctx->slots[slot] = std::move(value);
+        }
+        else {
+            pc = chunk->code.data() + exit;
+        }
+    }
+    DISPATCH();
+    TARGET(StoreUnder) {
+        auto depth = read<uint32_t>(pc);
+        auto value = pop();
+        stack[stack.size() - 1 - depth] = std::move(value);
+    }
+    DISPATCH();
+    TARGET(Statement) {
+        scriptprofiler::statement(*chunk->statements[read<uint32_t>(pc)]);
+    }
+    DISPATCH();
+    TARGET(Return) {
+        if (_calls.size() == firstCall) {
+            return pop();
+        }
+
+        auto value = pop();
+        auto &caller = _calls.back();
+        while (_scopeCount > caller.scopeCount) {
+            popScope();
+        }
+        stack.resize(caller.stackSize);
+        stack.push_back(std::move(value));
+        chunk = caller.chunk;
+        pc = caller.pc;
+        ctx = caller.context;
+        _calls.pop_back();
+    }
+    DISPATCH();
+
+#ifndef MATSCRIPT_COMPUTED_GOTO
+        }
+    }
+#endif
+
+#undef TARGET
+#undef DISPATCH
+}
+
+} // namespace bytecode
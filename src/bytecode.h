@@ -0,0 +1,175 @@
+#pragma once
+
+#include "jit.h"
+#include "operandstack.h"
+#include "vm.h"
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <optional>
+#include <span>
+#include <unordered_map>
+#include <vector>
+
+// Alternative to running the syntax tree with `Expression::run`. Sections are
+// compiled to a linear byte code that is run on an operand stack. The runtime
+// types (Value, Map, Function, Array) are shared with the tree interpreter
+
+namespace bytecode {
+
+/// Operands follow the opcode directly in the code, u32 unless noted
+// clang-format off
+#define OPCODE_LIST \
+    OPCODE(Constant)    /* constant index */ \
+    OPCODE(Void)        \
+    OPCODE(Pop)         \
+    OPCODE(Dup)         \
+    OPCODE(DupTwo)      /* the two values on top */ \
+    OPCODE(Load)        /* symbol */ \
+    OPCODE(Store)       /* symbol */ \
+    OPCODE(LoadSlot)    /* depth, slot */ \
+    OPCODE(LoadLocal)   /* slot, LoadSlot with depth 0 */ \
+    OPCODE(StoreSlot)   /* depth, slot */ \
+    OPCODE(DefineSlot)  /* slot */ \
+    OPCODE(Unpack)      /* count */ \
+    OPCODE(LoadIndex)   \
+    OPCODE(StoreIndex)  \
+    OPCODE(StoreIndexKeep) /* array, index, value below; leaves value */ \
+    OPCODE(Binary)      /* u8 TokenType */ \
+    OPCODE(BinaryConstant) /* u8 TokenType, constant index */ \
+    OPCODE(Unary)       /* u8 TokenType */ \
+    OPCODE(NewArray)    \
+    OPCODE(NewDictionary) \
+    OPCODE(Call)        /* argument count */ \
+    OPCODE(CallMember)  /* symbol, argument count, member cache */ \
+    OPCODE(PushScope)   /* slot count */ \
+    OPCODE(PopScope)    \
+    OPCODE(Jump)        /* target */ \
+    OPCODE(JumpIfTrue)  /* target */ \
+    OPCODE(JumpIfFalse) /* target */ \
+    OPCODE(IterStart)   /* pushes the end of an int range, or void */ \
+    OPCODE(IterNext)    /* member cache, target when done */ \
+    OPCODE(IterNextLocal) /* slot, member cache, target when done */ \
+    OPCODE(StoreUnder)  /* depth */ \
+    OPCODE(Statement)   /* statement index, only when profiling */ \
+    OPCODE(Return) // clang-format on
+
+#define OPCODE(x) x,
+
+enum class Op : uint8_t { OPCODE_LIST };
+
+#undef OPCODE
+
+struct Chunk {
+    std::vector<uint8_t> code;
+    std::vector<vm::Value> constants;
+
+    /// One for each member lookup in the code, updated when running
+    std::vector<vm::MemberCache> memberCaches;
+
+    /// Statements for the script profiler
+    std::vector<vm::Expression *> statements;
+
+    /// Runs of the chunk and iterations of its loops, to find hot chunks
+    uint32_t hotness = 0;
+
+    /// Machine code, once the chunk is hot
+    std::shared_ptr<jit::Code> native;
+};
+
+/// Every expression leaves exactly one value on the stack, and a section leaves
+/// the value of its last expression
+Chunk compile(const vm::Section &section);
+
+class Interpreter final : public vm::Engine {
+public:
+    explicit Interpreter(jit::Mode jit = jit::Mode::Off);
+
+    /// Same as `vm::call` but script functions are run as byte code
+    vm::Value call(const vm::Function &f,
+                   std::span<const vm::Value> values,
+                   vm::Context &context,
+                   vm::Value self = {});
+
+    vm::Value call(const vm::Function &f,
+                   vm::Frame &frame,
+                   vm::Context &context) override;
+
+    vm::Value run(Chunk &chunk, vm::Context &context);
+
+private:
+    friend struct jit::Runtime;
+
+    /// Variables created by a for loop, or the frame of a function that was
+    /// called from byte code. Left scopes are kept without their frame, so
+    /// that entering a scope again does not allocate
+    struct Scope {
+        std::optional<vm::Frame> frame;
+        vm::Context context;
+    };
+
+    /// Where to continue when a function that was called from byte code
+    /// returns
+    struct CallFrame {
+        Chunk *chunk = nullptr;
+        const uint8_t *pc = nullptr;
+        vm::Context *context = nullptr;
+        size_t stackSize = 0;
+
+        /// Scopes of the caller. The callee's frame is the next one
+        size_t scopeCount = 0;
+    };
+
+    /// Sections are compiled the first time they are called. The last
+    /// interpreter that used a section keeps its chunk in the section
+    Chunk &chunk(const vm::Section &section);
+
+    /// Machine code for `chunk` at `offset`, if the chunk is hot enough to be
+    /// compiled
+    const void *nativeEntry(Chunk &chunk, size_t offset);
+
+    /// Run the machine code of `chunk` from `entry`. Returns true and sets
+    /// `result` if the chunk returned. Otherwise the interpreter continues at
+    /// `pc` with `context`
+    bool runNative(Chunk &chunk,
+                   const void *entry,
+                   vm::Context *&context,
+                   const uint8_t *&pc,
+                   vm::Value &result);
+
+    /// A scope with `size` slots whose context has `parent`
+    Scope &pushScope(size_t size, vm::Context *parent);
+    void popScope();
+
+    /// Move the last `count` values on the stack to the argument slots of
+    /// `frame`, and drop them and the function or object below them
+    void popArguments(const vm::Function &f, vm::Frame &frame, size_t count);
+
+    /// Replace the iterable value on top of the stack with the iterator and
+    /// the end of the loop. Int ranges are counted in the iterator up to the
+    /// end, so that they are not allocated
+    void iterStart();
+
+    /// Set `value` to the next item of the loop iterator `it`, calling `next`
+    /// for maps. `end` is from `iterStart`. False when the loop is done
+    bool advance(vm::Value &it,
+                 const vm::Value &end,
+                 vm::MemberCache &cache,
+                 vm::Value &value,
+                 vm::Context &context);
+
+    jit::Mode _jit;
+
+    /// Never 0, and not reused by later interpreters
+    uint32_t _id;
+
+    std::unordered_map<const vm::Section *, std::unique_ptr<Chunk>> _chunks;
+
+    /// Operand stack, loop scopes and function frames, shared by nested calls
+    OperandStack _stack;
+    std::deque<Scope> _scopes;
+    size_t _scopeCount = 0;
+    std::vector<CallFrame> _calls;
+};
+
+} // namespace bytecode
@@ -0,0 +1,242 @@
+#include "charscan.h"
+#include <algorithm>
+#include <bit>
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#define MATSCRIPT_SCAN_X86 1
+#endif
+
+namespace charscan {
+
+namespace {
+
+bool isSpace(char c) {
+    return classOf(c) == CharClass::Space;
+}
+
+bool isIdentifier(char c) {
+    auto cls = classOf(c);
+    return cls == CharClass::Alpha || cls == CharClass::Number;
+}
+
+bool isNumber(char c) {
+    return classOf(c) == CharClass::Number || c == '.' || c == '\'';
+}
+
+template <bool (*Match)(char)>
+const char *skipScalar(const char *begin, const char *end) {
+    while (begin != end && Match(*begin)) {
+        ++begin;
+    }
+    return begin;
+}
+
+const char *findScalar(const char *begin, const char *end, char c) {
+    return std::find(begin, end, c);
+}
+
+const char *find2Scalar(const char *begin, const char *end, char a, char b) {
+    return std::find_if(
+        begin, end, [a, b](char c) { return c == a || c == b; });
+}
+
+#ifdef MATSCRIPT_SCAN_X86
+
+// ---- SSE2, always available on x86-64 ------------------------------------
+
+/// Unsigned compare lo <= v <= hi for each byte
+__m128i inRange128(__m128i v, char lo, char hi) {
+    auto offset = _mm_sub_epi8(v, _mm_set1_epi8(lo));
+    auto limit = _mm_set1_epi8(static_cast<char>(hi - lo));
+    return _mm_cmpeq_epi8(_mm_min_epu8(offset, limit), offset);
+}
+
+__m128i spaceMask128(__m128i v) {
+    return _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8(' ')),
+                        inRange128(v, '\t', '\r'));
+}
+
+__m128i identifierMask128(__m128i v) {
+    auto lower = _mm_or_si128(v, _mm_set1_epi8(0x20));
+    return _mm_or_si128(
+        _mm_or_si128(inRange128(lower, 'a', 'z'), inRange128(v, '0', '9')),
+        _mm_cmpeq_epi8(v, _mm_set1_epi8('_')));
+}
+
+__m128i numberMask128(__m128i v) {
+    return _mm_or_si128(
+        _mm_or_si128(inRange128(v, '0', '9'),
+                     _mm_cmpeq_epi8(v, _mm_set1_epi8('.'))),
+        _mm_cmpeq_epi8(v, _mm_set1_epi8('\'')));
+}
+
+template <__m128i (*Mask)(__m128i), bool (*Match)(char)>
+const char *skipSse2(const char *begin, const char *end) {
+    for (; end - begin >= 16; begin += 16) {
+        auto v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(begin));
+        auto outside = ~static_cast<unsigned>(_mm_movemask_epi8(Mask(v))) &
+                       0xffffu;
+        if (outside) {
+            return begin + std::countr_zero(outside);
+        }
+    }
+    return skipScalar<Match>(begin, end);
+}
+
+const char *findSse2(const char *begin, const char *end, char c) {
+    auto needle = _mm_set1_epi8(c);
+    for (; end - begin >= 16; begin += 16) {
+        auto v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(begin));
+        auto found =
+            static_cast<unsigned>(_mm_movemask_epi8(_mm_cmpeq_epi8(v, needle)));
+        if (found) {
+            return begin + std::countr_zero(found);
+        }
+    }
+    return findScalar(begin, end, c);
+}
+
+const char *find2Sse2(const char *begin, const char *end, char a, char b) {
+    auto needleA = _mm_set1_epi8(a);
+    auto needleB = _mm_set1_epi8(b);
+    for (; end - begin >= 16; begin += 16) {
+        auto v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(begin));
+        auto found = static_cast<unsigned>(_mm_movemask_epi8(_mm_or_si128(
+            _mm_cmpeq_epi8(v, needleA), _mm_cmpeq_epi8(v, needleB))));
+        if (found) {
+            return begin + std::countr_zero(found);
+        }
+    }
+    return find2Scalar(begin, end, a, b);
+}
+
+// ---- AVX2 -----------------------------------------------------------------
+
+#define AVX2 __attribute__((target("avx2")))
+
+AVX2 __m256i inRange256(__m256i v, char lo, char hi) {
+    auto offset = _mm256_sub_epi8(v, _mm256_set1_epi8(lo));
+    auto limit = _mm256_set1_epi8(static_cast<char>(hi - lo));
+    return _mm256_cmpeq_epi8(_mm256_min_epu8(offset, limit), offset);
+}
+
+AVX2 __m256i spaceMask256(__m256i v) {
+    return _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8(' ')),
+                           inRange256(v, '\t', '\r'));
+}
+
+AVX2 __m256i identifierMask256(__m256i v) {
+    auto lower = _mm256_or_si256(v, _mm256_set1_epi8(0x20));
+    return _mm256_or_si256(
+        _mm256_or_si256(inRange256(lower, 'a', 'z'), inRange256(v, '0', '9')),
+        _mm256_cmpeq_epi8(v, _mm256_set1_epi8('_')));
+}
+
+AVX2 __m256i numberMask256(__m256i v) {
+    return _mm256_or_si256(
+        _mm256_or_si256(inRange256(v, '0', '9'),
+                        _mm256_cmpeq_epi8(v, _mm256_set1_epi8('.'))),
+        _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\'')));
+}
+
+template <__m256i (*Mask)(__m256i), __m128i (*Mask128)(__m128i),
+          bool (*Match)(char)>
+AVX2 const char *skipAvx2(const char *begin, const char *end) {
+    for (; end - begin >= 32; begin += 32) {
+        auto v = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(begin));
+        auto outside = ~static_cast<uint32_t>(_mm256_movemask_epi8(Mask(v)));
+        if (outside) {
+            return begin + std::countr_zero(outside);
+        }
+    }
+    return skipSse2<Mask128, Match>(begin, end);
+}
+
+AVX2 const char *findAvx2(const char *begin, const char *end, char c) {
+    auto needle = _mm256_set1_epi8(c);
+    for (; end - begin >= 32; begin += 32) {
+        auto v = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(begin));
+        auto found = static_cast<uint32_t>(
+            _mm256_movemask_epi8(_mm256_cmpeq_epi8(v, needle)));
+        if (found) {
+            return begin + std::countr_zero(found);
+        }
+    }
+    return findSse2(begin, end, c);
+}
+
+AVX2 const char *find2Avx2(const char *begin,
+                           const char *end,
+                           char a,
+                           char b) {
+    auto needleA = _mm256_set1_epi8(a);
+    auto needleB = _mm256_set1_epi8(b);
+    for (; end - begin >= 32; begin += 32) {
+        auto v = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(begin));
+        auto found = static_cast<uint32_t>(_mm256_movemask_epi8(
+            _mm256_or_si256(_mm256_cmpeq_epi8(v, needleA),
+                            _mm256_cmpeq_epi8(v, needleB))));
+        if (found) {
+            return begin + std::countr_zero(found);
+        }
+    }
+    return find2Sse2(begin, end, a, b);
+}
+
+#undef AVX2
+
+const auto sse2Scanner = Scanner{
+    .skipSpace = skipSse2<spaceMask128, isSpace>,
+    .skipIdentifier = skipSse2<identifierMask128, isIdentifier>,
+    .skipNumber = skipSse2<numberMask128, isNumber>,
+    .find = findSse2,
+    .find2 = find2Sse2,
+    .name = "sse2",
+};
+
+const auto avx2Scanner = Scanner{
+    .skipSpace = skipAvx2<spaceMask256, spaceMask128, isSpace>,
+    .skipIdentifier =
+        skipAvx2<identifierMask256, identifierMask128, isIdentifier>,
+    .skipNumber = skipAvx2<numberMask256, numberMask128, isNumber>,
+    .find = findAvx2,
+    .find2 = find2Avx2,
+    .name = "avx2",
+};
+
+#endif
+
+const auto scalar = Scanner{
+    .skipSpace = skipScalar<isSpace>,
+    .skipIdentifier = skipScalar<isIdentifier>,
+    .skipNumber = skipScalar<isNumber>,
+    .find = findScalar,
+    .find2 = find2Scalar,
+    .name = "scalar",
+};
+
+const Scanner &selectScanner() {
+#ifdef MATSCRIPT_SCAN_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        return avx2Scanner;
+    }
+    return sse2Scanner;
+#else
+    return scalar;
+#endif
+}
+
+} // namespace
+
+const Scanner &scanner() {
+    static const auto &selected = selectScanner();
+    return selected;
+}
+
+const Scanner &scalarScanner() {
+    return scalar;
+}
+
+} // namespace charscan
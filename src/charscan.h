@@ -0,0 +1,77 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+
+// Character classification and bulk scanning used by the tokenizer. The
+// scanning functions handle 16 (SSE2) or 32 (AVX2) bytes per step when the
+// cpu supports it, the implementation is selected once at runtime
+
+namespace charscan {
+
+enum class CharClass : uint8_t {
+    Space,
+    Alpha,
+    Number,
+    Quote,
+    Operator,
+};
+
+constexpr std::array<CharClass, 256> createClassTable() {
+    auto table = std::array<CharClass, 256>{};
+    for (int i = 0; i < 256; ++i) {
+        auto c = static_cast<char>(i);
+        if ((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_') {
+            table[i] = CharClass::Alpha;
+        }
+        else if (c >= '0' && c <= '9') {
+            table[i] = CharClass::Number;
+        }
+        else if (c == ' ' || (c >= '\t' && c <= '\r')) {
+            table[i] = CharClass::Space;
+        }
+        else if (c == '"') {
+            table[i] = CharClass::Quote;
+        }
+        else {
+            table[i] = CharClass::Operator;
+        }
+    }
+    return table;
+}
+
+inline constexpr auto classTable = createClassTable();
+
+constexpr CharClass classOf(char c) {
+    return classTable[static_cast<uint8_t>(c)];
+}
+
+/// Each function returns a pointer to the first character in [begin, end) that
+/// does not belong to the run, or `end`
+struct Scanner {
+    /// Spaces, tabs and newlines
+    const char *(*skipSpace)(const char *begin, const char *end);
+
+    /// Letters, digits and '_'
+    const char *(*skipIdentifier)(const char *begin, const char *end);
+
+    /// Digits, '.' and the digit separator '\''
+    const char *(*skipNumber)(const char *begin, const char *end);
+
+    /// Returns a pointer to the first `c` or `end`
+    const char *(*find)(const char *begin, const char *end, char c);
+
+    /// Returns a pointer to the first `a` or `b`, or `end`
+    const char *(*find2)(const char *begin, const char *end, char a, char b);
+
+    /// Name of the selected implementation
+    const char *name;
+};
+
+/// The fastest implementation supported by the current cpu
+const Scanner &scanner();
+
+/// Implementation without vector instructions
+const Scanner &scalarScanner();
+
+} // namespace charscan
@@ -1,83 +1,247 @@
 #pragma once
 
+#include "dictionary.h"
 #include "vm.h"
 #include <memory>
+#include <span>
+#include <stdexcept>
+#include <string_view>
+#include <type_traits>
+#include <variant>
 #include <vector>
 
 namespace vm {
 
+/// Run the argument expressions into the slots after `this`. Arguments that
+/// `f` does not take are run but not stored
+inline void setArguments(const Function &f,
+                         Frame &frame,
+                         std::span<Expression *> arguments,
+                         Context &context) {
+    for (size_t i = 0; i < arguments.size(); ++i) {
+        auto value = arguments[i]->run(context);
+        if (i < f.argumentCount) {
+            frame.slots[i + 1] = std::move(value);
+        }
+    }
+}
+
 struct VariableDeclaration : public Expression {
-    Token name;
+    Symbol name;
+
+    /// Set by the resolver
+    uint32_t slot = 0;
+
+    NodeKind kind() const override {
+        return NodeKind::VariableDeclaration;
+    }
 
     Value run(Context &context) override {
-        return context.closure->define(name);
+        return context.slots[slot] = {};
+    }
+
+    void assign(Context &context, Value value) override {
+        context.slots[slot] = std::move(value);
+    }
+};
+
+/// `let a, b = array`
+struct DestructuringDeclaration : public Expression {
+    std::span<Symbol> names;
+
+    /// The names get consecutive slots, set by the resolver
+    uint32_t firstSlot = 0;
+
+    NodeKind kind() const override {
+        return NodeKind::DestructuringDeclaration;
+    }
+
+    Value run(Context &context) override {
+        for (size_t i = 0; i < names.size(); ++i) {
+            context.slots[firstSlot + i] = {};
+        }
+        return {};
+    }
+
+    void assign(Context &context, Value value) override {
+        auto &array = value.as<Array>();
+        if (array.size() < names.size()) {
+            throw std::runtime_error{"not enough values to unpack"};
+        }
+        for (size_t i = 0; i < names.size(); ++i) {
+            context.slots[firstSlot + i] = array.at(i);
+        }
     }
 };
 
 struct Assignment : public Expression {
-    std::shared_ptr<Expression> left;
-    std::shared_ptr<Expression> right;
+    Expression *left = nullptr;
+    Expression *right = nullptr;
+
+    NodeKind kind() const override {
+        return NodeKind::Assignment;
+    }
 
     Value run(Context &context) override {
-        auto l = left->run(context);
-        auto r = right->run(context);
-        return l = r;
+        auto value = right->run(context);
+        left->assign(context, value);
+        return value;
+    }
+};
+
+/// `+=`, `-=` and so on. `op` is the operator without `=`
+struct CompoundAssignment : public Expression {
+    TokenType op = TokenType::Unknown;
+    Expression *left = nullptr;
+    Expression *right = nullptr;
+
+    NodeKind kind() const override {
+        return NodeKind::CompoundAssignment;
+    }
+
+    Value run(Context &context) override;
+};
+
+struct BinaryOperation : public Expression {
+    TokenType op = TokenType::Unknown;
+    Expression *left = nullptr;
+    Expression *right = nullptr;
+
+    NodeKind kind() const override {
+        return NodeKind::BinaryOperation;
+    }
+
+    Value run(Context &context) override {
+        return binaryOperation(op, left->run(context), right->run(context));
+    }
+};
+
+struct UnaryOperation : public Expression {
+    TokenType op = TokenType::Unknown;
+    Expression *operand = nullptr;
+
+    NodeKind kind() const override {
+        return NodeKind::UnaryOperation;
+    }
+
+    Value run(Context &context) override {
+        return unaryOperation(op, operand->run(context));
     }
 };
 
 struct VariableAccessor : public Expression {
-    Token name;
+    Symbol name;
+
+    /// Set by the resolver. Unresolved variables are looked up by name
+    SlotAddress address;
+
+    NodeKind kind() const override {
+        return NodeKind::VariableAccessor;
+    }
 
     Value run(Context &context) override {
-        return context.at(name);
+        return variable(context);
+    }
+
+    void assign(Context &context, Value value) override {
+        variable(context) = std::move(value);
+    }
+
+private:
+    Value &variable(Context &context) {
+        return address.isResolved() ? context.at(address)
+                                    : context.at(name);
     }
 };
 
 struct FunctionCall : public Expression {
-    std::shared_ptr<Expression> functionValue;
-    std::vector<std::shared_ptr<Expression>> arguments;
+    Expression *functionValue = nullptr;
+    std::span<Expression *> arguments;
+
+    NodeKind kind() const override {
+        return NodeKind::FunctionCall;
+    }
 
     Value run(Context &context) override {
         auto function = functionValue->run(context);
+        auto &f = function.as<Function>();
 
-        auto args = std::vector<Value>{};
-        args.resize(arguments.size());
-
-        for (auto &a : arguments) {
-            args.push_back(a->run(context));
-        }
+        auto frame = Frame{frameSize(f)};
+        setArguments(f, frame, arguments, context);
 
-        return call(function.as<Function>(), args, context);
+        return call(f, frame, context);
     }
 };
 
 struct StringLiteral : public Expression {
-    StringLiteral(Token text)
-        : text{text} {}
+    /// Points into the source buffer, the module cache or the arena
+    std::string_view text;
 
-    Token text;
+    NodeKind kind() const override {
+        return NodeKind::StringLiteral;
+    }
 
     Value run(Context &context) override {
-        return String{text.text};
+        return String{std::string{text}};
+    }
+};
+
+/// Numbers and `true`/`false`, converted when parsing. They are not stored as
+/// a Value, since large ints are objects that would have to be released
+struct Constant : public Expression {
+    using Literal = std::variant<Int, Float, Bool>;
+
+    Literal literal;
+
+    NodeKind kind() const override {
+        return NodeKind::Constant;
+    }
+
+    Value value() const {
+        return std::visit([](auto value) { return Value{value}; }, literal);
+    }
+
+    Value run(Context &context) override {
+        return value();
     }
 };
 
 struct ArrayDeclaration : public Expression {
+    NodeKind kind() const override {
+        return NodeKind::ArrayDeclaration;
+    }
+
     Value run(Context &context) override {
-        return std::make_shared<Array>();
+        return make<Array>();
+    }
+};
+
+struct DictionaryDeclaration : public Expression {
+    NodeKind kind() const override {
+        return NodeKind::DictionaryDeclaration;
+    }
+
+    Value run(Context &context) override {
+        return make<Dictionary>();
     }
 };
 
 struct ForDeclaration : public Expression {
-    std::shared_ptr<Section> section;
-    std::shared_ptr<Expression> declaration;
-    std::shared_ptr<Expression> range;
+    Section *section = nullptr;
+    Expression *declaration = nullptr;
+    Expression *range = nullptr;
+
+    NodeKind kind() const override {
+        return NodeKind::ForDeclaration;
+    }
 
     Value run(Context &context) override {
-        auto closure = Map{};
+        // The scope is reused for all iterations
+        auto frame = Frame{section->slotCount};
         auto newContext = Context{
-            .closure = &closure,
             .parent = &context,
+            .slots = frame.slots,
+            .returning = context.returning,
         };
 
         auto ret = Value{};
@@ -86,39 +250,189 @@ struct ForDeclaration : public Expression {
 
         auto r = range->run(newContext);
 
-        auto next = r.as<Map>()[t("next")].as<Function>();
+        // `let i` is written directly to its slot
+        auto variable = static_cast<Value *>(nullptr);
+        if (declaration->kind() == NodeKind::VariableDeclaration) {
+            auto slot = static_cast<VariableDeclaration &>(*declaration).slot;
+            variable = &newContext.slots[slot];
+        }
 
-        for (Value value; !(value = call(next, {r}, newContext)).asBool();) {
+        auto body = [&](Value value) {
+            if (variable) {
+                *variable = std::move(value);
+            }
+            else {
+                declaration->assign(newContext, std::move(value));
+            }
             ret = call(*section, newContext);
+            return !(context.returning && *context.returning);
+        };
+
+        // Integer ranges are counted here without an iterator
+        if (r.is<Range>()) {
+            auto &range = r.as<Range>();
+            for (auto i = range.begin; i < range.end; ++i) {
+                if (!body(Int{i})) {
+                    break;
+                }
+            }
+            return ret;
+        }
+
+        auto it = iterator(r);
+
+        if (it.is<Map>()) {
+            auto nextValue = it.as<Map>().at(symbols::Next);
+            auto &next = nextValue.as<Function>();
+            for (;;) {
+                auto value = Value{};
+                {
+                    auto nextFrame = Frame{frameSize(next)};
+                    nextFrame.slots[0] = it;
+                    value = call(next, nextFrame, newContext);
+                }
+                if (value.is<Void>() || !body(std::move(value))) {
+                    break;
+                }
+            }
+            return ret;
+        }
+
+        for (auto value = Value{}; advance(it, value);) {
+            if (!body(std::move(value))) {
+                break;
+            }
         }
 
         return ret;
     }
 };
 
+/// `array[index]`
+struct IndexAccessor : public Expression {
+    Expression *object = nullptr;
+    Expression *index = nullptr;
+
+    NodeKind kind() const override {
+        return NodeKind::IndexAccessor;
+    }
+
+    Value run(Context &context) override {
+        auto o = object->run(context);
+        return element(o, index->run(context));
+    }
+
+    void assign(Context &context, Value value) override {
+        auto o = object->run(context);
+        setElement(o, index->run(context), std::move(value));
+    }
+};
+
+inline Value CompoundAssignment::run(Context &context) {
+    // The array and the index are only run once, so `a[f()] += 1` calls `f`
+    // once
+    if (left->kind() == NodeKind::IndexAccessor) {
+        auto &accessor = static_cast<IndexAccessor &>(*left);
+        auto o = accessor.object->run(context);
+        auto i = accessor.index->run(context);
+        auto value = binaryOperation(op, element(o, i), right->run(context));
+        setElement(o, i, value);
+        return value;
+    }
+
+    auto value = binaryOperation(op, left->run(context), right->run(context));
+    left->assign(context, value);
+    return value;
+}
+
 // struct MemberAccessor : public Command {
 //     std::shared_ptr<Command> object;
 //     std::shared_ptr<Command> member;
 // };
 
 struct MemberFunctionCall : public Expression {
-    std::shared_ptr<Expression> object;
-    Token memberName;
-    std::vector<std::shared_ptr<Expression>> arguments;
+    Expression *object = nullptr;
+    Symbol memberName;
+    std::span<Expression *> arguments;
+
+    /// Not saved in the module cache
+    MemberCache cache;
+
+    NodeKind kind() const override {
+        return NodeKind::MemberFunctionCall;
+    }
 
     Value run(Context &context) override {
         auto o = object->run(context);
-        auto function = o.as<Map>()[memberName].as<Function>();
+        // Copy the value so that the function outlives changes to the map
+        auto member = members(o).at(memberName, cache);
+        auto &function = member.as<Function>();
+
+        auto frame = Frame{frameSize(function)};
+        frame.slots[0] = std::move(o);
+        setArguments(function, frame, arguments, context);
+
+        return call(function, frame, context);
+    }
+};
+
+/// `fn name(a, b) { ... }`. Functions are only declared at the top level of a
+/// module and are added to the module by `createModule`
+struct FunctionDeclaration : public Expression {
+    Symbol name;
+    std::span<Symbol> arguments;
+    Section *body = nullptr;
+
+    NodeKind kind() const override {
+        return NodeKind::FunctionDeclaration;
+    }
+
+    Value run(Context &context) override {
+        return {};
+    }
+};
+
+/// `if (condition) { ... } else { ... }`. The branches share the scope of the
+/// statement. `else if` is an else branch with a single if statement
+struct IfStatement : public Expression {
+    Expression *condition = nullptr;
+    Section *then = nullptr;
+    Section *otherwise = nullptr;
 
-        auto args = std::vector<Value>{};
-        args.resize(arguments.size() + 1);
+    NodeKind kind() const override {
+        return NodeKind::IfStatement;
+    }
 
-        for (auto &a : arguments) {
-            args.push_back(a->run(context));
+    Value run(Context &context) override {
+        if (condition->run(context).asBool()) {
+            return call(*then, context);
         }
+        if (otherwise) {
+            return call(*otherwise, context);
+        }
+        return {};
+    }
+};
+
+struct ReturnStatement : public Expression {
+    /// Null for `return;`
+    Expression *value = nullptr;
 
-        return call(function, args, context, o);
+    NodeKind kind() const override {
+        return NodeKind::ReturnStatement;
+    }
+
+    Value run(Context &context) override {
+        auto ret = value ? value->run(context) : Value{};
+        *context.returning = true;
+        return ret;
     }
 };
 
+// The arena only records destructors for types that need them, so freeing a
+// syntax tree does not visit its nodes
+#define NODE(x) static_assert(std::is_trivially_destructible_v<x>);
+NODE_LIST
+#undef NODE
+
 } // namespace vm
@@ -0,0 +1,218 @@
+#include "dictionary.h"
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <utility>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+namespace vm {
+
+namespace {
+
+constexpr size_t groupSize = 16;
+constexpr int8_t empty = -128;
+
+/// Spread the bits of `x` over the whole word, from splitmix64
+uint64_t mix(uint64_t x) {
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111eb;
+    return x ^ (x >> 31);
+}
+
+/// Keys that are `same` get the same hash
+uint64_t hash(const Value &key) {
+    if (key.is<Int>()) {
+        return mix(static_cast<uint64_t>(key.as<Int>().value));
+    }
+    if (key.is<Float>()) {
+        // Adding zero turns -0 into 0, which compares equal to it
+        auto value = key.as<Float>().value + 0.;
+        auto bits = uint64_t{};
+        std::memcpy(&bits, &value, sizeof(bits));
+        return mix(bits ^ 0x5555'5555'5555'5555);
+    }
+    if (key.is<String>()) {
+        return mix(std::hash<std::string_view>{}(key.as<String>().value));
+    }
+    if (key.is<Bool>()) {
+        return mix(key.as<Bool>().value + 2);
+    }
+    return mix(reinterpret_cast<uint64_t>(key.object()));
+}
+
+/// `same`, with the common int keys compared without a call. NaN is the same
+/// key as NaN, otherwise every `m[nan] = x` would add an entry that can not be
+/// found again
+bool sameKey(const Value &a, const Value &b) {
+    if (a.is<Int>() && b.is<Int>()) {
+        return a.as<Int>().value == b.as<Int>().value;
+    }
+    if (a.is<Float>() && b.is<Float>()) {
+        auto x = a.as<Float>().value;
+        auto y = b.as<Float>().value;
+        return x == y || (std::isnan(x) && std::isnan(y));
+    }
+    return same(a, b);
+}
+
+int8_t controlByte(uint64_t hash) {
+    return static_cast<int8_t>(hash & 0x7f);
+}
+
+/// Bit `i` is set if control byte `i` of the group is `byte`
+uint32_t match(const int8_t *group, int8_t byte) {
+#ifdef __SSE2__
+    auto bytes = _mm_loadu_si128(reinterpret_cast<const __m128i *>(group));
+    return static_cast<uint32_t>(
+        _mm_movemask_epi8(_mm_cmpeq_epi8(bytes, _mm_set1_epi8(byte))));
+#else
+    auto bits = uint32_t{0};
+    for (size_t i = 0; i < groupSize; ++i) {
+        bits |= uint32_t{group[i] == byte} << i;
+    }
+    return bits;
+#endif
+}
+
+/// Visits the groups that `hash` can be in, in probe order. Stepping one
+/// group further each time visits every group once when the number of groups
+/// is a power of two
+struct Probe {
+    Probe(uint64_t hash, size_t groups)
+        : mask{groups - 1}
+        , group{(hash >> 7) & mask} {}
+
+    size_t mask = 0;
+    size_t group = 0;
+    size_t step = 0;
+
+    void next() {
+        group = (group + ++step) & mask;
+    }
+};
+
+} // namespace
+
+Value *Dictionary::find(const Value &key) {
+    auto slot = find(key, hash(key));
+    return slot == notFound ? nullptr : &_entries[slot].value;
+}
+
+Value &Dictionary::operator[](const Value &key) {
+    auto h = hash(key);
+    auto slot = find(key, h);
+    if (slot != notFound) {
+        return _entries[slot].value;
+    }
+    return insert(key, h).value;
+}
+
+Value &Dictionary::at(const Value &key) {
+    if (auto value = find(key)) {
+        return *value;
+    }
+    throw std::runtime_error{"could not find key in dictionary"};
+}
+
+Value &Dictionary::increment(const Value &key, int64_t amount) {
+    auto &value = (*this)[key];
+    if (value.is<Int>()) {
+        // Unsigned, so that overflow wraps around like the Int operators
+        value = Int{static_cast<int64_t>(
+            static_cast<uint64_t>(value.as<Int>().value) + amount)};
+    }
+    else if (value.is<Void>()) {
+        value = Int{amount};
+    }
+    else {
+        value = binaryOperation(TokenType::Plus, value, Int{amount});
+    }
+    return value;
+}
+
+Ref<Array> Dictionary::keys() const {
+    auto keys = make<Array>();
+    for (size_t i = 0; i < _control.size(); ++i) {
+        if (_control[i] != empty) {
+            keys->push(_entries[i].key);
+        }
+    }
+    return keys;
+}
+
+size_t Dictionary::memory() const {
+    return _control.capacity() + _entries.capacity() * sizeof(Entry);
+}
+
+size_t Dictionary::find(const Value &key, uint64_t hash) const {
+    if (_control.empty()) {
+        return notFound;
+    }
+
+    auto byte = controlByte(hash);
+    for (auto probe = Probe{hash, _control.size() / groupSize};;
+         probe.next()) {
+        auto first = probe.group * groupSize;
+        auto group = _control.data() + first;
+        for (auto bits = match(group, byte); bits; bits &= bits - 1) {
+            auto slot = first + std::countr_zero(bits);
+            if (sameKey(_entries[slot].key, key)) {
+                return slot;
+            }
+        }
+        // Keys are never removed, so the probe would have stopped at the
+        // first empty slot when the key was inserted
+        if (match(group, empty)) {
+            return notFound;
+        }
+    }
+}
+
+Dictionary::Entry &Dictionary::insert(Value key, uint64_t hash) {
+    if (!_growthLeft) {
+        grow();
+    }
+
+    for (auto probe = Probe{hash, _control.size() / groupSize};;
+         probe.next()) {
+        auto first = probe.group * groupSize;
+        if (auto bits = match(_control.data() + first, empty)) {
+            auto slot = first + std::countr_zero(bits);
+            _control[slot] = controlByte(hash);
+            ++_size;
+            --_growthLeft;
+
+            auto &entry = _entries[slot];
+            entry.key = std::move(key);
+            return entry;
+        }
+    }
+}
+
+void Dictionary::grow() {
+    auto capacity = std::max(_control.size() * 2, groupSize);
+    auto control =
+        std::exchange(_control, std::vector<int8_t>(capacity, empty));
+    auto entries = std::exchange(_entries, std::vector<Entry>(capacity));
+
+    // A table is at most 7/8 full, so that probes find empty slots quickly
+    _size = 0;
+    _growthLeft = capacity / 8 * 7;
+
+    for (size_t i = 0; i < control.size(); ++i) {
+        if (control[i] != empty) {
+            auto &entry = entries[i];
+            auto h = hash(entry.key);
+            insert(std::move(entry.key), h).value = std::move(entry.value);
+        }
+    }
+}
+
+} // namespace vm
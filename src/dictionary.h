@@ -0,0 +1,79 @@
+#pragma once
+
+#include "vm.h"
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+namespace vm {
+
+/// `{}` in scripts. An open addressing hash map laid out like a Swiss table:
+/// the slots are split into groups of 16, and each slot has a control byte
+/// with 7 bits of the hash of its key. A lookup compares the control bytes of
+/// a whole group at once and only looks at the keys whose bytes match.
+///
+/// Ints, floats and strings are hashed by value, other objects by identity.
+/// Keys are compared with `same`. String keys share the string object with
+/// the value they were added with, since strings are not changed after they
+/// are made. Keys can not be removed
+struct Dictionary final : public Container {
+    static constexpr auto objectType = ObjectType::Dictionary;
+
+    void trace(const std::function<void(Value &)> &visit) override {
+        for (auto &entry : _entries) {
+            visit(entry.key);
+            visit(entry.value);
+        }
+    }
+
+    size_t size() const {
+        return _size;
+    }
+
+    /// Null when `key` is missing
+    Value *find(const Value &key);
+
+    /// Find or add `key`. Added keys have a void value
+    Value &operator[](const Value &key);
+
+    /// Throws when `key` is missing
+    Value &at(const Value &key);
+
+    /// Add `amount` to the value of `key`. Missing keys start at 0
+    Value &increment(const Value &key, int64_t amount = 1);
+
+    /// The keys in slot order, which is not the order they were added in
+    Ref<Array> keys() const;
+
+    /// Bytes allocated for the slots
+    size_t memory() const;
+
+private:
+    struct Entry {
+        Value key;
+        Value value;
+    };
+
+    static constexpr size_t notFound = SIZE_MAX;
+
+    /// Slot of `key`, or notFound
+    size_t find(const Value &key, uint64_t hash) const;
+
+    /// Store `key` in an empty slot. The key must be missing and there must
+    /// be room for it
+    Entry &insert(Value key, uint64_t hash);
+
+    /// Double the slots and insert the entries again
+    void grow();
+
+    /// One for each slot: `empty` or the low 7 bits of the hash of the key
+    std::vector<int8_t> _control;
+    std::vector<Entry> _entries;
+    size_t _size = 0;
+
+    /// Keys that can be added before the table has to grow
+    size_t _growthLeft = 0;
+};
+
+} // namespace vm
@@ -0,0 +1,313 @@
+#include "gc.h"
+#include "vm.h"
+#include <chrono>
+#include <new>
+#include <ostream>
+#include <vector>
+
+namespace vm {
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+/// Collections of a generation between collections of the next one
+constexpr size_t olderInterval = 10;
+
+/// Memory for small objects. Each size class has a list of freed cells, and
+/// new cells are bump allocated from a chunk shared by all classes. Chunks are
+/// kept for the life of the thread
+class Pool {
+public:
+    void *allocate(size_t size, gc::Stats &stats) {
+        auto index = (size - 1) / granularity;
+        if (auto cell = _free[index]) {
+            _free[index] = cell->next;
+            return cell;
+        }
+
+        auto cellSize = (index + 1) * granularity;
+        if (static_cast<size_t>(_end - _top) < cellSize) {
+            refill(stats);
+        }
+        auto cell = _top;
+        _top += cellSize;
+        return cell;
+    }
+
+    void deallocate(void *pointer, size_t size) {
+        auto index = (size - 1) / granularity;
+        auto cell = static_cast<Cell *>(pointer);
+        cell->next = _free[index];
+        _free[index] = cell;
+    }
+
+private:
+    static constexpr size_t granularity = 16;
+    static constexpr size_t chunkSize = 256 * 1024;
+
+    struct Cell {
+        Cell *next;
+    };
+
+    /// The first cell of each chunk points to the previous chunk
+    void refill(gc::Stats &stats) {
+        auto chunk = static_cast<char *>(::operator new(chunkSize));
+        static_cast<Cell *>(static_cast<void *>(chunk))->next = _chunks;
+        _chunks = static_cast<Cell *>(static_cast<void *>(chunk));
+        _top = chunk + granularity;
+        _end = chunk + chunkSize;
+        stats.poolBytes += chunkSize;
+    }
+
+    std::array<Cell *, gc::maxPooledSize / granularity> _free{};
+    Cell *_chunks = nullptr;
+    char *_top = nullptr;
+    char *_end = nullptr;
+};
+
+} // namespace
+
+/// Containers of a thread, kept in one intrusive list per generation. New
+/// containers start in the youngest generation and are moved to the next one
+/// when they survive a collection
+///
+/// Containers are also referenced from frames, the interpreter stack, modules
+/// and C++ variables, which are not known by the heap. These roots are found
+/// by subtracting the references between the collected containers from their
+/// reference counts: containers with references left are reachable from the
+/// outside, and so is everything they reference. The rest are cycles that
+/// only keep themselves alive
+class Heap {
+public:
+    void track(Container *container) {
+        container->tracked = true;
+        link(container, 0);
+        ++stats.tracked;
+
+        if (++_allocations >= _threshold && !_collecting) {
+            collectScheduled();
+        }
+    }
+
+    void untrack(Container *container) {
+        unlink(container);
+        --stats.tracked;
+    }
+
+    void setThreshold(size_t threshold) {
+        _threshold = threshold;
+    }
+
+    size_t collect(size_t generation) {
+        if (_collecting) {
+            return 0;
+        }
+        _collecting = true;
+        auto start = Clock::now();
+
+        auto objects = std::vector<Container *>{};
+        for (size_t i = 0; i <= generation; ++i) {
+            for (auto c = _first[i]; c; c = c->_next) {
+                c->_externalReferences = c->references;
+                c->_reachable = false;
+                objects.push_back(c);
+            }
+        }
+
+        auto collected = [generation](Value &value) -> Container * {
+            auto object = value.object();
+            if (!object || !object->tracked) {
+                return nullptr;
+            }
+            auto container = static_cast<Container *>(object);
+            return container->_generation <= generation ? container : nullptr;
+        };
+
+        for (auto c : objects) {
+            c->trace([&](Value &value) {
+                if (auto child = collected(value)) {
+                    --child->_externalReferences;
+                }
+            });
+        }
+
+        auto reachable = std::vector<Container *>{};
+        for (auto c : objects) {
+            if (c->_externalReferences > 0) {
+                c->_reachable = true;
+                reachable.push_back(c);
+            }
+        }
+
+        for (size_t i = 0; i < reachable.size(); ++i) {
+            reachable[i]->trace([&](Value &value) {
+                auto child = collected(value);
+                if (child && !child->_reachable) {
+                    child->_reachable = true;
+                    reachable.push_back(child);
+                }
+            });
+        }
+
+        // Survivors are promoted. The garbage stays in a list until it is
+        // destroyed, which unlinks it
+        auto older = std::min(generation + 1, generationCount - 1);
+        for (size_t i = 0; i <= generation; ++i) {
+            _first[i] = nullptr;
+        }
+        auto garbage = std::vector<Container *>{};
+        for (auto c : objects) {
+            link(c, c->_reachable ? older : 0);
+            if (!c->_reachable) {
+                garbage.push_back(c);
+            }
+        }
+
+        // Keep the garbage alive while the cycles are broken, so that every
+        // object is destroyed by its own release
+        for (auto c : garbage) {
+            retain(c);
+        }
+        for (auto c : garbage) {
+            c->trace([](Value &value) { value = {}; });
+        }
+        for (auto c : garbage) {
+            release(c);
+        }
+
+        for (size_t i = 0; i < generation; ++i) {
+            _sinceOlder[i] = 0;
+        }
+        if (generation + 1 < generationCount) {
+            ++_sinceOlder[generation];
+        }
+        _allocations = 0;
+
+        auto pause = Clock::now() - start;
+        ++stats.collections[generation];
+        stats.collected += garbage.size();
+        stats.totalPause += pause;
+        stats.maxPause = std::max<std::chrono::nanoseconds>(stats.maxPause,
+                                                            pause);
+
+        _collecting = false;
+        return garbage.size();
+    }
+
+    gc::Stats stats;
+    Pool pool;
+
+private:
+    void collectScheduled() {
+        auto generation = size_t{0};
+        while (generation + 1 < generationCount &&
+               _sinceOlder[generation] + 1 >= olderInterval) {
+            ++generation;
+        }
+        collect(generation);
+    }
+
+    void link(Container *container, size_t generation) {
+        container->_generation = static_cast<uint8_t>(generation);
+        container->_previous = nullptr;
+        container->_next = _first[generation];
+        if (container->_next) {
+            container->_next->_previous = container;
+        }
+        _first[generation] = container;
+    }
+
+    void unlink(Container *container) {
+        if (container->_previous) {
+            container->_previous->_next = container->_next;
+        }
+        else {
+            _first[container->_generation] = container->_next;
+        }
+        if (container->_next) {
+            container->_next->_previous = container->_previous;
+        }
+    }
+
+    static constexpr auto generationCount = gc::generationCount;
+
+    std::array<Container *, generationCount> _first{};
+
+    /// Collections of each generation since the next one was collected
+    std::array<size_t, generationCount> _sinceOlder{};
+
+    /// Containers made since the last collection
+    size_t _allocations = 0;
+    size_t _threshold = 700;
+    bool _collecting = false;
+};
+
+namespace {
+
+/// Trivially destructible, so that objects released by static destructors
+/// can still use it
+constinit thread_local auto heap = Heap{};
+
+} // namespace
+
+Container::~Container() {
+    if (tracked) {
+        heap.untrack(this);
+    }
+}
+
+namespace gc {
+
+void track(Container *container) {
+    heap.track(container);
+}
+
+const Stats &stats() {
+    return heap.stats;
+}
+
+void printStats(std::ostream &stream) {
+    auto &s = heap.stats;
+    auto ms = [](std::chrono::nanoseconds duration) {
+        return std::chrono::duration<double, std::milli>{duration}.count();
+    };
+
+    stream << "gc collections:";
+    for (auto count : s.collections) {
+        stream << " " << count;
+    }
+    stream << "\n";
+    stream << "gc collected:   " << s.collected << " objects\n";
+    stream << "gc tracked:     " << s.tracked << " containers\n";
+    stream << "gc pause:       " << ms(s.totalPause) << " ms total, "
+           << ms(s.maxPause) << " ms max\n";
+    stream << "gc pools:       " << s.poolBytes / 1024 << " KiB\n";
+}
+
+void setThreshold(size_t threshold) {
+    heap.setThreshold(threshold);
+}
+
+size_t collect(size_t generation) {
+    return heap.collect(std::min(generation, generationCount - 1));
+}
+
+void *allocate(size_t size) {
+    if (size > maxPooledSize) {
+        return ::operator new(size);
+    }
+    return heap.pool.allocate(size, heap.stats);
+}
+
+void deallocate(void *pointer, size_t size) {
+    if (size > maxPooledSize) {
+        ::operator delete(pointer);
+        return;
+    }
+    heap.pool.deallocate(pointer, size);
+}
+
+} // namespace gc
+
+} // namespace vm
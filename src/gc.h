@@ -0,0 +1,57 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <iosfwd>
+
+// Memory of heap objects. Objects are freed by their reference counts as soon
+// as the last reference is gone. Containers (objects that hold Values) are
+// also tracked by a generational cycle collector that frees the reference
+// cycles that counting can not. Small objects are allocated from pools
+
+namespace vm::gc {
+
+constexpr size_t generationCount = 3;
+
+struct Stats {
+    /// Collections of each generation. Collecting a generation also collects
+    /// the younger ones
+    std::array<size_t, generationCount> collections{};
+
+    /// Objects freed by the collector, that is objects in reference cycles
+    size_t collected = 0;
+
+    /// Containers that are tracked right now
+    size_t tracked = 0;
+
+    /// Memory taken from the system by the small object pools, which is kept
+    /// for reuse
+    size_t poolBytes = 0;
+
+    std::chrono::nanoseconds totalPause{};
+    std::chrono::nanoseconds maxPause{};
+};
+
+/// Statistics for the current thread
+const Stats &stats();
+
+void printStats(std::ostream &stream);
+
+/// Number of new containers that triggers a collection of the youngest
+/// generation. Older generations are collected every tenth collection of the
+/// generation below. A larger threshold gives fewer but longer pauses
+void setThreshold(size_t threshold);
+
+/// Free unreachable reference cycles in `generation` and all younger
+/// generations. Returns the number of freed objects
+size_t collect(size_t generation = generationCount - 1);
+
+/// Memory for objects up to `maxPooledSize` comes from pools where freed
+/// objects are reused, and new ones are bump allocated
+constexpr size_t maxPooledSize = 128;
+
+void *allocate(size_t size);
+void deallocate(void *pointer, size_t size);
+
+} // namespace vm::gc
@@ -0,0 +1,1292 @@
+#include "jit.h"
+#include "bytecode.h"
+#include "dictionary.h"
+#include "scriptprofiler.h"
+#include <array>
+#include <cstddef>
+#include <cstring>
+#include <span>
+#include <stdexcept>
+
+#if defined(__x86_64__) && defined(__linux__)
+#define MATSCRIPT_JIT
+#include <sys/mman.h>
+#endif
+
+namespace bytecode::jit {
+
+/// The work of each op. The interpreter does the same inline
+struct Runtime {
+    /// Operands are patched into the call as immediates. Returns 0 to
+    /// continue with the next op, or the Exit
+    using Function = uint32_t (*)(State *, uint64_t, uint32_t, uint32_t);
+
+    static OperandStack &stack(State *state) {
+        return *state->stack;
+    }
+
+    static vm::Value pop(State *state) {
+        auto &stack = Runtime::stack(state);
+        auto value = std::move(stack.back());
+        stack.pop_back();
+        return value;
+    }
+
+    static uint32_t constant(State *state, uint64_t value, uint32_t, uint32_t) {
+        stack(state).push_back(*reinterpret_cast<const vm::Value *>(value));
+        return 0;
+    }
+
+    static uint32_t pushVoid(State *state, uint64_t, uint32_t, uint32_t) {
+        stack(state).emplace_back();
+        return 0;
+    }
+
+    static uint32_t drop(State *state, uint64_t, uint32_t, uint32_t) {
+        stack(state).pop_back();
+        return 0;
+    }
+
+    static uint32_t dup(State *state, uint64_t, uint32_t, uint32_t) {
+        auto &stack = Runtime::stack(state);
+        stack.push_back(vm::Value{stack.back()});
+        return 0;
+    }
+
+    static uint32_t dupTwo(State *state, uint64_t, uint32_t, uint32_t) {
+        auto &stack = Runtime::stack(state);
+        auto size = stack.size();
+        stack.push_back(vm::Value{stack[size - 2]});
+        stack.push_back(vm::Value{stack[size - 1]});
+        return 0;
+    }
+
+    static uint32_t load(State *state, uint64_t, uint32_t name, uint32_t) {
+        stack(state).push_back(state->context->at(Symbol::fromId(name)));
+        return 0;
+    }
+
+    static uint32_t store(State *state, uint64_t, uint32_t name, uint32_t) {
+        state->context->at(Symbol::fromId(name)) = pop(state);
+        return 0;
+    }
+
+    static uint32_t loadSlot(State *state,
+                             uint64_t,
+                             uint32_t depth,
+                             uint32_t slot) {
+        stack(state).push_back(
+            state->context->at(vm::SlotAddress{depth, slot}));
+        return 0;
+    }
+
+    static uint32_t storeSlot(State *state,
+                              uint64_t,
+                              uint32_t depth,
+                              uint32_t slot) {
+        state->context->at(vm::SlotAddress{depth, slot}) = pop(state);
+        return 0;
+    }
+
+    static uint32_t defineSlot(State *state,
+                               uint64_t,
+                               uint32_t slot,
+                               uint32_t) {
+        auto &value = state->context->slots[slot];
+        value = {};
+        stack(state).push_back(value);
+        return 0;
+    }
+
+    static uint32_t loadIndex(State *state, uint64_t, uint32_t, uint32_t) {
+        auto index = pop(state);
+        auto array = pop(state);
+        stack(state).push_back(vm::element(array, index));
+        return 0;
+    }
+
+    static uint32_t storeIndex(State *state, uint64_t, uint32_t, uint32_t) {
+        auto index = pop(state);
+        auto array = pop(state);
+        vm::setElement(array, index, pop(state));
+        return 0;
+    }
+
+    static uint32_t storeIndexKeep(State *state,
+                                   uint64_t,
+                                   uint32_t,
+                                   uint32_t) {
+        auto value = pop(state);
+        auto index = pop(state);
+        auto &array = stack(state).back();
+        vm::setElement(array, index, value);
+        array = std::move(value);
+        return 0;
+    }
+
+    static uint32_t binary(State *state, uint64_t, uint32_t op, uint32_t) {
+        auto &stack = Runtime::stack(state);
+        auto &left = stack[stack.size() - 2];
+        left = vm::binaryOperation(
+            static_cast<TokenType>(op), left, stack.back());
+        stack.pop_back();
+        return 0;
+    }
+
+    static uint32_t binaryConstant(State *state,
+                                   uint64_t right,
+                                   uint32_t op,
+                                   uint32_t) {
+        auto &left = stack(state).back();
+        left = vm::binaryOperation(static_cast<TokenType>(op),
+                                   left,
+                                   *reinterpret_cast<const vm::Value *>(right));
+        return 0;
+    }
+
+    static uint32_t unary(State *state, uint64_t, uint32_t op, uint32_t) {
+        auto &stack = Runtime::stack(state);
+        stack.back() =
+            vm::unaryOperation(static_cast<TokenType>(op), stack.back());
+        return 0;
+    }
+
+    static uint32_t newArray(State *state, uint64_t, uint32_t, uint32_t) {
+        stack(state).emplace_back(vm::make<vm::Array>());
+        return 0;
+    }
+
+    static uint32_t newDictionary(State *state,
+                                  uint64_t,
+                                  uint32_t,
+                                  uint32_t) {
+        stack(state).emplace_back(vm::make<vm::Dictionary>());
+        return 0;
+    }
+
+    static uint32_t call(State *state, uint64_t, uint32_t count, uint32_t) {
+        auto &stack = Runtime::stack(state);
+        auto &interpreter = *state->interpreter;
+        auto function = std::move(stack[stack.size() - count - 1]);
+        auto &f = function.as<vm::Function>();
+        auto frame = vm::Frame{vm::frameSize(f)};
+        interpreter.popArguments(f, frame, count);
+        auto result = interpreter.call(f, frame, *state->context);
+        stack.push_back(std::move(result));
+        return 0;
+    }
+
+    static uint32_t callMember(State *state,
+                               uint64_t cache,
+                               uint32_t name,
+                               uint32_t count) {
+        auto &stack = Runtime::stack(state);
+        auto &interpreter = *state->interpreter;
+        auto &object = stack[stack.size() - count - 1];
+        auto member = vm::members(object).at(
+            Symbol::fromId(name), *reinterpret_cast<vm::MemberCache *>(cache));
+        auto &f = member.as<vm::Function>();
+        auto frame = vm::Frame{vm::frameSize(f)};
+        frame.slots[0] = std::move(object);
+        interpreter.popArguments(f, frame, count);
+        auto result = interpreter.call(f, frame, *state->context);
+        stack.push_back(std::move(result));
+        return 0;
+    }
+
+    static uint32_t pushScope(State *state, uint64_t, uint32_t size, uint32_t) {
+        state->context =
+            &state->interpreter->pushScope(size, state->context).context;
+        return 0;
+    }
+
+    static uint32_t popScope(State *state, uint64_t, uint32_t, uint32_t) {
+        state->context = state->context->parent;
+        state->interpreter->popScope();
+        return 0;
+    }
+
+    /// Returns 1 for true and 0 for false
+    static uint32_t condition(State *state, uint64_t, uint32_t, uint32_t) {
+        return pop(state).asBool();
+    }
+
+    static uint32_t iterStart(State *state, uint64_t, uint32_t, uint32_t) {
+        state->interpreter->iterStart();
+        return 0;
+    }
+
+    /// Returns 1 when the loop is done, and 0 with the item pushed
+    static uint32_t iterNext(State *state, uint64_t cache, uint32_t, uint32_t) {
+        auto &stack = Runtime::stack(state);
+        auto size = stack.size();
+        auto value = vm::Value{};
+        if (!state->interpreter->advance(
+                stack[size - 2],
+                stack[size - 1],
+                *reinterpret_cast<vm::MemberCache *>(cache),
+                value,
+                *state->context)) {
+            return 1;
+        }
+        stack.push_back(std::move(value));
+        return 0;
+    }
+
+    /// Returns 1 when the loop is done, and 0 with the item in `slot`
+    static uint32_t iterNextLocal(State *state,
+                                  uint64_t cache,
+                                  uint32_t slot,
+                                  uint32_t) {
+        auto &stack = Runtime::stack(state);
+        auto size = stack.size();
+        auto value = vm::Value{};
+        if (!state->interpreter->advance(
+                stack[size - 2],
+                stack[size - 1],
+                *reinterpret_cast<vm::MemberCache *>(cache),
+                value,
+                *state->context)) {
+            return 1;
+        }
+        state->context->slots[slot] = std::move(value);
+        return 0;
+    }
+
+    static uint32_t storeUnder(State *state,
+                               uint64_t,
+                               uint32_t depth,
+                               uint32_t) {
+        auto &stack = Runtime::stack(state);
+        auto value = pop(state);
+        stack[stack.size() - 1 - depth] = std::move(value);
+        return 0;
+    }
+
+    static uint32_t statement(State *, uint64_t e, uint32_t, uint32_t) {
+        scriptprofiler::statement(*reinterpret_cast<vm::Expression *>(e));
+        return 0;
+    }
+
+    static uint32_t returnValue(State *state, uint64_t, uint32_t, uint32_t) {
+        state->result = pop(state);
+        return static_cast<uint32_t>(Exit::Return);
+    }
+
+    static uint32_t deoptimize(State *state,
+                               uint64_t,
+                               uint32_t offset,
+                               uint32_t) {
+        state->resume = offset;
+        return static_cast<uint32_t>(Exit::Deoptimize);
+    }
+
+    /// Exceptions can not be thrown through the machine code, which has no
+    /// unwind information. They are thrown again by the interpreter
+    template <Function f>
+    static uint32_t guarded(State *state,
+                            uint64_t a,
+                            uint32_t b,
+                            uint32_t c) noexcept {
+        try {
+            return f(state, a, b, c);
+        }
+        catch (...) {
+            state->error = std::current_exception();
+            return static_cast<uint32_t>(Exit::Error);
+        }
+    }
+};
+
+Code::Code(void *memory, size_t size, std::vector<int32_t> entries)
+    : _memory{memory}
+    , _size{size}
+    , _entries{std::move(entries)} {}
+
+#ifdef MATSCRIPT_JIT
+
+namespace {
+
+// Stencils are machine code with holes for the operands. `State *` is kept in
+// r12 and passed to the runtime functions in rdi, and the operand stack is
+// kept in rbx.
+//
+// Ops on immediate values have a fast path of stencils that work on the
+// values directly. Guards check the types, and jump to the slow path, which
+// calls the runtime function of the op, if the fast path does not handle them
+
+static_assert(offsetof(State, stack) == 8);
+static_assert(offsetof(State, context) == 16);
+static_assert(offsetof(vm::Context, parent) == 8);
+static_assert(offsetof(vm::Context, slots) == 16);
+static_assert(OperandStack::endOffset() == 0);
+static_assert(OperandStack::capacityOffset() == 8);
+
+// Tags in the upper 16 bits, as compared by the stencils
+static_assert(vm::Value::voidBits == 0xfff9ull << 48);
+static_assert(vm::Value::boolTag == 0xfffaull << 48);
+static_assert(vm::Value::intTag == 0xfffbull << 48);
+static_assert(vm::Value::objectTag == 0xfffcull << 48);
+static_assert(vm::Value::minImmediateInt == -(int64_t{1} << 47));
+
+// clang-format off
+
+/// Saves r12 and rbx, loads the operand stack and jumps to the entry in rsi.
+/// rbp is pushed to keep the stack aligned for calls
+constexpr auto prologue = std::to_array<uint8_t>({
+    0x55,                   // push rbp
+    0x41, 0x54,             // push r12
+    0x53,                   // push rbx
+    0x49, 0x89, 0xfc,       // mov r12, rdi
+    0x48, 0x8b, 0x5f, 0x08, // mov rbx, [rdi + State::stack]
+    0xff, 0xe6,             // jmp rsi
+});
+
+/// Returns the exit in eax
+constexpr auto epilogue = std::to_array<uint8_t>({
+    0x5b,                   // pop rbx
+    0x41, 0x5c,             // pop r12
+    0x5d,                   // pop rbp
+    0xc3,                   // ret
+});
+
+/// Call a runtime function with three operands
+constexpr auto callStencil = std::to_array<uint8_t>({
+    0x4c, 0x89, 0xe7,       // mov rdi, r12
+    0x48, 0xbe, 0, 0, 0, 0, 0, 0, 0, 0, // movabs rsi, a
+    0xba, 0, 0, 0, 0,       // mov edx, b
+    0xb9, 0, 0, 0, 0,       // mov ecx, c
+    0x48, 0xb8, 0, 0, 0, 0, 0, 0, 0, 0, // movabs rax, function
+    0xff, 0xd0,             // call rax
+});
+
+constexpr size_t holeA = 5;
+constexpr size_t holeB = 14;
+constexpr size_t holeC = 19;
+constexpr size_t holeFunction = 25;
+
+/// Leave if the runtime function returned an exit
+constexpr auto exitStencil = std::to_array<uint8_t>({
+    0x85, 0xc0,             // test eax, eax
+    0x0f, 0x85, 0, 0, 0, 0, // jnz epilogue
+});
+
+/// After `Runtime::condition`: jump to the target if the condition has the
+/// value in the condition code, and leave on errors
+constexpr auto branchStencil = std::to_array<uint8_t>({
+    0x83, 0xf8, 0x01,       // cmp eax, 1
+    0x0f, 0x00, 0, 0, 0, 0, // je/jb target
+    0x0f, 0x87, 0, 0, 0, 0, // ja epilogue
+});
+
+constexpr size_t holeCondition = 4;
+constexpr size_t holeTarget = 5;
+constexpr size_t holeBranchExit = 11;
+constexpr uint8_t jumpIfEqual = 0x84;
+constexpr uint8_t jumpIfNotEqual = 0x85;
+constexpr uint8_t jumpIfBelow = 0x82;
+
+constexpr auto jumpStencil = std::to_array<uint8_t>({
+    0xe9, 0, 0, 0, 0,       // jmp target
+});
+
+/// rax = the current context
+constexpr auto contextStencil = std::to_array<uint8_t>({
+    0x49, 0x8b, 0x44, 0x24, 0x10, // mov rax, [r12 + State::context]
+});
+
+/// rax = the parent of the context in rax
+constexpr auto parentStencil = std::to_array<uint8_t>({
+    0x48, 0x8b, 0x40, 0x08, // mov rax, [rax + Context::parent]
+});
+
+/// rdx = the address of a slot of the context in rax
+constexpr auto slotStencil = std::to_array<uint8_t>({
+    0x48, 0x8b, 0x50, 0x10, // mov rdx, [rax + Context::slots]
+    0x48, 0x8d, 0x92, 0, 0, 0, 0, // lea rdx, [rdx + slot * 8]
+});
+
+constexpr size_t holeSlot = 7;
+
+/// rax = the value in the slot at rdx
+constexpr auto loadStencil = std::to_array<uint8_t>({
+    0x48, 0x8b, 0x02,       // mov rax, [rdx]
+});
+
+/// rax = the value on top of the stack
+constexpr auto topStencil = std::to_array<uint8_t>({
+    0x48, 0x8b, 0x03,       // mov rax, [rbx + OperandStack::end]
+    0x48, 0x8b, 0x40, 0xf8, // mov rax, [rax - 8]
+});
+
+/// rax = a value
+constexpr auto valueStencil = std::to_array<uint8_t>({
+    0x48, 0xb8, 0, 0, 0, 0, 0, 0, 0, 0, // movabs rax, value
+});
+
+constexpr size_t holeValue = 2;
+
+/// Guard that the value in rax is not an object, so that it can be copied and
+/// dropped without changing reference counts
+constexpr auto immediateStencil = std::to_array<uint8_t>({
+    0x48, 0x89, 0xc1,       // mov rcx, rax
+    0x48, 0xc1, 0xe9, 0x30, // shr rcx, 48
+    0x81, 0xf9, 0xfc, 0xff, 0x00, 0x00, // cmp ecx, objectTag
+    0x0f, 0x83, 0, 0, 0, 0, // jae slow
+});
+
+constexpr size_t holeImmediateGuard = 15;
+
+/// Push rax, if the stack does not have to grow
+constexpr auto pushStencil = std::to_array<uint8_t>({
+    0x48, 0x8b, 0x0b,       // mov rcx, [rbx + OperandStack::end]
+    0x48, 0x3b, 0x4b, 0x08, // cmp rcx, [rbx + OperandStack::capacity]
+    0x0f, 0x83, 0, 0, 0, 0, // jae slow
+    0x48, 0x89, 0x01,       // mov [rcx], rax
+    0x48, 0x83, 0xc1, 0x08, // add rcx, 8
+    0x48, 0x89, 0x0b,       // mov [rbx + OperandStack::end], rcx
+});
+
+constexpr size_t holePushGuard = 9;
+
+/// Drop the value on top of the stack
+constexpr auto dropStencil = std::to_array<uint8_t>({
+    0x48, 0x83, 0x2b, 0x08, // sub qword [rbx + OperandStack::end], 8
+});
+
+/// Move the value on top of the stack to the slot at rdx
+constexpr auto storeStencil = std::to_array<uint8_t>({
+    0x48, 0x8b, 0x0b,       // mov rcx, [rbx + OperandStack::end]
+    0x48, 0x83, 0xe9, 0x08, // sub rcx, 8
+    0x48, 0x8b, 0x01,       // mov rax, [rcx]
+    0x48, 0x89, 0x02,       // mov [rdx], rax
+    0x48, 0x89, 0x0b,       // mov [rbx + OperandStack::end], rcx
+});
+
+/// Move the value on top of the stack below `depth` other values, if the
+/// value it replaces is not an object
+constexpr auto storeUnderStencil = std::to_array<uint8_t>({
+    0x48, 0x8b, 0x0b,       // mov rcx, [rbx + OperandStack::end]
+    0x48, 0x8b, 0x81, 0, 0, 0, 0, // mov rax, [rcx - (depth + 2) * 8]
+    0x48, 0x89, 0xc2,       // mov rdx, rax
+    0x48, 0xc1, 0xea, 0x30, // shr rdx, 48
+    0x81, 0xfa, 0xfc, 0xff, 0x00, 0x00, // cmp edx, objectTag
+    0x0f, 0x83, 0, 0, 0, 0, // jae slow
+    0x48, 0x8b, 0x41, 0xf8, // mov rax, [rcx - 8]
+    0x48, 0x89, 0x81, 0, 0, 0, 0, // mov [rcx - (depth + 2) * 8], rax
+    0x48, 0x83, 0xe9, 0x08, // sub rcx, 8
+    0x48, 0x89, 0x0b,       // mov [rbx + OperandStack::end], rcx
+});
+
+constexpr size_t holeUnderLoad = 6;
+constexpr size_t holeUnderGuard = 25;
+constexpr size_t holeUnderStore = 36;
+
+/// rax = the left and rcx = the right operand of `Binary`
+constexpr auto operandsStencil = std::to_array<uint8_t>({
+    0x48, 0x8b, 0x0b,       // mov rcx, [rbx + OperandStack::end]
+    0x48, 0x8b, 0x41, 0xf0, // mov rax, [rcx - 16]
+    0x48, 0x8b, 0x49, 0xf8, // mov rcx, [rcx - 8]
+});
+
+/// rcx = the constant right operand of `BinaryConstant`
+constexpr auto rightStencil = std::to_array<uint8_t>({
+    0x48, 0xb9, 0, 0, 0, 0, 0, 0, 0, 0, // movabs rcx, value
+});
+
+/// Guard that rax and rcx are immediate ints, and sign extend them
+constexpr auto intStencil = std::to_array<uint8_t>({
+    0x48, 0x89, 0xc2,       // mov rdx, rax
+    0x48, 0xc1, 0xea, 0x30, // shr rdx, 48
+    0x81, 0xfa, 0xfb, 0xff, 0x00, 0x00, // cmp edx, intTag
+    0x0f, 0x85, 0, 0, 0, 0, // jne next
+    0x48, 0x89, 0xca,       // mov rdx, rcx
+    0x48, 0xc1, 0xea, 0x30, // shr rdx, 48
+    0x81, 0xfa, 0xfb, 0xff, 0x00, 0x00, // cmp edx, intTag
+    0x0f, 0x85, 0, 0, 0, 0, // jne next
+    0x48, 0xc1, 0xe0, 0x10, // shl rax, 16
+    0x48, 0xc1, 0xf8, 0x10, // sar rax, 16
+    0x48, 0xc1, 0xe1, 0x10, // shl rcx, 16
+    0x48, 0xc1, 0xf9, 0x10, // sar rcx, 16
+});
+
+constexpr size_t holeIntLeftGuard = 15;
+constexpr size_t holeIntRightGuard = 34;
+
+constexpr auto addStencil = std::to_array<uint8_t>({
+    0x48, 0x01, 0xc8,       // add rax, rcx
+});
+
+constexpr auto subtractStencil = std::to_array<uint8_t>({
+    0x48, 0x29, 0xc8,       // sub rax, rcx
+});
+
+constexpr auto multiplyStencil = std::to_array<uint8_t>({
+    0x48, 0x0f, 0xaf, 0xc1, // imul rax, rcx
+    0x0f, 0x80, 0, 0, 0, 0, // jo slow
+});
+
+constexpr size_t holeOverflowGuard = 6;
+
+/// Tag the int in rax, if it fits in an immediate int
+constexpr auto intResultStencil = std::to_array<uint8_t>({
+    0x48, 0x89, 0xc2,       // mov rdx, rax
+    0x48, 0xc1, 0xe2, 0x10, // shl rdx, 16
+    0x48, 0xc1, 0xfa, 0x10, // sar rdx, 16
+    0x48, 0x39, 0xc2,       // cmp rdx, rax
+    0x0f, 0x85, 0, 0, 0, 0, // jne slow
+    0x48, 0xc1, 0xe0, 0x10, // shl rax, 16
+    0x48, 0xc1, 0xe8, 0x10, // shr rax, 16
+    0x48, 0xba, 0, 0, 0, 0, 0, 0, 0xfb, 0xff, // movabs rdx, intTag
+    0x48, 0x09, 0xd0,       // or rax, rdx
+});
+
+constexpr size_t holeIntResultGuard = 16;
+
+/// al = the comparison of rax and rcx in the condition code
+constexpr auto intCompareStencil = std::to_array<uint8_t>({
+    0x48, 0x39, 0xc8,       // cmp rax, rcx
+    0x0f, 0x00, 0xc0,       // setcc al
+});
+
+constexpr size_t holeSetCondition = 4;
+constexpr uint8_t setIfLess = 0x9c;
+constexpr uint8_t setIfLessEqual = 0x9e;
+constexpr uint8_t setIfGreater = 0x9f;
+constexpr uint8_t setIfGreaterEqual = 0x9d;
+constexpr uint8_t setIfEqual = 0x94;
+constexpr uint8_t setIfNotEqual = 0x95;
+constexpr uint8_t setIfAbove = 0x97;
+constexpr uint8_t setIfAboveEqual = 0x93;
+
+/// Tag the bool in al
+constexpr auto boolResultStencil = std::to_array<uint8_t>({
+    0x0f, 0xb6, 0xc0,       // movzx eax, al
+    0x48, 0xba, 0, 0, 0, 0, 0, 0, 0xfa, 0xff, // movabs rdx, boolTag
+    0x48, 0x09, 0xd0,       // or rax, rdx
+});
+
+/// Guard that rax and rcx are floats, and move them to xmm0 and xmm1
+constexpr auto floatStencil = std::to_array<uint8_t>({
+    0x48, 0xba, 0, 0, 0, 0, 0, 0, 0xf9, 0xff, // movabs rdx, voidBits
+    0x48, 0x39, 0xd0,       // cmp rax, rdx
+    0x0f, 0x83, 0, 0, 0, 0, // jae slow
+    0x48, 0x39, 0xd1,       // cmp rcx, rdx
+    0x0f, 0x83, 0, 0, 0, 0, // jae slow
+    0x66, 0x48, 0x0f, 0x6e, 0xc0, // movq xmm0, rax
+    0x66, 0x48, 0x0f, 0x6e, 0xc9, // movq xmm1, rcx
+});
+
+constexpr size_t holeFloatLeftGuard = 15;
+constexpr size_t holeFloatRightGuard = 24;
+
+/// xmm0 = xmm0 op xmm1
+constexpr auto floatArithmeticStencil = std::to_array<uint8_t>({
+    0xf2, 0x0f, 0x00, 0xc1, // addsd/subsd/mulsd/divsd xmm0, xmm1
+});
+
+constexpr size_t holeFloatOp = 2;
+constexpr uint8_t addFloat = 0x58;
+constexpr uint8_t subtractFloat = 0x5c;
+constexpr uint8_t multiplyFloat = 0x59;
+constexpr uint8_t divideFloat = 0x5e;
+
+/// rax = xmm0, unless it is a NaN, which values store in one canonical form
+constexpr auto floatResultStencil = std::to_array<uint8_t>({
+    0x66, 0x0f, 0x2e, 0xc0, // ucomisd xmm0, xmm0
+    0x0f, 0x8a, 0, 0, 0, 0, // jp slow
+    0x66, 0x48, 0x0f, 0x7e, 0xc0, // movq rax, xmm0
+});
+
+constexpr size_t holeNanGuard = 6;
+
+/// al = the comparison of xmm0 and xmm1, or of xmm1 and xmm0 when swapped.
+/// Above and above or equal are false for NaNs
+constexpr auto floatCompareStencil = std::to_array<uint8_t>({
+    0x66, 0x0f, 0x2e, 0x00, // ucomisd xmm0, xmm1 or xmm1, xmm0
+    0x0f, 0x00, 0xc0,       // seta/setae al
+});
+
+constexpr size_t holeFloatOperands = 3;
+constexpr size_t holeFloatSetCondition = 5;
+constexpr uint8_t floatOperands = 0xc1;
+constexpr uint8_t floatOperandsSwapped = 0xc8;
+
+/// al = xmm0 == xmm1, which is false for NaNs
+constexpr auto floatEqualStencil = std::to_array<uint8_t>({
+    0x66, 0x0f, 0x2e, 0xc1, // ucomisd xmm0, xmm1
+    0x0f, 0x94, 0xc0,       // sete al
+    0x0f, 0x9b, 0xc1,       // setnp cl
+    0x20, 0xc8,             // and al, cl
+});
+
+/// al = xmm0 != xmm1, which is true for NaNs
+constexpr auto floatNotEqualStencil = std::to_array<uint8_t>({
+    0x66, 0x0f, 0x2e, 0xc1, // ucomisd xmm0, xmm1
+    0x0f, 0x95, 0xc0,       // setne al
+    0x0f, 0x9a, 0xc1,       // setp cl
+    0x08, 0xc8,             // or al, cl
+});
+
+/// Replace the two operands of `Binary` with rax
+constexpr auto binaryResultStencil = std::to_array<uint8_t>({
+    0x48, 0x8b, 0x0b,       // mov rcx, [rbx + OperandStack::end]
+    0x48, 0x89, 0x41, 0xf0, // mov [rcx - 16], rax
+    0x48, 0x83, 0xe9, 0x08, // sub rcx, 8
+    0x48, 0x89, 0x0b,       // mov [rbx + OperandStack::end], rcx
+});
+
+/// Replace the left operand of `BinaryConstant` with rax
+constexpr auto binaryConstantResultStencil = std::to_array<uint8_t>({
+    0x48, 0x8b, 0x0b,       // mov rcx, [rbx + OperandStack::end]
+    0x48, 0x89, 0x41, 0xf8, // mov [rcx - 8], rax
+});
+
+/// Pop a bool and jump to the target if it is true (jne) or false (je)
+constexpr auto boolBranchStencil = std::to_array<uint8_t>({
+    0x48, 0x8b, 0x0b,       // mov rcx, [rbx + OperandStack::end]
+    0x48, 0x8b, 0x41, 0xf8, // mov rax, [rcx - 8]
+    0x48, 0x89, 0xc2,       // mov rdx, rax
+    0x48, 0xc1, 0xea, 0x30, // shr rdx, 48
+    0x81, 0xfa, 0xfa, 0xff, 0x00, 0x00, // cmp edx, boolTag
+    0x0f, 0x85, 0, 0, 0, 0, // jne slow
+    0x48, 0x83, 0xe9, 0x08, // sub rcx, 8
+    0x48, 0x89, 0x0b,       // mov [rbx + OperandStack::end], rcx
+    0xa8, 0x01,             // test al, 1
+    0x0f, 0x00, 0, 0, 0, 0, // jne/je target
+});
+
+constexpr size_t holeBoolGuard = 22;
+constexpr size_t holeBoolCondition = 36;
+constexpr size_t holeBoolTarget = 37;
+
+/// `IterNextLocal` on an int range, with the local slot at rdx: store the
+/// counter in the slot and increase it, or jump to the target when it has
+/// reached the end
+constexpr auto intRangeStencil = std::to_array<uint8_t>({
+    0x48, 0x8b, 0x3a,       // mov rdi, [rdx]
+    0x48, 0xc1, 0xef, 0x30, // shr rdi, 48
+    0x81, 0xff, 0xfc, 0xff, 0x00, 0x00, // cmp edi, objectTag
+    0x0f, 0x83, 0, 0, 0, 0, // jae slow
+    0x48, 0x8b, 0x0b,       // mov rcx, [rbx + OperandStack::end]
+    0x48, 0x8b, 0x41, 0xf0, // mov rax, [rcx - 16]
+    0x48, 0x8b, 0x71, 0xf8, // mov rsi, [rcx - 8]
+    0x48, 0x89, 0xc7,       // mov rdi, rax
+    0x48, 0xc1, 0xef, 0x30, // shr rdi, 48
+    0x81, 0xff, 0xfb, 0xff, 0x00, 0x00, // cmp edi, intTag
+    0x0f, 0x85, 0, 0, 0, 0, // jne slow
+    0x48, 0x89, 0xf7,       // mov rdi, rsi
+    0x48, 0xc1, 0xef, 0x30, // shr rdi, 48
+    0x81, 0xff, 0xfb, 0xff, 0x00, 0x00, // cmp edi, intTag
+    0x0f, 0x85, 0, 0, 0, 0, // jne slow
+    0x48, 0xc1, 0xe6, 0x10, // shl rsi, 16
+    0x48, 0xc1, 0xfe, 0x10, // sar rsi, 16
+    0x48, 0x89, 0xc7,       // mov rdi, rax
+    0x48, 0xc1, 0xe7, 0x10, // shl rdi, 16
+    0x48, 0xc1, 0xff, 0x10, // sar rdi, 16
+    0x48, 0x39, 0xf7,       // cmp rdi, rsi
+    0x0f, 0x8d, 0, 0, 0, 0, // jge target
+    0x48, 0x89, 0x02,       // mov [rdx], rax
+    0x48, 0x83, 0xc7, 0x01, // add rdi, 1
+    0x48, 0xc1, 0xe7, 0x10, // shl rdi, 16
+    0x48, 0xc1, 0xef, 0x10, // shr rdi, 16
+    0x48, 0xbe, 0, 0, 0, 0, 0, 0, 0xfb, 0xff, // movabs rsi, intTag
+    0x48, 0x09, 0xf7,       // or rdi, rsi
+    0x48, 0x89, 0x79, 0xf0, // mov [rcx - 16], rdi
+});
+
+constexpr size_t holeRangeSlotGuard = 15;
+constexpr size_t holeRangeCounterGuard = 45;
+constexpr size_t holeRangeEndGuard = 64;
+constexpr size_t holeRangeTarget = 92;
+
+// clang-format on
+
+/// The machine code reads the data pointer of `Context::slots` directly, which
+/// has to be the first member of a span
+bool slotsFirst() {
+    auto value = vm::Value{};
+    auto slots = std::span<vm::Value>{&value, 1};
+    auto data = static_cast<vm::Value *>(nullptr);
+    std::memcpy(&data, &slots, sizeof(data));
+    return data == &value;
+}
+
+template <typename T>
+T read(const uint8_t *&pc) {
+    auto value = T{};
+    std::memcpy(&value, pc, sizeof(T));
+    pc += sizeof(T);
+    return value;
+}
+
+class Compiler {
+public:
+    explicit Compiler(Chunk &chunk)
+        : _chunk{chunk}
+        , _entries(chunk.code.size(), -1) {}
+
+    std::shared_ptr<Code> compile() {
+        copy(prologue);
+
+        auto begin = static_cast<const uint8_t *>(_chunk.code.data());
+        auto end = begin + _chunk.code.size();
+        for (auto pc = begin; pc < end;) {
+            _entries[pc - begin] = static_cast<int32_t>(_code.size());
+            _pathStart = _code.size();
+            op(pc);
+        }
+
+        auto epilogueStart = _code.size();
+        copy(epilogue);
+
+        for (auto position : _exits) {
+            patchRelative(position, epilogueStart);
+        }
+        for (auto [position, target] : _jumps) {
+            patchRelative(position, _entries.at(target));
+        }
+
+        return map();
+    }
+
+private:
+    void op(const uint8_t *&pc) {
+        auto offset = static_cast<uint32_t>(pc - _chunk.code.data());
+        switch (static_cast<Op>(*pc++)) {
+        case Op::Constant: {
+            auto &value = _chunk.constants.at(read<uint32_t>(pc));
+            if (!value.object()) {
+                push(value.bits());
+            }
+            slowPath();
+            call<Runtime::constant>(reinterpret_cast<uint64_t>(&value));
+            endOp();
+            return;
+        }
+        case Op::Void:
+            push(vm::Value::voidBits);
+            slowPath();
+            call<Runtime::pushVoid>();
+            endOp();
+            return;
+        case Op::Pop:
+            copy(topStencil);
+            fast(immediateStencil, holeImmediateGuard);
+            copy(dropStencil);
+            slowPath();
+            call<Runtime::drop>();
+            endOp();
+            return;
+        case Op::Dup:
+            copy(topStencil);
+            fast(immediateStencil, holeImmediateGuard);
+            fast(pushStencil, holePushGuard);
+            slowPath();
+            call<Runtime::dup>();
+            endOp();
+            return;
+        case Op::DupTwo:
+            call<Runtime::dupTwo>();
+            return;
+        case Op::Load:
+            call<Runtime::load>(0, read<uint32_t>(pc));
+            return;
+        case Op::Store:
+            call<Runtime::store>(0, read<uint32_t>(pc));
+            return;
+        case Op::LoadSlot: {
+            auto depth = read<uint32_t>(pc);
+            loadSlot(depth, read<uint32_t>(pc));
+            return;
+        }
+        case Op::LoadLocal:
+            loadSlot(0, read<uint32_t>(pc));
+            return;
+        case Op::StoreSlot: {
+            auto depth = read<uint32_t>(pc);
+            auto slot = read<uint32_t>(pc);
+            // The old value is dropped without releasing it
+            slotAddress(depth, slot);
+            copy(loadStencil);
+            fast(immediateStencil, holeImmediateGuard);
+            copy(storeStencil);
+            slowPath();
+            call<Runtime::storeSlot>(0, depth, slot);
+            endOp();
+            return;
+        }
+        case Op::DefineSlot:
+            call<Runtime::defineSlot>(0, read<uint32_t>(pc));
+            return;
+        case Op::Unpack:
+            // Only used by destructuring declarations, which are not hot
+            read<uint32_t>(pc);
+            call<Runtime::deoptimize>(0, offset);
+            return;
+        case Op::LoadIndex:
+            call<Runtime::loadIndex>();
+            return;
+        case Op::StoreIndex:
+            call<Runtime::storeIndex>();
+            return;
+        case Op::StoreIndexKeep:
+            call<Runtime::storeIndexKeep>();
+            return;
+        case Op::Binary: {
+            auto op = static_cast<TokenType>(read<uint8_t>(pc));
+            auto start = copy(operandsStencil);
+            auto ints = intOperation(op);
+            if (ints) {
+                copy(binaryResultStencil);
+                nextPath();
+            }
+            if (floatOperation(op)) {
+                copy(binaryResultStencil);
+            }
+            else if (!ints) {
+                _code.resize(start);
+            }
+            slowPath();
+            call<Runtime::binary>(0, static_cast<uint8_t>(op));
+            endOp();
+            return;
+        }
+        case Op::BinaryConstant: {
+            auto op = static_cast<TokenType>(read<uint8_t>(pc));
+            auto &right = _chunk.constants.at(read<uint32_t>(pc));
+            // Only the path for the type of the constant
+            if (right.isImmediateInt() || right.is<vm::Float>()) {
+                auto start = copy(topStencil);
+                patch(copy(rightStencil) + holeValue, right.bits());
+                auto handled = right.isImmediateInt() ? intOperation(op)
+                                                      : floatOperation(op);
+                if (handled) {
+                    copy(binaryConstantResultStencil);
+                }
+                else {
+                    _code.resize(start);
+                }
+            }
+            slowPath();
+            call<Runtime::binaryConstant>(
+                reinterpret_cast<uint64_t>(&right), static_cast<uint8_t>(op));
+            endOp();
+            return;
+        }
+        case Op::Unary:
+            call<Runtime::unary>(0, read<uint8_t>(pc));
+            return;
+        case Op::NewArray:
+            call<Runtime::newArray>();
+            return;
+        case Op::NewDictionary:
+            call<Runtime::newDictionary>();
+            return;
+        case Op::Call:
+            call<Runtime::call>(0, read<uint32_t>(pc));
+            return;
+        case Op::CallMember: {
+            auto name = read<uint32_t>(pc);
+            auto count = read<uint32_t>(pc);
+            auto &cache = _chunk.memberCaches.at(read<uint32_t>(pc));
+            call<Runtime::callMember>(
+                reinterpret_cast<uint64_t>(&cache), name, count);
+            return;
+        }
+        case Op::PushScope:
+            call<Runtime::pushScope>(0, read<uint32_t>(pc));
+            return;
+        case Op::PopScope:
+            call<Runtime::popScope>();
+            return;
+        case Op::Jump:
+            jump(jumpStencil, 1, read<uint32_t>(pc));
+            return;
+        case Op::JumpIfTrue:
+            branchIf(true, read<uint32_t>(pc));
+            return;
+        case Op::JumpIfFalse:
+            branchIf(false, read<uint32_t>(pc));
+            return;
+        case Op::IterStart:
+            call<Runtime::iterStart>();
+            return;
+        case Op::IterNext: {
+            auto &cache = _chunk.memberCaches.at(read<uint32_t>(pc));
+            branch<Runtime::iterNext>(jumpIfEqual,
+                                      read<uint32_t>(pc),
+                                      reinterpret_cast<uint64_t>(&cache));
+            return;
+        }
+        case Op::IterNextLocal: {
+            auto slot = read<uint32_t>(pc);
+            auto &cache = _chunk.memberCaches.at(read<uint32_t>(pc));
+            auto target = read<uint32_t>(pc);
+            slotAddress(0, slot);
+            auto start = fast(intRangeStencil,
+                              holeRangeSlotGuard,
+                              holeRangeCounterGuard,
+                              holeRangeEndGuard);
+            _jumps.emplace_back(start + holeRangeTarget, target);
+            slowPath();
+            branch<Runtime::iterNextLocal>(jumpIfEqual,
+                                           target,
+                                           reinterpret_cast<uint64_t>(&cache),
+                                           slot);
+            endOp();
+            return;
+        }
+        case Op::StoreUnder: {
+            auto depth = read<uint32_t>(pc);
+            auto start = fast(storeUnderStencil, holeUnderGuard);
+            auto displacement = -static_cast<int32_t>((depth + 2) * 8);
+            patch(start + holeUnderLoad, displacement);
+            patch(start + holeUnderStore, displacement);
+            slowPath();
+            call<Runtime::storeUnder>(0, depth);
+            endOp();
+            return;
+        }
+        case Op::Statement:
+            call<Runtime::statement>(reinterpret_cast<uint64_t>(
+                _chunk.statements.at(read<uint32_t>(pc))));
+            return;
+        case Op::Return:
+            call<Runtime::returnValue>();
+            return;
+        }
+
+        throw std::runtime_error{"jit: unknown op"};
+    }
+
+    /// Push the immediate value `bits`
+    void push(uint64_t bits) {
+        patch(copy(valueStencil) + holeValue, bits);
+        fast(pushStencil, holePushGuard);
+    }
+
+    void loadSlot(uint32_t depth, uint32_t slot) {
+        slotAddress(depth, slot);
+        copy(loadStencil);
+        fast(immediateStencil, holeImmediateGuard);
+        fast(pushStencil, holePushGuard);
+        slowPath();
+        call<Runtime::loadSlot>(0, depth, slot);
+        endOp();
+    }
+
+    /// rdx = the address of the slot
+    void slotAddress(uint32_t depth, uint32_t slot) {
+        copy(contextStencil);
+        for (auto i = depth; i > 0; --i) {
+            copy(parentStencil);
+        }
+        patch(copy(slotStencil) + holeSlot,
+              static_cast<int32_t>(slot * sizeof(vm::Value)));
+    }
+
+    /// Ints in rax and rcx to rax. False if the op is not handled for ints
+    bool intOperation(TokenType op) {
+        auto start = _code.size();
+        auto guards = _guards.size();
+        fast(intStencil, holeIntLeftGuard, holeIntRightGuard);
+        switch (op) {
+        case TokenType::Plus:
+            copy(addStencil);
+            break;
+        case TokenType::Minus:
+            copy(subtractStencil);
+            break;
+        case TokenType::Star:
+            bailout(multiplyStencil, holeOverflowGuard);
+            break;
+        default:
+            if (auto condition = intCondition(op)) {
+                _code[copy(intCompareStencil) + holeSetCondition] = condition;
+                copy(boolResultStencil);
+                return true;
+            }
+            _code.resize(start);
+            _guards.resize(guards);
+            return false;
+        }
+        bailout(intResultStencil, holeIntResultGuard);
+        return true;
+    }
+
+    /// The setcc of a comparison, or 0 for other ops
+    static uint8_t intCondition(TokenType op) {
+        switch (op) {
+        case TokenType::Less:
+            return setIfLess;
+        case TokenType::LessEqual:
+            return setIfLessEqual;
+        case TokenType::Greater:
+            return setIfGreater;
+        case TokenType::GreaterEqual:
+            return setIfGreaterEqual;
+        case TokenType::EqualEqual:
+            return setIfEqual;
+        case TokenType::ExclaimEqual:
+            return setIfNotEqual;
+        default:
+            return 0;
+        }
+    }
+
+    /// Floats in rax and rcx to rax. False if the op is not handled for floats
+    bool floatOperation(TokenType op) {
+        auto arithmetic = [this](uint8_t op) {
+            _code[copy(floatArithmeticStencil) + holeFloatOp] = op;
+            bailout(floatResultStencil, holeNanGuard);
+        };
+        auto compare = [this](uint8_t operands, uint8_t condition) {
+            auto start = copy(floatCompareStencil);
+            _code[start + holeFloatOperands] = operands;
+            _code[start + holeFloatSetCondition] = condition;
+        };
+
+        auto start = _code.size();
+        auto guards = _guards.size();
+        fast(floatStencil, holeFloatLeftGuard, holeFloatRightGuard);
+        switch (op) {
+        case TokenType::Plus:
+            arithmetic(addFloat);
+            return true;
+        case TokenType::Minus:
+            arithmetic(subtractFloat);
+            return true;
+        case TokenType::Star:
+            arithmetic(multiplyFloat);
+            return true;
+        case TokenType::Slash:
+            arithmetic(divideFloat);
+            return true;
+        case TokenType::Less:
+            compare(floatOperandsSwapped, setIfAbove);
+            break;
+        case TokenType::LessEqual:
+            compare(floatOperandsSwapped, setIfAboveEqual);
+            break;
+        case TokenType::Greater:
+            compare(floatOperands, setIfAbove);
+            break;
+        case TokenType::GreaterEqual:
+            compare(floatOperands, setIfAboveEqual);
+            break;
+        case TokenType::EqualEqual:
+            copy(floatEqualStencil);
+            break;
+        case TokenType::ExclaimEqual:
+            copy(floatNotEqualStencil);
+            break;
+        default:
+            _code.resize(start);
+            _guards.resize(guards);
+            return false;
+        }
+        copy(boolResultStencil);
+        return true;
+    }
+
+    /// Pop a bool and jump to `target` if it is `value`
+    void branchIf(bool value, uint32_t target) {
+        auto start = fast(boolBranchStencil, holeBoolGuard);
+        _code[start + holeBoolCondition] =
+            value ? jumpIfNotEqual : jumpIfEqual;
+        _jumps.emplace_back(start + holeBoolTarget, target);
+        slowPath();
+        branch(value ? jumpIfEqual : jumpIfBelow, target);
+        endOp();
+    }
+
+    /// Copy a stencil of a fast path, whose type guards at `holes` jump to
+    /// the next path
+    template <size_t size, typename... Holes>
+    size_t fast(const std::array<uint8_t, size> &stencil, Holes... holes) {
+        auto start = copy(stencil);
+        (_guards.push_back(start + holes), ...);
+        return start;
+    }
+
+    /// Copy a stencil whose guards at `holes` jump to the call to the runtime
+    /// function, like when a result overflows. The operands are already
+    /// unpacked then, so the other paths can not continue
+    template <size_t size, typename... Holes>
+    size_t bailout(const std::array<uint8_t, size> &stencil, Holes... holes) {
+        auto start = copy(stencil);
+        (_bailouts.push_back(start + holes), ...);
+        return start;
+    }
+
+    /// End a fast path with a jump to the end of the op. Its failed type
+    /// guards continue after it, with the next path
+    void nextPath() {
+        if (_code.size() != _pathStart) {
+            _ends.push_back(copy(jumpStencil) + 1);
+        }
+        for (auto position : _guards) {
+            patchRelative(position, _code.size());
+        }
+        _guards.clear();
+        _pathStart = _code.size();
+    }
+
+    /// End the fast paths of an op. All failed guards continue here, with the
+    /// call to the runtime function
+    void slowPath() {
+        nextPath();
+        for (auto position : _bailouts) {
+            patchRelative(position, _code.size());
+        }
+        _bailouts.clear();
+    }
+
+    /// The end of an op with fast paths
+    void endOp() {
+        for (auto position : _ends) {
+            patchRelative(position, _code.size());
+        }
+        _ends.clear();
+    }
+
+    /// Call a runtime function and leave if it returns an exit
+    template <Runtime::Function f>
+    void call(uint64_t a = 0, uint32_t b = 0, uint32_t c = 0) {
+        callOnly<f>(a, b, c);
+        auto start = copy(exitStencil);
+        _exits.push_back(start + 4);
+    }
+
+    template <Runtime::Function f>
+    void callOnly(uint64_t a, uint32_t b, uint32_t c) {
+        auto start = copy(callStencil);
+        patch(start + holeA, a);
+        patch(start + holeB, b);
+        patch(start + holeC, c);
+        patch(start + holeFunction,
+              reinterpret_cast<uint64_t>(&Runtime::guarded<f>));
+    }
+
+    /// Call `f`, which returns a condition, and jump to `target` if it has
+    /// the value in the condition code
+    template <Runtime::Function f = Runtime::condition>
+    void branch(uint8_t condition,
+                uint32_t target,
+                uint64_t a = 0,
+                uint32_t b = 0) {
+        callOnly<f>(a, b, 0);
+        auto start = copy(branchStencil);
+        _code[start + holeCondition] = condition;
+        _jumps.emplace_back(start + holeTarget, target);
+        _exits.push_back(start + holeBranchExit);
+    }
+
+    template <size_t size>
+    void jump(const std::array<uint8_t, size> &stencil,
+              size_t hole,
+              uint32_t target) {
+        auto start = copy(stencil);
+        _jumps.emplace_back(start + hole, target);
+    }
+
+    template <size_t size>
+    size_t copy(const std::array<uint8_t, size> &stencil) {
+        auto start = _code.size();
+        _code.insert(_code.end(), stencil.begin(), stencil.end());
+        return start;
+    }
+
+    template <typename T>
+    void patch(size_t position, T value) {
+        std::memcpy(_code.data() + position, &value, sizeof(value));
+    }
+
+    /// rel32 operands are relative to the end of the instruction, which is
+    /// right after the operand in all stencils
+    void patchRelative(size_t position, size_t target) {
+        patch(position,
+              static_cast<int32_t>(static_cast<int64_t>(target) -
+                                   static_cast<int64_t>(position + 4)));
+    }
+
+    /// Copy the code to executable memory, which is never writable at the
+    /// same time
+    std::shared_ptr<Code> map() {
+        auto size = _code.size();
+        auto memory = mmap(nullptr,
+                           size,
+                           PROT_READ | PROT_WRITE,
+                           MAP_PRIVATE | MAP_ANONYMOUS,
+                           -1,
+                           0);
+        if (memory == MAP_FAILED) {
+            return nullptr;
+        }
+
+        std::memcpy(memory, _code.data(), size);
+        if (mprotect(memory, size, PROT_READ | PROT_EXEC) != 0) {
+            munmap(memory, size);
+            return nullptr;
+        }
+
+        return std::make_shared<Code>(memory, size, std::move(_entries));
+    }
+
+    Chunk &_chunk;
+    std::vector<uint8_t> _code;
+    std::vector<int32_t> _entries;
+
+    /// Positions of rel32 operands that jump to the epilogue
+    std::vector<size_t> _exits;
+
+    /// Positions of rel32 operands and the byte code offsets they jump to
+    std::vector<std::pair<size_t, uint32_t>> _jumps;
+
+    /// Start of the current fast path
+    size_t _pathStart = 0;
+
+    /// Positions of rel32 operands of the type guards in the current fast
+    /// path, and of the bailouts in all fast paths of the op
+    std::vector<size_t> _guards;
+    std::vector<size_t> _bailouts;
+
+    /// Positions of rel32 operands that jump to the end of the current op
+    std::vector<size_t> _ends;
+};
+
+} // namespace
+
+Code::~Code() {
+    munmap(_memory, _size);
+}
+
+Exit Code::run(State &state, const void *entry) const {
+    auto function = reinterpret_cast<uint32_t (*)(State *, const void *)>(
+        _memory);
+    return static_cast<Exit>(function(&state, entry));
+}
+
+std::shared_ptr<Code> compile(Chunk &chunk) {
+    if (!slotsFirst()) {
+        return nullptr;
+    }
+    return Compiler{chunk}.compile();
+}
+
+#else
+
+Code::~Code() = default;
+
+Exit Code::run(State &, const void *) const {
+    throw std::runtime_error{"jit is not supported on this platform"};
+}
+
+std::shared_ptr<Code> compile(Chunk &) {
+    return nullptr;
+}
+
+#endif
+
+} // namespace bytecode::jit
@@ -0,0 +1,96 @@
+#pragma once
+
+#include "vm.h"
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <memory>
+#include <vector>
+
+// Baseline machine code for hot byte code chunks, on x86-64 Linux, made of
+// precompiled stencils with the operands patched in. Most ops only call a
+// runtime function that does the same as the interpreter. Loads, stores,
+// arithmetic and comparisons of immediate ints and floats, branches on bools
+// and int range loops first run inline code, which calls the runtime
+// function when a type guard fails. The machine code uses the operand stack
+// and scopes of the Interpreter, so it can give control back to the
+// interpreter before any op
+
+namespace bytecode {
+
+struct Chunk;
+class Interpreter;
+class OperandStack;
+
+namespace jit {
+
+/// Runtime functions called by the machine code
+struct Runtime;
+
+enum class Mode {
+    Off,
+
+    /// Compile chunks when they are hot
+    On,
+
+    /// Compile every chunk before it is run
+    Always,
+};
+
+/// Runs of a chunk and iterations of its loops before it is compiled
+constexpr uint32_t hotThreshold = 16;
+
+/// Why the machine code returned. Runtime functions return 0 to continue, and
+/// conditions return 0 or 1
+enum class Exit : uint32_t {
+    Return = 2,
+    Error,
+
+    /// Continue in the interpreter at `State::resume`
+    Deoptimize,
+};
+
+/// Passed to the machine code, which passes it on to the runtime functions
+struct State {
+    Interpreter *interpreter = nullptr;
+    OperandStack *stack = nullptr;
+    vm::Context *context = nullptr;
+    vm::Value result;
+    uint32_t resume = 0;
+    std::exception_ptr error;
+};
+
+/// Executable memory with the machine code of one chunk
+class Code {
+public:
+    Code(void *memory, size_t size, std::vector<int32_t> entries);
+    ~Code();
+
+    Code(const Code &) = delete;
+    Code &operator=(const Code &) = delete;
+
+    /// Machine code for the op at `offset` in the byte code, or null if the
+    /// machine code can not be entered there
+    const void *entry(size_t offset) const {
+        if (offset >= _entries.size() || _entries[offset] < 0) {
+            return nullptr;
+        }
+        return static_cast<const uint8_t *>(_memory) + _entries[offset];
+    }
+
+    Exit run(State &state, const void *entry) const;
+
+private:
+    void *_memory;
+    size_t _size;
+
+    /// Position in the machine code of the op at each byte code offset
+    std::vector<int32_t> _entries;
+};
+
+/// Null if the platform is not supported or the memory could not be mapped
+std::shared_ptr<Code> compile(Chunk &chunk);
+
+} // namespace jit
+
+} // namespace bytecode
@@ -1,257 +1,136 @@
-#include "commands.h"
-#include "parsererror.h"
+#include "bytecode.h"
+#include "gc.h"
+#include "modulecache.h"
+#include "paralleltokenizer.h"
+#include "parser.h"
+#include "scriptprofiler.h"
 #include "settings.h"
+#include "sourcebuffer.h"
 #include "token.h"
-#include "tokeniterator.h"
 #include "tokenizer.h"
 #include "vm.h"
+#include <array>
 #include <filesystem>
-#include <functional>
+#include <fstream>
 #include <iostream>
 #include <memory>
-#include <utility>
-
-std::shared_ptr<vm::Expression> parseExpression(
-    TokenIterator &it, std::function<bool(const Token &)> endCondition = {});
-
-std::shared_ptr<vm::Expression> parseVariableDeclaration(TokenIterator &it) {
-    auto name = it.pop(TokenType::Text);
-
-    auto declaration = std::make_shared<vm::VariableDeclaration>();
-
-    declaration->name = name;
-
-    return declaration;
-}
-
-std::shared_ptr<vm::Section> parseSection(
-    TokenIterator &it, std::function<bool(const Token &)> endCondition = {}) {
-    auto exp = std::make_shared<vm::Section>();
-
-    for (; it.current() != TokenType::Eof &&
-           !(endCondition && endCondition(it.current()));) {
-        exp->commands.push_back(parseExpression(it));
-
-        if (it.current().type == TokenType::Semi) {
-            it.pop(TokenType::Semi);
-        }
+#include <vector>
+
+namespace {
+
+bytecode::jit::Mode jitMode(Settings::Jit jit) {
+    switch (jit) {
+    case Settings::Jit::Off:
+        return bytecode::jit::Mode::Off;
+    case Settings::Jit::On:
+        return bytecode::jit::Mode::On;
+    case Settings::Jit::Always:
+        return bytecode::jit::Mode::Always;
     }
-
-    return exp;
+    return bytecode::jit::Mode::Off;
 }
 
-std::shared_ptr<vm::Expression> parseFor(TokenIterator &it) {
-    it.pop(TokenType::For);
-    it.pop(TokenType::LParen);
-
-    auto exp = std::make_shared<vm::ForDeclaration>();
-
-    exp->declaration =
-        parseExpression(it, [](const Token &t) { return t.text == "in"; });
-    expect(it.pop(TokenType::Text), "in");
-
-    exp->range = parseExpression(it);
-
-    it.pop(TokenType::RParen);
+} // namespace
 
-    it.pop(TokenType::LBrace);
-
-    exp->section = parseSection(
-        it, [](const Token &token) { return token.type == TokenType::RBrace; });
+int main(int argc, char *argv[]) {
+    const auto settings = Settings{argc, argv};
 
-    it.pop(TokenType::RBrace);
+    auto source = settings.path.empty() ? SourceBuffer::read(std::cin)
+                                        : SourceBuffer::map(settings.path);
+    auto path = settings.path.empty() ? std::filesystem::path{"stdin"}
+                                      : settings.path;
 
-    return exp;
-}
+    auto arena = Arena{};
 
-std::vector<std::shared_ptr<vm::Expression>> parseFunctionArguments(
-    TokenIterator &it) {
-    auto args = std::vector<std::shared_ptr<vm::Expression>>{};
+    // Scripts read from stdin are not cached
+    auto cachePath = (settings.useCache && !settings.path.empty())
+                         ? modulecache::cachePath(path, settings.cacheDir)
+                         : std::filesystem::path{};
 
-    it.pop();
-    for (; it.current().type != TokenType::RParen;) {
-        args.push_back(parseExpression(it));
+    // All syntax errors are reported at once
+    auto diagnostics = std::vector<ParserError>{};
 
-        if (it.current() == TokenType::RParen) {
-            break;
+    auto parse = [&] {
+        if (settings.lexThreads > 1 ||
+            (settings.lexThreads == 0 &&
+             source->size() >= 2 * minParallelChunkSize)) {
+            auto tokens = tokenizeParallel(source, path, settings.lexThreads);
+            return parseRoot(tokens, arena, &diagnostics);
         }
-        if (it.current() != TokenType::Comma) {
-            throw ParserError{it.current(), "Unexpected token"};
-        }
-        it.pop();
-    }
-    it.pop();
-
-    return args;
-}
-
-std::shared_ptr<vm::Expression> parseExpression(
-    TokenIterator &it, std::function<bool(const Token &)> endCondition) {
-    auto exp = std::shared_ptr<vm::Expression>{};
 
-    bool shouldBreak = false;
-
-    auto assignSingleExpression = [&](decltype(exp) e) {
-        if (exp) {
-            throw ParserError{it.current(), "Unexpected token"};
-        }
-        exp = e;
+        auto tokenizer = Tokenizer{source, path};
+        return parseRoot(tokenizer, arena, &diagnostics);
     };
 
-    for (; it.current().type != TokenType::Semi &&
-           it.current().type != TokenType::Eof && !shouldBreak;) {
-
-        if (endCondition) {
-            if (endCondition(it.current())) {
-                break;
-            }
+    auto module = [&] {
+        if (cachePath.empty()) {
+            return parse();
         }
 
-        switch (it.current().type) {
-        case TokenType::Let:
-            it.consume();
-            if (exp) {
-                throw ParserError{it.current(),
-                                  "Let must be at beginning of line"};
-            }
-            exp = parseVariableDeclaration(it);
-            break;
-        case TokenType::Equal: {
-            it.consume();
-            if (!exp) {
-                throw ParserError{it.current(), "Line cannot start with '='"};
-            }
-
-            auto assignment = std::make_shared<vm::Assignment>();
-
-            assignment->left = std::exchange(exp, assignment);
-
-            assignment->right = parseExpression(it);
-
-            break;
+        if (auto module = modulecache::load(cachePath, source, path, arena)) {
+            return module;
         }
-        case TokenType::Text: {
-            auto accessor = std::make_shared<vm::VariableAccessor>();
-
-            accessor->name = it.pop(TokenType::Text);
-
-            exp = std::move(accessor);
-
-            break;
-        }
-
-        case TokenType::LParen: {
-            if (!exp) {
-                throw ParserError{it.current(), "Unexpected paren"};
-            }
-
-            auto call = std::make_shared<vm::FunctionCall>();
-
-            call->functionValue = std::move(exp);
 
-            call->arguments = parseFunctionArguments(it);
-
-            exp = std::move(call);
-
-            break;
+        auto module = parse();
+        if (diagnostics.empty()) {
+            modulecache::save(cachePath, *source, *module);
         }
+        return module;
+    }();
 
-        case TokenType::StringLiteral:
-            if (exp) {
-                throw ParserError{it.current(), "Unexpected token"};
-            }
-
-            exp = std::make_shared<vm::StringLiteral>(it.pop());
-            break;
-
-        case TokenType::LSquare:
-            it.pop();
-            it.pop(TokenType::RSquare);
-
-            if (exp) {
-                // TODO: Handle array indexing
-                throw ParserError{it.current(), "Unexpected token"};
-            }
-
-            exp = std::make_shared<vm::ArrayDeclaration>();
-
-            break;
-        case TokenType::For:
-            assignSingleExpression(parseFor(it));
-
-            break;
-        case TokenType::Period: {
-            if (!exp) {
-                throw ParserError{it.current(), "stray '.'"};
-            }
-
-            auto memberFunction = std::make_shared<vm::MemberFunctionCall>();
-            it.consume();
-
-            memberFunction->object = std::exchange(exp, memberFunction);
-
-            memberFunction->memberName = it.pop();
-
-            // TODO: Implement regular member accessors
-            it.current(TokenType::LParen);
-
-            memberFunction->arguments = parseFunctionArguments(it);
-
-            break;
-        }
-        default:
-            shouldBreak = true;
-            break;
-        }
+    for (auto &error : diagnostics) {
+        std::cerr << error.what() << "\n";
     }
 
-    if (!exp) {
-        throw ParserError{it.current(), "Unexpected token"};
+    if (!diagnostics.empty()) {
+        return 1;
     }
 
-    return exp;
-}
-
-std::shared_ptr<vm::Map> parseRoot(TokenIterator &it) {
-    auto map = std::make_shared<vm::Map>();
-
-    auto mainFunction = std::make_shared<vm::Function>();
-
-    mainFunction->body = parseSection(it);
+    if (settings.lint) {
+        return 0;
+    }
 
-    (*map)[t("main")] = mainFunction;
+    std::cout << std::endl;
 
-    return map;
-}
+    if (settings.gcThreshold) {
+        vm::gc::setThreshold(settings.gcThreshold);
+    }
 
-int main(int argc, char *argv[]) {
-    const auto settings = Settings{argc, argv};
+    (*module)[symbols::Std] = vm::getStd();
 
-    auto file = [&] {
-        if (settings.path.empty()) {
-            return Tokenizer(std::cin, "stdin");
-        }
-        else {
-            return Tokenizer{settings.path};
-        }
-    }();
+    auto context = vm::Context{
+        .closure = module.get(),
+    };
 
-    auto module = parseRoot(file);
+    auto &f = module->at<vm::Map>(symbols::Std)
+                  .at<vm::Function>(symbols::Abs);
 
-    std::cout << std::endl;
+    auto ret = call(f, std::array{vm::Value{vm::Float{-1}}}, context);
 
-    (*module)[Token::from("std")] = vm::getStd();
+    auto &mainF = module->at<vm::Function>(symbols::Main);
 
-    auto context = vm::Context{};
-
-    auto &f = module->at<vm::Map>(Token::from("std"))
-                  .at<vm::Function>(Token::from("abs"));
+    if (!settings.profileScript.empty()) {
+        scriptprofiler::start();
+    }
 
-    auto ret = call(f, {vm::Float{-1}}, context);
+    if (settings.engine == Settings::Engine::Bytecode) {
+        auto interpreter = bytecode::Interpreter{jitMode(settings.jit)};
+        interpreter.call(mainF, {}, context);
+    }
+    else {
+        call(mainF, {}, context);
+    }
 
-    auto &mainF = module->at<vm::Function>(Token::from("main"));
+    if (!settings.profileScript.empty()) {
+        scriptprofiler::stop();
+        scriptprofiler::writeReport(std::cerr);
+        auto folded = std::ofstream{settings.profileScript};
+        scriptprofiler::writeFolded(folded);
+    }
 
-    call(mainF, {}, context);
+    if (settings.gcStats) {
+        vm::gc::printStats(std::cerr);
+    }
 
     return 0;
 }
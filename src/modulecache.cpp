@@ -0,0 +1,645 @@
+#include "modulecache.h"
+#include "commands.h"
+#include "resolver.h"
+#include "sourcefiles.h"
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <unistd.h>
+#include <unordered_map>
+#include <variant>
+#include <vector>
+
+// File layout, in native byte order:
+//   Header
+//   uint32_t stringOffsets[stringCount + 1]
+//   char strings[stringBytes]
+//   nodes, written depth first starting with the main section
+
+namespace modulecache {
+
+namespace {
+
+constexpr uint32_t magic = 0x4343534d; // "MSCC"
+
+/// Increase when the file layout or the fields of a node change
+constexpr uint32_t formatVersion = 6;
+
+struct Header {
+    uint32_t magic = 0;
+    uint32_t formatVersion = 0;
+    uint64_t versionHash = 0;
+    uint64_t sourceHash = 0;
+    uint64_t sourceSize = 0;
+    /// Hash of everything after the header
+    uint64_t bodyHash = 0;
+    uint32_t stringCount = 0;
+    uint32_t stringBytes = 0;
+};
+
+constexpr uint8_t nullNode = 0xff;
+
+enum class LiteralTag : uint8_t {
+    Int,
+    Float,
+    Bool,
+};
+
+static_assert(static_cast<size_t>(TokenType::Eof) < 256);
+
+uint64_t sourceHash(const SourceBuffer &source) {
+    return std::hash<std::string_view>{}(source.view());
+}
+
+uint64_t bodyHash(std::string_view body) {
+    return std::hash<std::string_view>{}(body);
+}
+
+// The fields of every node, used both when writing and reading
+
+template <typename A>
+void fields(A &a, vm::VariableDeclaration &e) {
+    a(e.name);
+}
+
+template <typename A>
+void fields(A &a, vm::DestructuringDeclaration &e) {
+    a(e.names);
+}
+
+template <typename A>
+void fields(A &a, vm::Assignment &e) {
+    a(e.left);
+    a(e.right);
+}
+
+template <typename A>
+void fields(A &a, vm::CompoundAssignment &e) {
+    a(e.op);
+    a(e.left);
+    a(e.right);
+}
+
+template <typename A>
+void fields(A &a, vm::BinaryOperation &e) {
+    a(e.op);
+    a(e.left);
+    a(e.right);
+}
+
+template <typename A>
+void fields(A &a, vm::UnaryOperation &e) {
+    a(e.op);
+    a(e.operand);
+}
+
+template <typename A>
+void fields(A &a, vm::VariableAccessor &e) {
+    a(e.name);
+}
+
+template <typename A>
+void fields(A &a, vm::FunctionCall &e) {
+    a(e.functionValue);
+    a(e.arguments);
+}
+
+template <typename A>
+void fields(A &a, vm::StringLiteral &e) {
+    a(e.text);
+}
+
+template <typename A>
+void fields(A &a, vm::Constant &e) {
+    a(e.literal);
+}
+
+template <typename A>
+void fields(A &a, vm::ArrayDeclaration &e) {}
+
+template <typename A>
+void fields(A &a, vm::DictionaryDeclaration &e) {}
+
+template <typename A>
+void fields(A &a, vm::ForDeclaration &e) {
+    a(e.section);
+    a(e.declaration);
+    a(e.range);
+}
+
+template <typename A>
+void fields(A &a, vm::IndexAccessor &e) {
+    a(e.object);
+    a(e.index);
+}
+
+template <typename A>
+void fields(A &a, vm::MemberFunctionCall &e) {
+    a(e.object);
+    a(e.memberName);
+    a(e.arguments);
+}
+
+template <typename A>
+void fields(A &a, vm::FunctionDeclaration &e) {
+    a(e.name);
+    a(e.arguments);
+    a(e.body);
+}
+
+template <typename A>
+void fields(A &a, vm::IfStatement &e) {
+    a(e.condition);
+    a(e.then);
+    a(e.otherwise);
+}
+
+template <typename A>
+void fields(A &a, vm::ReturnStatement &e) {
+    a(e.value);
+}
+
+/// Text with the kinds of all nodes and the types of their fields, in the
+/// order they are written
+class Schema {
+public:
+    std::string describe() {
+        _text = "tokens " +
+                std::to_string(static_cast<size_t>(TokenType::Eof)) + "\n";
+#define NODE(x)                                                                \
+    {                                                                          \
+        auto node = vm::x{};                                                   \
+        _text += #x " ";                                                       \
+        fields(*this, node);                                                   \
+        _text += "\n";                                                         \
+    }
+        NODE_LIST
+#undef NODE
+        return std::move(_text);
+    }
+
+    void operator()(const vm::Section *) {
+        _text += "section ";
+    }
+
+    void operator()(vm::Expression *) {
+        _text += "node ";
+    }
+
+    void operator()(std::span<vm::Expression *>) {
+        _text += "nodes ";
+    }
+
+    void operator()(std::span<Symbol>) {
+        _text += "symbols ";
+    }
+
+    void operator()(Symbol) {
+        _text += "symbol ";
+    }
+
+    void operator()(std::string_view) {
+        _text += "text ";
+    }
+
+    void operator()(TokenType) {
+        _text += "token ";
+    }
+
+    void operator()(const vm::Constant::Literal &) {
+        _text += "literal ";
+    }
+
+private:
+    std::string _text;
+};
+
+/// Caches are not shared between releases, even if the format is the same,
+/// or when the fields of a node change without a new formatVersion.
+/// Rebuilding the same version does not invalidate them
+uint64_t versionHash() {
+    static const auto hash = std::hash<std::string>{}(
+        "matscript " MATSCRIPT_VERSION "\n" + Schema{}.describe());
+    return hash;
+}
+
+class Writer {
+public:
+    std::string write(const vm::Section &main, const SourceBuffer &source) {
+        (*this)(&main);
+
+        auto header = Header{
+            .magic = magic,
+            .formatVersion = formatVersion,
+            .versionHash = versionHash(),
+            .sourceHash = sourceHash(source),
+            .sourceSize = source.size(),
+            .stringCount = static_cast<uint32_t>(_strings.size()),
+        };
+
+        auto offsets = std::vector<uint32_t>{0};
+        auto text = std::string{};
+        for (auto s : _strings) {
+            text += s;
+            offsets.push_back(static_cast<uint32_t>(text.size()));
+        }
+        header.stringBytes = static_cast<uint32_t>(text.size());
+
+        auto body = std::string{};
+        body.append(reinterpret_cast<const char *>(offsets.data()),
+                    offsets.size() * sizeof(uint32_t));
+        body += text;
+        body += _nodes;
+        header.bodyHash = bodyHash(body);
+
+        auto data = std::string{};
+        data.append(reinterpret_cast<const char *>(&header), sizeof(header));
+        data += body;
+        return data;
+    }
+
+    void operator()(const vm::Section *section) {
+        put<uint8_t>(section != nullptr);
+        if (section) {
+            (*this)(section->commands);
+            for (auto command : section->commands) {
+                put(command->location.offset);
+            }
+        }
+    }
+
+    void operator()(vm::Expression *e) {
+        if (!e) {
+            put(nullNode);
+            return;
+        }
+
+        put(static_cast<uint8_t>(e->kind()));
+
+        switch (e->kind()) {
+#define NODE(x)                                                                \
+    case vm::NodeKind::x:                                                      \
+        fields(*this, static_cast<vm::x &>(*e));                               \
+        return;
+            NODE_LIST
+#undef NODE
+        }
+    }
+
+    void operator()(std::span<vm::Expression *> expressions) {
+        put(static_cast<uint32_t>(expressions.size()));
+        for (auto e : expressions) {
+            (*this)(e);
+        }
+    }
+
+    void operator()(std::span<Symbol> symbols) {
+        put(static_cast<uint32_t>(symbols.size()));
+        for (auto symbol : symbols) {
+            put(string(symbol.text()));
+        }
+    }
+
+    void operator()(Symbol symbol) {
+        put(string(symbol.text()));
+    }
+
+    void operator()(std::string_view text) {
+        put(string(text));
+    }
+
+    void operator()(TokenType type) {
+        put(static_cast<uint8_t>(type));
+    }
+
+    void operator()(const vm::Constant::Literal &literal) {
+        if (auto i = std::get_if<vm::Int>(&literal)) {
+            put(LiteralTag::Int);
+            put(i->value);
+        }
+        else if (auto f = std::get_if<vm::Float>(&literal)) {
+            put(LiteralTag::Float);
+            put(f->value);
+        }
+        else {
+            put(LiteralTag::Bool);
+            put<uint8_t>(std::get<vm::Bool>(literal).value);
+        }
+    }
+
+private:
+    template <typename T>
+    void put(T value) {
+        _nodes.append(reinterpret_cast<const char *>(&value), sizeof(value));
+    }
+
+    /// Index in the string table. Equal strings are stored once
+    uint32_t string(std::string_view s) {
+        auto [it, inserted] = _stringIndices.try_emplace(
+            s, static_cast<uint32_t>(_strings.size()));
+        if (inserted) {
+            _strings.push_back(s);
+        }
+        return it->second;
+    }
+
+    std::string _nodes;
+    std::vector<std::string_view> _strings;
+    std::unordered_map<std::string_view, uint32_t> _stringIndices;
+};
+
+class Reader {
+public:
+    Reader(std::string_view data, Arena &arena)
+        : _data{data}
+        , _arena{arena} {}
+
+    /// Check that the cache belongs to this source and version, that it is
+    /// not corrupt, and read the string table
+    bool readHeader(const SourceBuffer &source) {
+        if (_data.size() < sizeof(Header)) {
+            return false;
+        }
+
+        auto header = get<Header>();
+        if (header.magic != magic || header.formatVersion != formatVersion ||
+            header.versionHash != versionHash() ||
+            header.sourceSize != source.size() ||
+            header.sourceHash != sourceHash(source) ||
+            header.bodyHash != bodyHash(_data.substr(sizeof(Header)))) {
+            return false;
+        }
+
+        auto offsets = std::vector<uint32_t>(header.stringCount + 1);
+        for (auto &offset : offsets) {
+            offset = get<uint32_t>();
+        }
+
+        auto text = bytes(header.stringBytes);
+        _strings.reserve(header.stringCount);
+        for (size_t i = 0; i < header.stringCount; ++i) {
+            if (offsets[i] > offsets[i + 1] ||
+                offsets[i + 1] > header.stringBytes) {
+                throw std::runtime_error{"invalid module cache string table"};
+            }
+            _strings.push_back(
+                text.substr(offsets[i], offsets[i + 1] - offsets[i]));
+        }
+        _symbols.resize(_strings.size());
+
+        return true;
+    }
+
+    vm::Section *readModule() {
+        auto main = static_cast<vm::Section *>(nullptr);
+        (*this)(main);
+        if (!main) {
+            throw std::runtime_error{"module cache has no main section"};
+        }
+        return main;
+    }
+
+    void operator()(vm::Section *&section) {
+        if (!get<uint8_t>()) {
+            section = nullptr;
+            return;
+        }
+        section = _arena.create<vm::Section>();
+        (*this)(section->commands);
+        for (auto command : section->commands) {
+            if (!command) {
+                throw std::runtime_error{"invalid node in module cache"};
+            }
+            command->location.offset = get<uint32_t>();
+            _commands.push_back(command);
+        }
+    }
+
+    /// Set the file of every command, once the module has been read
+    void locate(sourcefiles::FileId file) {
+        for (auto command : _commands) {
+            command->location.file = file;
+        }
+    }
+
+    void operator()(vm::Expression *&e) {
+        auto kind = get<uint8_t>();
+        if (kind == nullNode) {
+            e = nullptr;
+            return;
+        }
+
+        switch (static_cast<vm::NodeKind>(kind)) {
+#define NODE(x)                                                                \
+    case vm::NodeKind::x: {                                                    \
+        auto node = _arena.create<vm::x>();                                    \
+        fields(*this, *node);                                                  \
+        e = node;                                                              \
+        return;                                                                \
+    }
+            NODE_LIST
+#undef NODE
+        }
+
+        throw std::runtime_error{"invalid node in module cache"};
+    }
+
+    void operator()(std::span<vm::Expression *> &expressions) {
+        expressions = _arena.createArray<vm::Expression *>(count());
+        for (auto &e : expressions) {
+            (*this)(e);
+        }
+    }
+
+    void operator()(std::span<Symbol> &symbols) {
+        symbols = _arena.createArray<Symbol>(count());
+        for (auto &s : symbols) {
+            s = symbol(get<uint32_t>());
+        }
+    }
+
+    void operator()(Symbol &symbol) {
+        symbol = this->symbol(get<uint32_t>());
+    }
+
+    void operator()(std::string_view &text) {
+        text = string(get<uint32_t>());
+    }
+
+    void operator()(TokenType &type) {
+        auto value = get<uint8_t>();
+        if (value > static_cast<uint8_t>(TokenType::Eof)) {
+            throw std::runtime_error{"invalid token type in module cache"};
+        }
+        type = static_cast<TokenType>(value);
+    }
+
+    void operator()(vm::Constant::Literal &literal) {
+        switch (get<LiteralTag>()) {
+        case LiteralTag::Int:
+            literal = vm::Int{get<int64_t>()};
+            return;
+        case LiteralTag::Float:
+            literal = vm::Float{get<double>()};
+            return;
+        case LiteralTag::Bool:
+            literal = vm::Bool{get<uint8_t>() != 0};
+            return;
+        }
+        throw std::runtime_error{"invalid constant in module cache"};
+    }
+
+private:
+    std::string_view bytes(size_t size) {
+        if (size > _data.size() - _position) {
+            throw std::runtime_error{"module cache is truncated"};
+        }
+        auto ret = _data.substr(_position, size);
+        _position += size;
+        return ret;
+    }
+
+    template <typename T>
+    T get() {
+        auto value = T{};
+        std::memcpy(&value, bytes(sizeof(T)).data(), sizeof(T));
+        return value;
+    }
+
+    /// Number of elements in a list. Every element takes at least one byte,
+    /// which stops corrupt files from allocating huge lists
+    size_t count() {
+        auto n = get<uint32_t>();
+        if (n > _data.size() - _position) {
+            throw std::runtime_error{"module cache is truncated"};
+        }
+        return n;
+    }
+
+    std::string_view string(uint32_t index) {
+        if (index >= _strings.size()) {
+            throw std::runtime_error{"invalid string in module cache"};
+        }
+        return _strings[index];
+    }
+
+    /// Each string is interned at most once
+    Symbol symbol(uint32_t index) {
+        auto text = string(index);
+        auto &symbol = _symbols[index];
+        if (!symbol) {
+            symbol = Symbol{text};
+        }
+        return symbol;
+    }
+
+    std::string_view _data;
+    size_t _position = 0;
+    Arena &_arena;
+    std::vector<vm::Expression *> _commands;
+    std::vector<std::string_view> _strings;
+    std::vector<Symbol> _symbols;
+};
+
+} // namespace
+
+std::filesystem::path cachePath(const std::filesystem::path &source,
+                                const std::filesystem::path &cacheDir) {
+    if (cacheDir.empty()) {
+        auto path = source;
+        path += ".cache";
+        return path;
+    }
+
+    // Files with the same name in different directories get different caches
+    auto absolute = std::filesystem::absolute(source).lexically_normal();
+    auto name = std::ostringstream{};
+    name << source.filename().string() << "-" << std::hex << std::setw(16)
+         << std::setfill('0')
+         << std::hash<std::string>{}(absolute.string()) << ".cache";
+    return cacheDir / name.str();
+}
+
+vm::Ref<vm::Map> load(const std::filesystem::path &cachePath,
+                      std::shared_ptr<const SourceBuffer> source,
+                      const std::filesystem::path &path,
+                      Arena &arena) {
+    auto error = std::error_code{};
+    if (!std::filesystem::is_regular_file(cachePath, error)) {
+        return nullptr;
+    }
+
+    try {
+        auto cache =
+            std::shared_ptr<const SourceBuffer>{SourceBuffer::map(cachePath)};
+        auto reader = Reader{cache->view(), arena};
+        if (!reader.readHeader(*source)) {
+            return nullptr;
+        }
+
+        auto body = reader.readModule();
+        resolve(*body);
+
+        // Only register the file when the cache is used. Otherwise it is
+        // registered when the source is parsed
+        reader.locate(sourcefiles::add(path, source));
+
+        // String literals point into the mapped cache
+        arena.create<std::shared_ptr<const SourceBuffer>>(std::move(cache));
+
+        return vm::createModule(body);
+    }
+    catch (std::exception &) {
+        // A broken cache is ignored and overwritten after parsing
+        return nullptr;
+    }
+}
+
+bool save(const std::filesystem::path &cachePath,
+          const SourceBuffer &source,
+          vm::Map &module) {
+    auto error = std::error_code{};
+
+    try {
+        auto &main = module.at<vm::Function>(symbols::Main);
+        auto data = Writer{}.write(*main.body, source);
+
+        if (cachePath.has_parent_path()) {
+            std::filesystem::create_directories(cachePath.parent_path(),
+                                                error);
+        }
+
+        // Write to a temporary file first so that other processes never see
+        // a half written cache
+        auto tmp = cachePath;
+        tmp += ".tmp" + std::to_string(getpid());
+
+        auto file = std::ofstream{tmp, std::ios::binary};
+        file.write(data.data(), data.size());
+        file.close();
+
+        if (!file) {
+            std::filesystem::remove(tmp, error);
+            return false;
+        }
+
+        std::filesystem::rename(tmp, cachePath, error);
+        if (error) {
+            std::filesystem::remove(tmp, error);
+            return false;
+        }
+    }
+    catch (std::exception &) {
+        return false;
+    }
+
+    return true;
+}
+
+} // namespace modulecache
@@ -0,0 +1,34 @@
+#pragma once
+
+#include "arena.h"
+#include "sourcebuffer.h"
+#include "vm.h"
+#include <filesystem>
+#include <memory>
+
+/// Parsed modules saved in a binary format, so that a script that has not
+/// changed can be loaded without tokenizing and parsing it again. A cache is
+/// only used if the source content, the format version and the matscript
+/// version match the ones it was written with
+namespace modulecache {
+
+/// Where the cache for `source` is stored. With an empty `cacheDir` the cache
+/// is placed next to the source file
+std::filesystem::path cachePath(const std::filesystem::path &source,
+                                const std::filesystem::path &cacheDir = {});
+
+/// Memory map the cache and create the syntax tree in `arena`. Returns null if
+/// there is no valid cache for the source. The source is registered in
+/// `sourcefiles` under `path` when the cache is used
+vm::Ref<vm::Map> load(const std::filesystem::path &cachePath,
+                      std::shared_ptr<const SourceBuffer> source,
+                      const std::filesystem::path &path,
+                      Arena &arena);
+
+/// Write the cache for a module parsed from `source`. Returns false if the
+/// cache could not be written, which is not an error for the caller
+bool save(const std::filesystem::path &cachePath,
+          const SourceBuffer &source,
+          vm::Map &module);
+
+} // namespace modulecache
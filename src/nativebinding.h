@@ -0,0 +1,150 @@
+#pragma once
+
+#include "vm.h"
+#include <algorithm>
+#include <cstddef>
+#include <stdexcept>
+#include <string>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+// Native functions made from C++ callables. Converting the arguments and
+// choosing the overload is generated from the parameter types of the callables
+
+namespace vm {
+
+namespace binding {
+
+/// Conversion from a Value to a parameter type
+template <typename T>
+struct Argument;
+
+template <>
+struct Argument<Value> {
+    static bool matches(const Value &) {
+        return true;
+    }
+
+    static Value &get(Value &value) {
+        return value;
+    }
+};
+
+template <BuiltinTypes T>
+struct Argument<T> {
+    static bool matches(const Value &value) {
+        return value.is<T>();
+    }
+
+    static decltype(auto) get(Value &value) {
+        return value.as<T>();
+    }
+};
+
+template <InheritsOther T>
+struct Argument<T> {
+    static bool matches(const Value &value) {
+        return value.is<T>();
+    }
+
+    static T &get(Value &value) {
+        return value.as<T>();
+    }
+};
+
+template <typename R, typename... Args>
+struct SignatureBase {
+    using Result = R;
+    using Arguments = std::tuple<Args...>;
+    static constexpr bool withContext = false;
+};
+
+/// Callables may take the Context first, for example to get `this`
+template <typename R, typename... Args>
+struct SignatureBase<R, Context &, Args...> : SignatureBase<R, Args...> {
+    static constexpr bool withContext = true;
+};
+
+template <typename F>
+struct Signature : Signature<decltype(&F::operator())> {};
+
+template <typename C, typename R, typename... Args>
+struct Signature<R (C::*)(Args...) const> : SignatureBase<R, Args...> {
+    static constexpr size_t arity =
+        std::tuple_size_v<typename SignatureBase<R, Args...>::Arguments>;
+};
+
+template <typename F, size_t I>
+using ArgumentOf = Argument<std::remove_cvref_t<
+    std::tuple_element_t<I, typename Signature<F>::Arguments>>>;
+
+/// Call `F` and return true if the arguments match its parameters
+template <typename F, size_t... I>
+bool tryCall(Context &context, Value &result, std::index_sequence<I...>) {
+    if (!(ArgumentOf<F, I>::matches(context.argument(I)) && ...)) {
+        return false;
+    }
+
+    auto call = [&context]() -> decltype(auto) {
+        if constexpr (Signature<F>::withContext) {
+            return F{}(context,
+                       ArgumentOf<F, I>::get(context.argument(I))...);
+        }
+        else {
+            return F{}(ArgumentOf<F, I>::get(context.argument(I))...);
+        }
+    };
+
+    if constexpr (std::is_void_v<typename Signature<F>::Result>) {
+        call();
+        result = {};
+    }
+    else {
+        result = Value{call()};
+    }
+    return true;
+}
+
+template <typename... Fs>
+struct Overloads {
+    static inline Symbol name;
+
+    static Value call(Context &context) {
+        auto result = Value{};
+        if ((tryCall<Fs>(context,
+                         result,
+                         std::make_index_sequence<Signature<Fs>::arity>{}) ||
+             ...)) {
+            return result;
+        }
+        throw std::runtime_error{"no overload of " +
+                                 std::string{name.text()} +
+                                 " takes these arguments"};
+    }
+};
+
+} // namespace binding
+
+/// Add a native function called `name` to `map`, for example
+/// `bind(std, symbols::Abs, [](Int v) {...}, [](Float v) {...})`. The first
+/// callable whose parameters match the arguments is called. Parameters can be
+/// Value, the builtin types and references to object types. Callables can not
+/// capture anything, and may take `Context &` as their first parameter
+template <typename... Fs>
+void bind(Map &map, Symbol name, Fs...) {
+    static_assert((std::is_empty_v<Fs> && ...),
+                  "native functions can not capture");
+
+    using Overloads = binding::Overloads<Fs...>;
+    Overloads::name = name;
+
+    auto function = make<Function>();
+    function->name = name;
+    function->native = &Overloads::call;
+    function->argumentCount = static_cast<uint32_t>(
+        std::max({size_t{0}, binding::Signature<Fs>::arity...}));
+    map[name] = function;
+}
+
+} // namespace vm
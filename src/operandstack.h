@@ -0,0 +1,96 @@
+#pragma once
+
+#include "vm.h"
+#include <cstddef>
+#include <new>
+#include <utility>
+
+namespace bytecode {
+
+/// Operand stack of the byte code interpreter. Used like a vector of values,
+/// but the layout is known, so that the jit can push and pop immediate values
+/// without calling into the runtime
+class OperandStack {
+public:
+    OperandStack() = default;
+
+    ~OperandStack() {
+        resize(0);
+        ::operator delete(_begin);
+    }
+
+    OperandStack(const OperandStack &) = delete;
+    OperandStack &operator=(const OperandStack &) = delete;
+
+    /// Takes the value by value, so that values already on the stack can be
+    /// pushed while the stack grows
+    void push_back(vm::Value value) {
+        if (_end == _capacity) {
+            grow();
+        }
+        new (_end++) vm::Value{std::move(value)};
+    }
+
+    template <typename... Args>
+    void emplace_back(Args &&...args) {
+        push_back(vm::Value{std::forward<Args>(args)...});
+    }
+
+    void pop_back() {
+        (--_end)->~Value();
+    }
+
+    vm::Value &back() {
+        return _end[-1];
+    }
+
+    vm::Value &operator[](size_t index) {
+        return _begin[index];
+    }
+
+    size_t size() const {
+        return static_cast<size_t>(_end - _begin);
+    }
+
+    /// New values are void
+    void resize(size_t size) {
+        while (this->size() > size) {
+            pop_back();
+        }
+        while (this->size() < size) {
+            emplace_back();
+        }
+    }
+
+    /// Offsets of the members that the machine code uses
+    static constexpr size_t endOffset() {
+        return offsetof(OperandStack, _end);
+    }
+
+    static constexpr size_t capacityOffset() {
+        return offsetof(OperandStack, _capacity);
+    }
+
+private:
+    void grow() {
+        auto size = this->size();
+        auto capacity = size ? size * 2 : 64;
+        auto values = static_cast<vm::Value *>(
+            ::operator new(capacity * sizeof(vm::Value)));
+        for (size_t i = 0; i < size; ++i) {
+            new (values + i) vm::Value{std::move(_begin[i])};
+            _begin[i].~Value();
+        }
+        ::operator delete(_begin);
+        _begin = values;
+        _end = values + size;
+        _capacity = values + capacity;
+    }
+
+    /// One past the last value
+    vm::Value *_end = nullptr;
+    vm::Value *_capacity = nullptr;
+    vm::Value *_begin = nullptr;
+};
+
+} // namespace bytecode
@@ -0,0 +1,188 @@
+#include "paralleltokenizer.h"
+#include "charscan.h"
+#include "sourcefiles.h"
+#include "threadpool.h"
+#include "tokenizer.h"
+#include <algorithm>
+#include <vector>
+
+namespace {
+
+/// The only constructs that can span a line break are string literals.
+/// Comments always end at the line break
+enum class LexState {
+    Code,
+    String,
+};
+
+/// Find the state at the end of [begin, end) when starting in `state`
+LexState scanState(const char *begin, const char *end, LexState state) {
+    auto &scanner = charscan::scanner();
+
+    for (auto p = begin; p < end;) {
+        if (state == LexState::String) {
+            auto quote = scanner.find(p, end, '"');
+            if (quote == end) {
+                return LexState::String;
+            }
+            p = quote + 1;
+            state = LexState::Code;
+            continue;
+        }
+
+        auto found = scanner.find2(p, end, '"', '/');
+        if (found == end) {
+            return LexState::Code;
+        }
+        if (*found == '"') {
+            state = LexState::String;
+            p = found + 1;
+        }
+        else if (found + 1 < end && found[1] == '/') {
+            p = scanner.find(found, end, '\n');
+        }
+        else {
+            p = found + 1;
+        }
+    }
+
+    return state;
+}
+
+/// Find the start of the first line after `from` that does not begin inside a
+/// string literal
+size_t findSafeSplit(std::string_view data, size_t from, LexState state) {
+    while (from < data.size()) {
+        auto lineEnd = data.find('\n', from);
+        if (lineEnd == std::string_view::npos) {
+            return data.size();
+        }
+        state = scanState(data.data() + from, data.data() + lineEnd, state);
+        from = lineEnd + 1;
+        if (state == LexState::Code) {
+            return from;
+        }
+    }
+    return data.size();
+}
+
+/// Split at the first line start after the even split points
+std::vector<size_t> initialSplits(std::string_view data, size_t numChunks) {
+    auto splits = std::vector<size_t>{0};
+    for (size_t i = 1; i < numChunks; ++i) {
+        auto target = std::max(data.size() * i / numChunks, splits.back());
+        auto lineEnd = data.find('\n', target);
+        if (lineEnd == std::string_view::npos) {
+            break;
+        }
+        if (lineEnd + 1 > splits.back() && lineEnd + 1 < data.size()) {
+            splits.push_back(lineEnd + 1);
+        }
+    }
+    splits.push_back(data.size());
+    return splits;
+}
+
+/// Move split points that are inside string literals to the next safe line
+void repairSplits(std::string_view data, std::vector<size_t> &splits) {
+    auto numChunks = splits.size() - 1;
+
+    // Most chunks start in code, so speculate on that in parallel
+    auto endStates = std::vector<LexState>(numChunks);
+    ThreadPool::global().parallelFor(numChunks, [&](size_t i) {
+        endStates.at(i) = scanState(data.data() + splits.at(i),
+                                    data.data() + splits.at(i + 1),
+                                    LexState::Code);
+    });
+
+    auto repaired = std::vector<size_t>{0};
+    auto state = endStates.front();
+    for (size_t i = 1; i < numChunks; ++i) {
+        auto split = splits.at(i);
+        if (split < repaired.back()) {
+            // Already passed by a moved split point
+            auto end = splits.at(i + 1);
+            if (repaired.back() < end) {
+                state = scanState(data.data() + repaired.back(),
+                                  data.data() + end,
+                                  LexState::Code);
+            }
+            continue;
+        }
+
+        if (state == LexState::String) {
+            auto moved = findSafeSplit(data, split, LexState::String);
+            if (moved >= data.size()) {
+                break;
+            }
+            repaired.push_back(moved);
+            auto end = splits.at(i + 1);
+            state = moved < end ? scanState(data.data() + moved,
+                                            data.data() + end,
+                                            LexState::Code)
+                                : LexState::Code;
+            continue;
+        }
+
+        repaired.push_back(split);
+        state = endStates.at(i);
+    }
+    repaired.push_back(data.size());
+
+    // Moved split points can end up at the same position
+    repaired.erase(std::unique(repaired.begin(), repaired.end()),
+                   repaired.end());
+
+    splits = std::move(repaired);
+}
+
+} // namespace
+
+TokenBuffer tokenizeParallel(std::shared_ptr<const SourceBuffer> source,
+                             std::filesystem::path path,
+                             size_t numChunks) {
+    auto data = source->view();
+    auto file = sourcefiles::add(path, source);
+
+    if (numChunks == 0) {
+        numChunks = std::clamp(data.size() / minParallelChunkSize,
+                               size_t{1},
+                               ThreadPool::global().size());
+    }
+
+    auto splits = initialSplits(data, numChunks);
+    repairSplits(data, splits);
+    numChunks = splits.size() - 1;
+
+    auto chunks = std::vector<std::vector<Token>>(numChunks);
+    auto chunkErrors = std::vector<std::vector<TokenError>>(numChunks);
+
+    // Locations are byte offsets in the file, so the chunks can be joined
+    // without adjusting the tokens
+    ThreadPool::global().parallelFor(numChunks, [&](size_t i) {
+        auto tokenizer = Tokenizer{file, splits.at(i), splits.at(i + 1)};
+        chunks.at(i) = tokenizer.readAll(&chunkErrors.at(i));
+    });
+
+    auto totalTokens = size_t{0};
+    for (auto &chunk : chunks) {
+        totalTokens += chunk.size();
+    }
+
+    auto tokens = std::vector<Token>{};
+    auto errors = std::vector<TokenError>{};
+    tokens.reserve(totalTokens);
+    for (size_t i = 0; i < numChunks; ++i) {
+        for (auto &error : chunkErrors[i]) {
+            errors.push_back(
+                {tokens.size() + error.index, std::move(error.error)});
+        }
+        std::move(
+            chunks[i].begin(), chunks[i].end(), std::back_inserter(tokens));
+    }
+
+    auto eof = Token{};
+    eof.location = {file, static_cast<uint32_t>(data.size())};
+
+    return TokenBuffer{std::move(tokens), std::move(eof), std::move(errors)};
+}
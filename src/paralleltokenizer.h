@@ -0,0 +1,20 @@
+#pragma once
+
+#include "sourcebuffer.h"
+#include "tokenbuffer.h"
+#include <cstddef>
+#include <filesystem>
+#include <memory>
+
+/// Sources smaller than this are not split into chunks
+constexpr size_t minParallelChunkSize = 1 << 20;
+
+/// Split the source at line boundaries and tokenize the chunks on the global
+/// thread pool. The result is the same as when reading the whole source with a
+/// single `Tokenizer`. `numChunks` of 0 selects a count from the source size
+/// and the number of threads. Errors are thrown by the token buffer when the
+/// parser reaches them, so they are reported like a single tokenizer reports
+/// them
+TokenBuffer tokenizeParallel(std::shared_ptr<const SourceBuffer> source,
+                             std::filesystem::path path,
+                             size_t numChunks = 0);
@@ -0,0 +1,510 @@
+#pragma once
+
+#include "arena.h"
+#include "commands.h"
+#include "matperf/profiler.h"
+#include "parsererror.h"
+#include "resolver.h"
+#include "token.h"
+#include "tokeniterator.h"
+#include "vm.h"
+#include <charconv>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+// The parse functions are templated on the token stream so that they can be
+// used both with a `TokenIterator &` (virtual calls) and with a concrete final
+// stream type like `Tokenizer` where every token access is inlined
+
+/// Passed to all parse functions
+struct ParseState {
+    Arena &arena;
+
+    /// When set, syntax errors are collected here and parsing continues after
+    /// the next `;` or `}`. Otherwise the first error is thrown
+    std::vector<ParserError> *diagnostics = nullptr;
+};
+
+/// Parse operators with precedence `maxPrecedence` or tighter
+template <TokenStream It>
+vm::Expression *parseExpression(
+    It &it,
+    ParseState &state,
+    int maxPrecedence = tokentable::assignmentPrecedence);
+
+template <TokenStream It>
+vm::Expression *parsePostfix(It &it, ParseState &state);
+
+template <TokenStream It>
+vm::Expression *parseVariableDeclaration(It &it, ParseState &state) {
+    auto name = it.pop(TokenType::Text);
+
+    if (it.current().type != TokenType::Comma) {
+        auto declaration = state.arena.create<vm::VariableDeclaration>();
+        declaration->name = name.symbol;
+        return declaration;
+    }
+
+    auto names = std::vector<Symbol>{name.symbol};
+    for (; it.current().type == TokenType::Comma;) {
+        it.consume();
+        names.push_back(it.pop(TokenType::Text).symbol);
+    }
+
+    auto declaration = state.arena.create<vm::DestructuringDeclaration>();
+    declaration->names = state.arena.copy(names);
+    return declaration;
+}
+
+/// Skip to the start of the next statement after a syntax error. That is after
+/// the next `;` or block, or before the `}` that ends the current section
+template <TokenStream It>
+void synchronize(It &it, ParseState &state, TokenType end) {
+    int depth = 0;
+    for (;;) {
+        auto type = TokenType::Eof;
+        try {
+            type = it.current().type;
+        }
+        catch (ParserError &error) {
+            // Errors from the tokenizer. It moves past the bad text
+            state.diagnostics->push_back(std::move(error));
+            continue;
+        }
+
+        if (type == TokenType::Eof) {
+            return;
+        }
+        if (type == TokenType::RBrace) {
+            if (depth == 0 && end == TokenType::RBrace) {
+                return;
+            }
+            it.consume();
+            if (depth <= 1) {
+                return;
+            }
+            --depth;
+            continue;
+        }
+        it.consume();
+        if (type == TokenType::LBrace) {
+            ++depth;
+        }
+        else if (type == TokenType::Semi && depth == 0) {
+            return;
+        }
+    }
+}
+
+template <TokenStream It>
+vm::Expression *parseFunction(It &it, ParseState &state);
+
+/// Parse until `end`, which is not consumed
+template <TokenStream It>
+vm::Section *parseSection(It &it,
+                          ParseState &state,
+                          TokenType end = TokenType::Eof) {
+    auto exp = state.arena.create<vm::Section>();
+    auto commands = std::vector<vm::Expression *>{};
+
+    for (;;) {
+        try {
+            auto type = it.current().type;
+            if (type == TokenType::Eof || type == end) {
+                break;
+            }
+
+            auto location = it.current().location;
+
+            if (type == TokenType::Fn) {
+                if (end != TokenType::Eof) {
+                    throw ParserError{it.current(),
+                                      "Functions can only be declared at the "
+                                      "top level of a module"};
+                }
+                commands.push_back(parseFunction(it, state));
+                commands.back()->location = location;
+                continue;
+            }
+
+            commands.push_back(parseExpression(it, state));
+            commands.back()->location = location;
+
+            if (it.current().type == TokenType::Semi) {
+                it.pop(TokenType::Semi);
+            }
+        }
+        catch (ParserError &error) {
+            if (!state.diagnostics) {
+                throw;
+            }
+            state.diagnostics->push_back(std::move(error));
+            synchronize(it, state, end);
+        }
+    }
+
+    exp->commands = state.arena.copy(commands);
+
+    return exp;
+}
+
+/// `{ ... }`
+template <TokenStream It>
+vm::Section *parseBlock(It &it, ParseState &state) {
+    it.pop(TokenType::LBrace);
+    auto section = parseSection(it, state, TokenType::RBrace);
+    it.pop(TokenType::RBrace);
+    return section;
+}
+
+template <TokenStream It>
+vm::Expression *parseFor(It &it, ParseState &state) {
+    it.pop(TokenType::For);
+    it.pop(TokenType::LParen);
+
+    auto exp = state.arena.create<vm::ForDeclaration>();
+
+    // `in` is not an operator, so the expression ends before it
+    exp->declaration = parseExpression(it, state);
+    expect(it.pop(TokenType::Text), "in");
+
+    exp->range = parseExpression(it, state);
+
+    it.pop(TokenType::RParen);
+
+    exp->section = parseBlock(it, state);
+
+    return exp;
+}
+
+template <TokenStream It>
+vm::Expression *parseIf(It &it, ParseState &state) {
+    it.pop(TokenType::If);
+    it.pop(TokenType::LParen);
+
+    auto exp = state.arena.create<vm::IfStatement>();
+    exp->condition = parseExpression(it, state);
+
+    it.pop(TokenType::RParen);
+
+    exp->then = parseBlock(it, state);
+
+    if (it.current().type != TokenType::Else) {
+        return exp;
+    }
+    it.consume();
+
+    if (it.current().type == TokenType::If) {
+        exp->otherwise = state.arena.create<vm::Section>();
+        exp->otherwise->commands =
+            state.arena.copy(std::vector{parseIf(it, state)});
+    }
+    else {
+        exp->otherwise = parseBlock(it, state);
+    }
+
+    return exp;
+}
+
+template <TokenStream It>
+vm::Expression *parseReturn(It &it, ParseState &state) {
+    it.pop(TokenType::Return);
+
+    auto exp = state.arena.create<vm::ReturnStatement>();
+    auto type = it.current().type;
+    if (type != TokenType::Semi && type != TokenType::RBrace) {
+        exp->value = parseExpression(it, state);
+    }
+    return exp;
+}
+
+/// `fn name(a, b) { ... }`
+template <TokenStream It>
+vm::Expression *parseFunction(It &it, ParseState &state) {
+    it.pop(TokenType::Fn);
+
+    auto exp = state.arena.create<vm::FunctionDeclaration>();
+    exp->name = it.pop(TokenType::Text).symbol;
+
+    it.pop(TokenType::LParen);
+    auto arguments = std::vector<Symbol>{};
+    for (; it.current().type != TokenType::RParen;) {
+        arguments.push_back(it.pop(TokenType::Text).symbol);
+        if (it.current().type != TokenType::RParen) {
+            it.pop(TokenType::Comma);
+        }
+    }
+    it.pop(TokenType::RParen);
+    exp->arguments = state.arena.copy(arguments);
+
+    exp->body = parseBlock(it, state);
+
+    return exp;
+}
+
+template <TokenStream It>
+std::vector<vm::Expression *> parseFunctionArguments(It &it,
+                                                     ParseState &state) {
+    auto args = std::vector<vm::Expression *>{};
+
+    it.pop();
+    for (; it.current().type != TokenType::RParen;) {
+        args.push_back(parseExpression(it, state));
+
+        if (it.current() == TokenType::RParen) {
+            break;
+        }
+        if (it.current() != TokenType::Comma) {
+            throw ParserError{it.current(), "Unexpected token"};
+        }
+        it.pop();
+    }
+    it.pop();
+
+    return args;
+}
+
+/// Numeric constants may contain `'` as digit separators
+inline vm::Constant::Literal parseNumber(const Token &token) {
+    auto text = std::string{};
+    for (auto c : token.text.view()) {
+        if (c != '\'') {
+            text.push_back(c);
+        }
+    }
+
+    auto begin = text.data();
+    auto end = text.data() + text.size();
+    auto result = std::from_chars_result{};
+    auto value = vm::Constant::Literal{};
+
+    if (text.find('.') != std::string::npos) {
+        auto number = 0.;
+        result = std::from_chars(begin, end, number);
+        value = vm::Float{number};
+    }
+    else {
+        auto number = int64_t{};
+        result = std::from_chars(begin, end, number);
+        value = vm::Int{number};
+    }
+
+    if (result.ec != std::errc{} || result.ptr != end) {
+        throw ParserError{token, "Invalid numeric constant"};
+    }
+
+    return value;
+}
+
+/// Literals, variables, prefix operators and parentheses
+template <TokenStream It>
+vm::Expression *parsePrimary(It &it, ParseState &state) {
+    switch (it.current().type) {
+    case TokenType::Let:
+        it.consume();
+        return parseVariableDeclaration(it, state);
+    case TokenType::Text: {
+        auto accessor = state.arena.create<vm::VariableAccessor>();
+        accessor->name = it.pop(TokenType::Text).symbol;
+        return accessor;
+    }
+    case TokenType::StringLiteral: {
+        auto literal = state.arena.create<vm::StringLiteral>();
+        auto token = it.pop();
+        // Text that is not in the source buffer does not outlive the token
+        literal->text = token.text.isOwned()
+                            ? state.arena.copy(token.text.view())
+                            : token.text.view();
+        return literal;
+    }
+    case TokenType::NumericConstant: {
+        auto constant = state.arena.create<vm::Constant>();
+        constant->literal = parseNumber(it.pop());
+        return constant;
+    }
+    case TokenType::True:
+    case TokenType::False: {
+        auto constant = state.arena.create<vm::Constant>();
+        constant->literal = vm::Bool{it.pop().type == TokenType::True};
+        return constant;
+    }
+    case TokenType::LSquare:
+        it.pop();
+        it.pop(TokenType::RSquare);
+        return state.arena.create<vm::ArrayDeclaration>();
+    case TokenType::LBrace:
+        // Statements never start with a block, so this is always a literal
+        it.pop();
+        it.pop(TokenType::RBrace);
+        return state.arena.create<vm::DictionaryDeclaration>();
+    case TokenType::LParen: {
+        it.pop();
+        auto exp = parseExpression(it, state);
+        it.pop(TokenType::RParen);
+        return exp;
+    }
+    case TokenType::Minus:
+    case TokenType::Exclaim: {
+        auto exp = state.arena.create<vm::UnaryOperation>();
+        exp->op = it.pop().type;
+        exp->operand = parsePostfix(it, state);
+        return exp;
+    }
+    default:
+        throw ParserError{it.current(), "Unexpected token"};
+    }
+}
+
+/// Calls, member function calls and indexing. These bind tighter than any
+/// binary operator
+template <TokenStream It>
+vm::Expression *parsePostfix(It &it, ParseState &state) {
+    auto exp = parsePrimary(it, state);
+
+    for (;;) {
+        switch (it.current().type) {
+        case TokenType::LParen: {
+            auto call = state.arena.create<vm::FunctionCall>();
+            call->functionValue = exp;
+            call->arguments =
+                state.arena.copy(parseFunctionArguments(it, state));
+            exp = call;
+            break;
+        }
+        case TokenType::Period: {
+            it.consume();
+
+            auto memberFunction =
+                state.arena.create<vm::MemberFunctionCall>();
+            memberFunction->object = exp;
+            memberFunction->memberName = it.pop().symbol;
+
+            // TODO: Implement regular member accessors
+            it.current(TokenType::LParen);
+
+            memberFunction->arguments =
+                state.arena.copy(parseFunctionArguments(it, state));
+            exp = memberFunction;
+            break;
+        }
+        case TokenType::LSquare: {
+            it.consume();
+
+            auto index = state.arena.create<vm::IndexAccessor>();
+            index->object = exp;
+            index->index = parseExpression(it, state);
+            it.pop(TokenType::RSquare);
+            exp = index;
+            break;
+        }
+        default:
+            return exp;
+        }
+    }
+}
+
+/// `+=` -> `+` and so on, Unknown for anything else
+constexpr TokenType compoundOperator(TokenType type) {
+    switch (type) {
+    case TokenType::PlusEqual:
+        return TokenType::Plus;
+    case TokenType::MinusEqual:
+        return TokenType::Minus;
+    case TokenType::StarEqual:
+        return TokenType::Star;
+    case TokenType::SlashEqual:
+        return TokenType::Slash;
+    case TokenType::PercentEqual:
+        return TokenType::Percent;
+    default:
+        return TokenType::Unknown;
+    }
+}
+
+inline vm::Expression *createBinary(ParseState &state,
+                                    const Token &op,
+                                    vm::Expression *left,
+                                    vm::Expression *right) {
+    if (op.type == TokenType::Equal) {
+        auto exp = state.arena.create<vm::Assignment>();
+        exp->left = left;
+        exp->right = right;
+        return exp;
+    }
+
+    if (auto type = compoundOperator(op.type); type != TokenType::Unknown) {
+        auto exp = state.arena.create<vm::CompoundAssignment>();
+        exp->op = type;
+        exp->left = left;
+        exp->right = right;
+        return exp;
+    }
+
+    if (op.type == TokenType::LeftArrow) {
+        throw ParserError{op, "Operator is not supported"};
+    }
+
+    auto exp = state.arena.create<vm::BinaryOperation>();
+    exp->op = op.type;
+    exp->left = left;
+    exp->right = right;
+    return exp;
+}
+
+// Precedence climbing: the right hand side of an operator only takes operators
+// that bind tighter, or as tight for the right associative assignments
+template <TokenStream It>
+vm::Expression *parseExpression(It &it, ParseState &state, int maxPrecedence) {
+    // Statements that start with a keyword
+    switch (it.current().type) {
+    case TokenType::For:
+        return parseFor(it, state);
+    case TokenType::If:
+        return parseIf(it, state);
+    case TokenType::Return:
+        return parseReturn(it, state);
+    default:
+        break;
+    }
+
+    auto exp = parsePostfix(it, state);
+
+    for (;;) {
+        auto type = it.current().type;
+        auto precedence = tokentable::precedence(type);
+        if (!precedence || precedence > maxPrecedence ||
+            type == TokenType::Period) {
+            return exp;
+        }
+
+        auto op = it.pop();
+        auto right = parseExpression(
+            it,
+            state,
+            precedence == tokentable::assignmentPrecedence ? precedence
+                                                           : precedence - 1);
+        exp = createBinary(state, op, exp, right);
+    }
+}
+
+/// The syntax tree is allocated in `arena`, which needs to outlive the module.
+/// If `diagnostics` is set, all syntax errors are collected there instead of
+/// throwing the first one
+template <TokenStream It>
+vm::Ref<vm::Map> parseRoot(
+    It &it, Arena &arena, std::vector<ParserError> *diagnostics = nullptr) {
+    PROFILE_FUNCTION();
+
+    auto state = ParseState{
+        .arena = arena,
+        .diagnostics = diagnostics,
+    };
+
+    auto body = parseSection(it, state);
+    resolve(*body);
+
+    return vm::createModule(body);
+}
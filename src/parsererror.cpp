@@ -1,24 +1,25 @@
-
 #include "parsererror.h"
-#include <fstream>
+#include "sourcefiles.h"
+#include <algorithm>
 #include <string>
 
 std::string ParserError::getContext(const Token &token) {
-    if (!token.location.path) {
+    auto file = token.location.file;
+    if (!file) {
         return "";
     }
-    auto linenum = 0;
-    auto file = std::ifstream{*token.location.path};
+
+    // The source is already in memory, so the lines are taken from the buffer
+    // instead of reading the file again
+    auto [line, column] = sourcefiles::lineColumn(file, token.location.offset);
 
     auto ret = std::string{};
 
-    for (std::string line; std::getline(file, line); ++linenum) {
-        if (linenum < token.line() && linenum > token.line() - 4) {
-            ret += line + "\n";
-        }
+    for (auto i = std::max(1, line - 2); i <= line; ++i) {
+        ret += sourcefiles::line(file, i);
+        ret += "\n";
     }
 
-    auto column = token.column();
     if (column > 1) {
         --column;
     }
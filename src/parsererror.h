@@ -17,7 +17,7 @@ struct ParserError : public std::exception {
     static auto createDescriptionString(const Token &token,
                                         std::string type = "error") {
         auto ss = std::ostringstream{};
-        ss << (token.location.path
+        ss << (token.location.file
                    ? std::filesystem::relative(token.path(),
                                                std::filesystem::current_path())
                          .string()
@@ -0,0 +1,212 @@
+#include "resolver.h"
+#include "commands.h"
+#include <span>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace {
+
+class Resolver {
+public:
+    /// The module scope is the outermost scope of every function. Functions
+    /// are resolved after the body, so that they see all module variables
+    void module(vm::Section &body) {
+        _scopes.emplace_back();
+        declare(symbols::This);
+        section(body);
+        body.slotCount = _scopes.back().slotCount;
+
+        for (auto f : std::exchange(_functions, {})) {
+            function(*f->body, f->arguments);
+        }
+        _scopes.pop_back();
+    }
+
+    /// The frame of a call starts with `this` and the arguments
+    void function(vm::Section &body, std::span<const Symbol> arguments) {
+        _scopes.emplace_back();
+        declare(symbols::This);
+        for (auto name : arguments) {
+            declare(name);
+        }
+        section(body);
+        body.slotCount = _scopes.back().slotCount;
+        _scopes.pop_back();
+    }
+
+private:
+    struct Scope {
+        /// Symbol id to slot of the latest declaration
+        std::unordered_map<uint32_t, uint32_t> names;
+        uint32_t slotCount = 0;
+
+        /// Blocks like if branches have their own names, but store their
+        /// variables in the slots of the enclosing scope
+        bool block = false;
+    };
+
+    void section(vm::Section &s) {
+        for (auto e : s.commands) {
+            expression(e);
+        }
+    }
+
+    void expression(vm::Expression *e) {
+        if (!e) {
+            return;
+        }
+
+        switch (e->kind()) {
+        case vm::NodeKind::VariableDeclaration: {
+            auto &d = static_cast<vm::VariableDeclaration &>(*e);
+            d.slot = declare(d.name);
+            return;
+        }
+        case vm::NodeKind::DestructuringDeclaration: {
+            auto &d = static_cast<vm::DestructuringDeclaration &>(*e);
+            for (size_t i = 0; i < d.names.size(); ++i) {
+                auto slot = declare(d.names[i]);
+                if (i == 0) {
+                    d.firstSlot = slot;
+                }
+            }
+            return;
+        }
+        case vm::NodeKind::Assignment: {
+            // The right side is run first, so `let x = x` refers to an outer x
+            auto &a = static_cast<vm::Assignment &>(*e);
+            expression(a.right);
+            expression(a.left);
+            return;
+        }
+        case vm::NodeKind::CompoundAssignment: {
+            auto &a = static_cast<vm::CompoundAssignment &>(*e);
+            expression(a.left);
+            expression(a.right);
+            return;
+        }
+        case vm::NodeKind::BinaryOperation: {
+            auto &b = static_cast<vm::BinaryOperation &>(*e);
+            expression(b.left);
+            expression(b.right);
+            return;
+        }
+        case vm::NodeKind::UnaryOperation:
+            expression(static_cast<vm::UnaryOperation &>(*e).operand);
+            return;
+        case vm::NodeKind::VariableAccessor: {
+            auto &v = static_cast<vm::VariableAccessor &>(*e);
+            v.address = lookup(v.name);
+            return;
+        }
+        case vm::NodeKind::FunctionCall: {
+            auto &call = static_cast<vm::FunctionCall &>(*e);
+            expression(call.functionValue);
+            for (auto a : call.arguments) {
+                expression(a);
+            }
+            return;
+        }
+        case vm::NodeKind::StringLiteral:
+        case vm::NodeKind::Constant:
+        case vm::NodeKind::ArrayDeclaration:
+        case vm::NodeKind::DictionaryDeclaration:
+            return;
+        case vm::NodeKind::ForDeclaration: {
+            // The declaration, the range and the body share one scope
+            auto &f = static_cast<vm::ForDeclaration &>(*e);
+            _scopes.emplace_back();
+            expression(f.declaration);
+            expression(f.range);
+            section(*f.section);
+            f.section->slotCount = _scopes.back().slotCount;
+            _scopes.pop_back();
+            return;
+        }
+        case vm::NodeKind::IndexAccessor: {
+            auto &index = static_cast<vm::IndexAccessor &>(*e);
+            expression(index.object);
+            expression(index.index);
+            return;
+        }
+        case vm::NodeKind::FunctionDeclaration:
+            // Functions are only declared in the module scope
+            _functions.push_back(static_cast<vm::FunctionDeclaration *>(e));
+            return;
+        case vm::NodeKind::IfStatement: {
+            auto &i = static_cast<vm::IfStatement &>(*e);
+            expression(i.condition);
+            block(*i.then);
+            if (i.otherwise) {
+                block(*i.otherwise);
+            }
+            return;
+        }
+        case vm::NodeKind::ReturnStatement:
+            expression(static_cast<vm::ReturnStatement &>(*e).value);
+            return;
+        case vm::NodeKind::MemberFunctionCall: {
+            auto &call = static_cast<vm::MemberFunctionCall &>(*e);
+            expression(call.object);
+            for (auto a : call.arguments) {
+                expression(a);
+            }
+            return;
+        }
+        }
+    }
+
+    void block(vm::Section &s) {
+        _scopes.push_back({.block = true});
+        section(s);
+        _scopes.pop_back();
+    }
+
+    /// A name declared again in the same scope gets a new slot, which hides
+    /// the old one from the code after it. Module variables keep their slot,
+    /// since functions refer to it
+    uint32_t declare(Symbol name) {
+        if (_scopes.size() == 1) {
+            auto &names = _scopes.front().names;
+            if (auto it = names.find(name.id()); it != names.end()) {
+                return it->second;
+            }
+        }
+
+        auto owner = _scopes.rbegin();
+        while (owner->block) {
+            ++owner;
+        }
+        auto slot = owner->slotCount++;
+        _scopes.back().names[name.id()] = slot;
+        return slot;
+    }
+
+    /// Blocks are not counted in the depth, since they have no slots
+    vm::SlotAddress lookup(Symbol name) const {
+        uint32_t depth = 0;
+        for (auto scope = _scopes.rbegin(); scope != _scopes.rend(); ++scope) {
+            if (auto it = scope->names.find(name.id());
+                it != scope->names.end()) {
+                return {
+                    .depth = depth,
+                    .slot = it->second,
+                };
+            }
+            if (!scope->block) {
+                ++depth;
+            }
+        }
+        return {};
+    }
+
+    std::vector<Scope> _scopes;
+    std::vector<vm::FunctionDeclaration *> _functions;
+};
+
+} // namespace
+
+void resolve(vm::Section &body) {
+    Resolver{}.module(body);
+}
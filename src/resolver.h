@@ -0,0 +1,12 @@
+#pragma once
+
+#include "vm.h"
+
+/// Give every variable declared in a module body a slot in its scope, and
+/// point variable accessors directly at the slot of the declaration they refer
+/// to. The frame of a function starts with `this` and the arguments. Functions
+/// see their own variables and the variables of the module, which are one
+/// scope out from the function scope. Names that are not declared, like `std`
+/// and module functions, are left unresolved and are looked up by name when
+/// running
+void resolve(vm::Section &body);
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <stdexcept>
+
+/// Fixed capacity queue that never moves its elements when consuming from the
+/// front. Capacity must be a power of two
+template <typename T, size_t N>
+class RingBuffer {
+public:
+    static_assert(N > 0 && (N & (N - 1)) == 0,
+                  "ring buffer capacity must be a power of two");
+
+    /// Returns a reference to a cleared element at the back
+    T &emplace_back() {
+        if (full()) {
+            throw std::runtime_error{"ring buffer is full"};
+        }
+        auto &element = _data[(_begin + _size) & mask];
+        element = T{};
+        ++_size;
+        return element;
+    }
+
+    void pop_front() {
+        _begin = (_begin + 1) & mask;
+        --_size;
+    }
+
+    T &front() {
+        return _data[_begin];
+    }
+
+    /// Element relative to the front, not bounds checked
+    T &operator[](size_t index) {
+        return _data[(_begin + index) & mask];
+    }
+
+    T &at(size_t index) {
+        if (index >= _size) {
+            throw std::out_of_range{"ring buffer index out of range"};
+        }
+        return (*this)[index];
+    }
+
+    size_t size() const {
+        return _size;
+    }
+
+    bool empty() const {
+        return _size == 0;
+    }
+
+    bool full() const {
+        return _size == N;
+    }
+
+    static constexpr size_t capacity() {
+        return N;
+    }
+
+private:
+    static constexpr size_t mask = N - 1;
+
+    std::array<T, N> _data = {};
+    size_t _begin = 0;
+    size_t _size = 0;
+};
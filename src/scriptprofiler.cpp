@@ -0,0 +1,212 @@
+#include "scriptprofiler.h"
+#include "sourcefiles.h"
+#include <algorithm>
+#include <atomic>
+#include <csignal>
+#include <iomanip>
+#include <map>
+#include <ostream>
+#include <ranges>
+#include <string>
+#include <sys/time.h>
+#include <tuple>
+#include <vector>
+
+namespace scriptprofiler {
+
+namespace {
+
+struct Frame {
+    const vm::Function *function = nullptr;
+
+    /// The statement that runs in the frame, null before the first one
+    const vm::Expression *statement = nullptr;
+
+    auto operator<=>(const Frame &) const = default;
+};
+
+struct Counts {
+    size_t hits = 0;
+
+    /// Samples where the statement was running in the innermost frame
+    size_t self = 0;
+
+    /// Samples where the statement was on the stack
+    size_t total = 0;
+};
+
+struct Statement {
+    const vm::Expression *expression = nullptr;
+    Counts counts;
+};
+
+/// Timer ticks since the last sample. The only thing the signal handler
+/// touches
+std::atomic<uint32_t> ticks = 0;
+
+std::chrono::microseconds sampleInterval{};
+std::vector<Frame> stack;
+/// Indexed by `Expression::profileIndex`. The first entry is unused
+std::vector<Statement> statements(1);
+std::map<std::vector<Frame>, size_t> stacks;
+size_t sampleCount = 0;
+
+void onTick(int) {
+    ticks.fetch_add(1, std::memory_order_relaxed);
+}
+
+void setTimer(std::chrono::microseconds interval) {
+    auto value = timeval{
+        .tv_sec = static_cast<time_t>(interval.count() / 1'000'000),
+        .tv_usec = static_cast<suseconds_t>(interval.count() % 1'000'000),
+    };
+    auto timer = itimerval{.it_interval = value, .it_value = value};
+    setitimer(ITIMER_PROF, &timer, nullptr);
+}
+
+/// Charge the ticks since the last sample to the current stack
+void sample() {
+    auto count = ticks.exchange(0, std::memory_order_relaxed);
+    if (stack.empty()) {
+        return;
+    }
+
+    sampleCount += count;
+    stacks[stack] += count;
+
+    if (auto s = stack.back().statement) {
+        statements[s->profileIndex].counts.self += count;
+    }
+
+    // Recursive frames count a line once
+    auto seen = std::vector<const vm::Expression *>{};
+    for (auto &frame : stack) {
+        if (frame.statement &&
+            std::ranges::find(seen, frame.statement) == seen.end()) {
+            seen.push_back(frame.statement);
+            statements[frame.statement->profileIndex].counts.total += count;
+        }
+    }
+}
+
+/// `name:line`
+std::string label(const Frame &frame) {
+    auto name = frame.function->name ? std::string{frame.function->name.text()}
+                                     : std::string{"<native>"};
+    if (!frame.statement) {
+        return name;
+    }
+    auto location = frame.statement->location;
+    return name + ":" +
+           std::to_string(
+               sourcefiles::lineColumn(location.file, location.offset).line);
+}
+
+} // namespace
+
+void start(std::chrono::microseconds interval) {
+    sampleInterval = interval;
+    enabled = true;
+
+    struct sigaction action = {};
+    action.sa_handler = onTick;
+    action.sa_flags = SA_RESTART;
+    sigemptyset(&action.sa_mask);
+    sigaction(SIGPROF, &action, nullptr);
+    setTimer(interval);
+}
+
+void stop() {
+    setTimer({});
+    enabled = false;
+}
+
+void statement(vm::Expression &e) {
+    if (ticks.load(std::memory_order_relaxed)) {
+        sample();
+    }
+    if (!stack.empty()) {
+        stack.back().statement = &e;
+    }
+    if (!e.profileIndex) {
+        e.profileIndex = static_cast<uint32_t>(statements.size());
+        statements.push_back({.expression = &e});
+    }
+    ++statements[e.profileIndex].counts.hits;
+}
+
+void enter(const vm::Function &f) {
+    stack.push_back({.function = &f});
+}
+
+void leave() {
+    if (ticks.load(std::memory_order_relaxed)) {
+        sample();
+    }
+    stack.pop_back();
+}
+
+void writeReport(std::ostream &stream) {
+    struct Line {
+        sourcefiles::FileId file = 0;
+        int line = 0;
+        Counts counts;
+    };
+
+    // Statements on the same line are added together, but a line is only
+    // counted once in a stack even if several of its statements are
+    auto lines = std::map<std::pair<sourcefiles::FileId, int>, Counts>{};
+    for (auto &[e, counts] : statements | std::views::drop(1)) {
+        auto line = sourcefiles::lineColumn(e->location.file,
+                                            e->location.offset)
+                        .line;
+        auto &sum = lines[{e->location.file, line}];
+        sum.hits += counts.hits;
+        sum.self += counts.self;
+        sum.total = std::max(sum.total, counts.total);
+    }
+
+    auto sorted = std::vector<Line>{};
+    for (auto &[key, counts] : lines) {
+        sorted.push_back({key.first, key.second, counts});
+    }
+    std::ranges::sort(sorted, [](const Line &a, const Line &b) {
+        return std::tie(b.counts.self, b.counts.total, b.counts.hits) <
+               std::tie(a.counts.self, a.counts.total, a.counts.hits);
+    });
+
+    auto percent = [](size_t samples) {
+        return sampleCount ? 100. * samples / sampleCount : 0.;
+    };
+
+    stream << "script profile: " << sampleCount << " samples of "
+           << sampleInterval.count() << " us\n";
+    stream << "  self %  total %         hits  line\n";
+    stream << std::fixed << std::setprecision(1);
+    for (auto &line : sorted) {
+        auto text = sourcefiles::line(line.file, line.line);
+        auto first = text.find_first_not_of(" \t");
+        text = first == text.npos ? "" : text.substr(first);
+
+        stream << std::setw(7) << percent(line.counts.self) << "% "
+               << std::setw(7) << percent(line.counts.total) << "% "
+               << std::setw(12) << line.counts.hits << "  "
+               << sourcefiles::path(line.file).filename().string() << ":"
+               << line.line << "  " << text << "\n";
+    }
+    stream << std::defaultfloat;
+}
+
+void writeFolded(std::ostream &stream) {
+    for (auto &[frames, count] : stacks) {
+        if (!count) {
+            continue;
+        }
+        for (size_t i = 0; i < frames.size(); ++i) {
+            stream << (i ? ";" : "") << label(frames[i]);
+        }
+        stream << " " << count << "\n";
+    }
+}
+
+} // namespace scriptprofiler
@@ -0,0 +1,56 @@
+#pragma once
+
+#include "vm.h"
+#include <chrono>
+#include <iosfwd>
+
+// Profiler for scripts, for `--profile-script`. Every statement counts its
+// hits and marks the current line of its frame, and calls keep a stack of
+// script frames. A timer samples the stack at the next statement, so that the
+// signal handler only has to count ticks
+
+namespace scriptprofiler {
+
+/// Checked before every statement and call
+inline bool enabled = false;
+
+void start(std::chrono::microseconds interval = std::chrono::milliseconds{1});
+void stop();
+
+/// Called before a statement runs
+void statement(vm::Expression &e);
+
+void enter(const vm::Function &f);
+void leave();
+
+/// Keeps `f` on the stack while it runs
+class Call {
+public:
+    explicit Call(const vm::Function &f)
+        : _active{enabled} {
+        if (_active) {
+            enter(f);
+        }
+    }
+
+    ~Call() {
+        if (_active) {
+            leave();
+        }
+    }
+
+    Call(const Call &) = delete;
+    Call &operator=(const Call &) = delete;
+
+private:
+    bool _active;
+};
+
+/// Lines sorted by the time spent on them, with hit counts
+void writeReport(std::ostream &stream);
+
+/// One line per sampled stack, `main:12;fib:3;fib:5 42`, for flame graph
+/// tools
+void writeFolded(std::ostream &stream);
+
+} // namespace scriptprofiler
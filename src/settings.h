@@ -1,18 +1,129 @@
 #pragma once
 
+#include <cstddef>
 #include <filesystem>
-#include <ranges>
+#include <stdexcept>
+#include <string>
 #include <vector>
 
 struct Settings {
+    enum class Engine {
+        /// Run the syntax tree directly
+        Ast,
+        Bytecode,
+    };
+
     std::filesystem::path path;
 
+    /// Number of chunks to tokenize in parallel. 0 means automatic, 1 turns
+    /// parallel tokenization off
+    size_t lexThreads = 0;
+
+    /// Where parsed modules are cached. Empty means next to the source file
+    std::filesystem::path cacheDir;
+
+    bool useCache = true;
+
+    /// Only report syntax errors, do not run the script
+    bool lint = false;
+
+    Engine engine = Engine::Bytecode;
+
+    enum class Jit {
+        Off,
+        /// Compile hot functions and loops to machine code
+        On,
+        /// Compile everything, to compare with the interpreter
+        Always,
+    };
+
+    /// Only used by the byte code engine. On platforms without a jit the byte
+    /// code is interpreted
+    Jit jit = Jit::On;
+
+    /// Where the script profiler writes folded stacks. Empty means that the
+    /// script is not profiled
+    std::filesystem::path profileScript;
+
+    /// Print garbage collector statistics when the script is done
+    bool gcStats = false;
+
+    /// New containers between collections of the youngest generation. 0 keeps
+    /// the default
+    size_t gcThreshold = 0;
+
     Settings(int argc, char *argv[]) {
         auto args = std::vector<std::string>{argv + 1, argv + argc};
 
-        for (auto i : std::ranges::iota_view{0uz, args.size()}) {
+        for (size_t i = 0; i < args.size(); ++i) {
             auto arg = args.at(i);
 
+            if (arg == "--lex-threads") {
+                lexThreads = std::stoul(args.at(++i));
+                continue;
+            }
+
+            if (arg == "--cache-dir") {
+                cacheDir = args.at(++i);
+                continue;
+            }
+
+            if (arg.starts_with("--engine=")) {
+                auto name = arg.substr(arg.find('=') + 1);
+                if (name == "ast") {
+                    engine = Engine::Ast;
+                }
+                else if (name == "bytecode") {
+                    engine = Engine::Bytecode;
+                }
+                else {
+                    throw std::invalid_argument{"unknown engine " + name};
+                }
+                continue;
+            }
+
+            if (arg.starts_with("--jit=")) {
+                auto name = arg.substr(arg.find('=') + 1);
+                if (name == "off") {
+                    jit = Jit::Off;
+                }
+                else if (name == "on") {
+                    jit = Jit::On;
+                }
+                else if (name == "always") {
+                    jit = Jit::Always;
+                }
+                else {
+                    throw std::invalid_argument{"unknown jit mode " + name};
+                }
+                continue;
+            }
+
+            if (arg == "--lint") {
+                lint = true;
+                continue;
+            }
+
+            if (arg == "--profile-script") {
+                profileScript = args.at(++i);
+                continue;
+            }
+
+            if (arg == "--gc-stats") {
+                gcStats = true;
+                continue;
+            }
+
+            if (arg == "--gc-threshold") {
+                gcThreshold = std::stoul(args.at(++i));
+                continue;
+            }
+
+            if (arg == "--no-cache") {
+                useCache = false;
+                continue;
+            }
+
             path = arg;
         }
     }
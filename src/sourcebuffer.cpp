@@ -0,0 +1,81 @@
+#include "sourcebuffer.h"
+#include <cstdint>
+#include <fcntl.h>
+#include <iterator>
+#include <limits>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+SourceBuffer::~SourceBuffer() {
+    if (_mapped) {
+        munmap(_mapped, _size);
+    }
+}
+
+std::shared_ptr<SourceBuffer> SourceBuffer::map(
+    const std::filesystem::path &path) {
+    auto fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw std::runtime_error{"could not open module " + path.string()};
+    }
+
+    struct stat info = {};
+    if (fstat(fd, &info) != 0) {
+        close(fd);
+        throw std::runtime_error{"could not stat module " + path.string()};
+    }
+
+    auto buffer = std::shared_ptr<SourceBuffer>{new SourceBuffer{}};
+
+    if (info.st_size > 0) {
+        auto size = static_cast<size_t>(info.st_size);
+        if (tooLarge(size)) {
+            close(fd);
+            throw std::runtime_error{"module " + path.string() +
+                                     " is larger than 4 GB"};
+        }
+        auto mapped = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (mapped == MAP_FAILED) {
+            close(fd);
+            throw std::runtime_error{"could not map module " + path.string()};
+        }
+        madvise(mapped, size, MADV_SEQUENTIAL);
+
+        buffer->_mapped = mapped;
+        buffer->_data = static_cast<const char *>(mapped);
+        buffer->_size = size;
+    }
+
+    close(fd);
+
+    return buffer;
+}
+
+std::shared_ptr<SourceBuffer> SourceBuffer::read(std::istream &in) {
+    auto buffer = std::shared_ptr<SourceBuffer>{new SourceBuffer{}};
+    buffer->_owned.assign(std::istreambuf_iterator<char>{in},
+                          std::istreambuf_iterator<char>{});
+    if (tooLarge(buffer->_owned.size())) {
+        throw std::runtime_error{"module from stdin is larger than 4 GB"};
+    }
+    buffer->_data = buffer->_owned.data();
+    buffer->_size = buffer->_owned.size();
+    return buffer;
+}
+
+std::shared_ptr<SourceBuffer> SourceBuffer::borrow(std::string_view data) {
+    if (tooLarge(data.size())) {
+        throw std::runtime_error{"source is larger than 4 GB"};
+    }
+    auto buffer = std::shared_ptr<SourceBuffer>{new SourceBuffer{}};
+    buffer->_data = data.data();
+    buffer->_size = data.size();
+    return buffer;
+}
+
+bool SourceBuffer::tooLarge(size_t size) {
+    // The end of the buffer is a location too, for the end of file token
+    return size > std::numeric_limits<uint32_t>::max();
+}
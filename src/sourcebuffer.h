@@ -0,0 +1,54 @@
+#pragma once
+
+#include <cstddef>
+#include <filesystem>
+#include <istream>
+#include <memory>
+#include <string>
+#include <string_view>
+
+/// The complete text of a source file kept in memory for the lifetime of the
+/// buffer. Tokens created by the tokenizer point into this memory, so the
+/// buffer must outlive all tokens read from it. Token locations are 32 bit
+/// offsets, so larger buffers are rejected when they are created
+class SourceBuffer {
+public:
+    SourceBuffer(const SourceBuffer &) = delete;
+    SourceBuffer(SourceBuffer &&) = delete;
+    SourceBuffer &operator=(const SourceBuffer &) = delete;
+    SourceBuffer &operator=(SourceBuffer &&) = delete;
+    ~SourceBuffer();
+
+    /// Memory map a file
+    static std::shared_ptr<SourceBuffer> map(const std::filesystem::path &path);
+
+    /// Read a whole stream into a buffer owned by the SourceBuffer
+    static std::shared_ptr<SourceBuffer> read(std::istream &in);
+
+    /// Use memory owned by the caller. No copy is made
+    static std::shared_ptr<SourceBuffer> borrow(std::string_view data);
+
+    std::string_view view() const {
+        return {_data, _size};
+    }
+
+    const char *data() const {
+        return _data;
+    }
+
+    size_t size() const {
+        return _size;
+    }
+
+private:
+    SourceBuffer() = default;
+
+    /// True if offsets into the buffer do not fit in a token location
+    static bool tooLarge(size_t size);
+
+    const char *_data = nullptr;
+    size_t _size = 0;
+
+    void *_mapped = nullptr;
+    std::string _owned;
+};
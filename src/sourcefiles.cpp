@@ -0,0 +1,116 @@
+#include "sourcefiles.h"
+#include "charscan.h"
+#include <algorithm>
+#include <mutex>
+#include <shared_mutex>
+#include <stdexcept>
+#include <vector>
+
+namespace sourcefiles {
+
+namespace {
+
+struct File {
+    std::filesystem::path path;
+    std::shared_ptr<const SourceBuffer> buffer;
+
+    std::once_flag lineFlag;
+    std::vector<uint32_t> lineStarts;
+
+    const std::vector<uint32_t> &lines() {
+        std::call_once(lineFlag, [this] {
+            auto &scanner = charscan::scanner();
+            auto begin = buffer->data();
+            auto end = begin + buffer->size();
+            lineStarts.push_back(0);
+            for (auto p = begin; (p = scanner.find(p, end, '\n')) != end;) {
+                ++p;
+                lineStarts.push_back(static_cast<uint32_t>(p - begin));
+            }
+        });
+        return lineStarts;
+    }
+};
+
+struct Registry {
+    std::shared_mutex mutex;
+    std::vector<std::unique_ptr<File>> files;
+
+    File *get(FileId id) {
+        auto lock = std::shared_lock{mutex};
+        if (id == 0 || id > files.size()) {
+            return nullptr;
+        }
+        return files.at(id - 1).get();
+    }
+
+    static Registry &instance() {
+        static auto registry = Registry{};
+        return registry;
+    }
+};
+
+} // namespace
+
+FileId add(std::filesystem::path path,
+           std::shared_ptr<const SourceBuffer> buffer) {
+    if (buffer->size() > UINT32_MAX) {
+        throw std::runtime_error{"source files larger than 4 GB are not "
+                                 "supported: " +
+                                 path.string()};
+    }
+
+    auto &registry = Registry::instance();
+    auto lock = std::unique_lock{registry.mutex};
+    auto &file = registry.files.emplace_back(std::make_unique<File>());
+    file->path = std::move(path);
+    file->buffer = std::move(buffer);
+    return static_cast<FileId>(registry.files.size());
+}
+
+const std::filesystem::path &path(FileId id) {
+    static const auto empty = std::filesystem::path{};
+    auto file = Registry::instance().get(id);
+    return file ? file->path : empty;
+}
+
+std::shared_ptr<const SourceBuffer> buffer(FileId id) {
+    auto file = Registry::instance().get(id);
+    return file ? file->buffer : nullptr;
+}
+
+LineColumn lineColumn(FileId id, uint32_t offset) {
+    auto file = Registry::instance().get(id);
+    if (!file) {
+        return {};
+    }
+
+    auto &lines = file->lines();
+    auto it = std::upper_bound(lines.begin(), lines.end(), offset);
+    auto line = static_cast<int>(it - lines.begin());
+    return {line, static_cast<int>(offset - *(it - 1)) + 1};
+}
+
+std::string_view line(FileId id, int line) {
+    auto file = Registry::instance().get(id);
+    if (!file) {
+        return {};
+    }
+
+    auto &lines = file->lines();
+    if (line < 1 || static_cast<size_t>(line) > lines.size()) {
+        return {};
+    }
+
+    auto text = file->buffer->view();
+    auto begin = lines.at(line - 1);
+    auto end = static_cast<size_t>(line) < lines.size() ? lines.at(line) - 1
+                                                        : text.size();
+    auto ret = text.substr(begin, end - begin);
+    if (ret.ends_with('\r')) {
+        ret.remove_suffix(1);
+    }
+    return ret;
+}
+
+} // namespace sourcefiles
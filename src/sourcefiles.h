@@ -0,0 +1,38 @@
+#pragma once
+
+#include "sourcebuffer.h"
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <string_view>
+
+/// Registry of all loaded source files. Tokens only store a file id and a byte
+/// offset, and line and column are calculated from here when needed. The
+/// registry keeps the source buffers alive, so tokens can always refer to them
+namespace sourcefiles {
+
+/// 0 means unknown file
+using FileId = uint32_t;
+
+struct LineColumn {
+    int line = 0;
+    int column = 0;
+};
+
+FileId add(std::filesystem::path path, std::shared_ptr<const SourceBuffer>);
+
+/// Empty path for unknown files
+const std::filesystem::path &path(FileId file);
+
+/// Null for unknown files
+std::shared_ptr<const SourceBuffer> buffer(FileId file);
+
+/// Line and column starting at 1. The line offset table is created for each
+/// file the first time it is used
+LineColumn lineColumn(FileId file, uint32_t offset);
+
+/// Text of a line starting at 1, without the line break. Empty if the line
+/// does not exist
+std::string_view line(FileId file, int line);
+
+} // namespace sourcefiles
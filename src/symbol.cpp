@@ -0,0 +1,68 @@
+#include "symbol.h"
+#include <deque>
+#include <mutex>
+#include <shared_mutex>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace {
+
+class SymbolTable {
+public:
+    SymbolTable() {
+        _texts.emplace_back(); // Id 0 is no symbol
+#define SYMBOL(name, text)                                                     \
+    if (intern(text) != symbols::name.id()) {                                  \
+        throw std::logic_error{"duplicate builtin symbol " text};              \
+    }
+        BUILTIN_SYMBOL_LIST
+#undef SYMBOL
+    }
+
+    uint32_t intern(std::string_view text) {
+        {
+            auto lock = std::shared_lock{_mutex};
+            if (auto f = _ids.find(text); f != _ids.end()) {
+                return f->second;
+            }
+        }
+
+        auto lock = std::unique_lock{_mutex};
+        if (auto f = _ids.find(text); f != _ids.end()) {
+            return f->second; // Interned by another thread in between
+        }
+
+        auto &stored = _storage.emplace_back(text);
+        auto id = static_cast<uint32_t>(_texts.size());
+        _texts.push_back(stored);
+        _ids.emplace(stored, id);
+        return id;
+    }
+
+    std::string_view text(uint32_t id) {
+        auto lock = std::shared_lock{_mutex};
+        return _texts.at(id);
+    }
+
+    static SymbolTable &instance() {
+        static auto table = SymbolTable{};
+        return table;
+    }
+
+private:
+    std::shared_mutex _mutex;
+    std::deque<std::string> _storage;
+    std::vector<std::string_view> _texts;
+    std::unordered_map<std::string_view, uint32_t> _ids;
+};
+
+} // namespace
+
+Symbol::Symbol(std::string_view text)
+    : _id{SymbolTable::instance().intern(text)} {}
+
+std::string_view Symbol::text() const {
+    return SymbolTable::instance().text(_id);
+}
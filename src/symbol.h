@@ -0,0 +1,93 @@
+#pragma once
+
+#include <cstdint>
+#include <ostream>
+#include <string_view>
+
+/// Symbols that the runtime refers to by name. They are interned before
+/// anything else so that their ids are known at compile time
+// clang-format off
+#define BUILTIN_SYMBOL_LIST \
+    SYMBOL(This, "this")\
+    SYMBOL(Value, "value")\
+    SYMBOL(Next, "next")\
+    SYMBOL(Main, "main")\
+    SYMBOL(Std, "std")\
+    SYMBOL(File, "file")\
+    SYMBOL(Path, "path")\
+    SYMBOL(Lines, "lines")\
+    SYMBOL(Open, "open")\
+    SYMBOL(Abs, "abs")\
+    SYMBOL(Range, "range")\
+    SYMBOL(Push, "push")\
+    SYMBOL(Size, "size")\
+    SYMBOL(Sort, "sort")\
+    SYMBOL(Sum, "sum")\
+    SYMBOL(Min, "min")\
+    SYMBOL(Max, "max")\
+    SYMBOL(CountOf, "count")\
+    SYMBOL(BinarySearch, "binary_search")\
+    SYMBOL(Zip, "zip")\
+    SYMBOL(Map, "map")\
+    SYMBOL(Get, "get")\
+    SYMBOL(Set, "set")\
+    SYMBOL(Contains, "contains")\
+    SYMBOL(Increment, "increment")\
+    SYMBOL(Keys, "keys")\
+    SYMBOL(Println, "println")\
+    SYMBOL(Help, "help") // clang-format on
+
+/// Dense id for an interned identifier. Two symbols are equal exactly when
+/// their texts are equal, so comparing them is an integer compare
+class Symbol {
+public:
+    constexpr Symbol() = default;
+
+    /// Find or create the symbol for a text. Thread safe
+    explicit Symbol(std::string_view text);
+
+    static constexpr Symbol fromId(uint32_t id) {
+        auto symbol = Symbol{};
+        symbol._id = id;
+        return symbol;
+    }
+
+    constexpr uint32_t id() const {
+        return _id;
+    }
+
+    /// The interned text. Lives as long as the program
+    std::string_view text() const;
+
+    constexpr explicit operator bool() const {
+        return _id != 0;
+    }
+
+    constexpr bool operator==(const Symbol &) const = default;
+
+private:
+    /// 0 means no symbol
+    uint32_t _id = 0;
+};
+
+inline std::ostream &operator<<(std::ostream &stream, Symbol symbol) {
+    return stream << symbol.text();
+}
+
+namespace symbols {
+
+#define SYMBOL(name, text) name,
+
+enum class BuiltinId : uint32_t { None, BUILTIN_SYMBOL_LIST Count };
+
+#undef SYMBOL
+
+#define SYMBOL(name, text)                                                     \
+    inline constexpr auto name =                                               \
+        Symbol::fromId(static_cast<uint32_t>(BuiltinId::name));
+
+BUILTIN_SYMBOL_LIST
+
+#undef SYMBOL
+
+} // namespace symbols
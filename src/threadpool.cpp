@@ -0,0 +1,83 @@
+#include "threadpool.h"
+#include <algorithm>
+#include <exception>
+
+ThreadPool::ThreadPool(size_t numThreads) {
+    _threads.reserve(numThreads);
+    for (size_t i = 0; i < numThreads; ++i) {
+        _threads.emplace_back([this] { work(); });
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        auto lock = std::scoped_lock{_mutex};
+        _isRunning = false;
+    }
+    _cv.notify_all();
+    _threads.clear(); // Join before the queue and mutex are destroyed
+}
+
+void ThreadPool::parallelFor(size_t count,
+                             const std::function<void(size_t)> &f) {
+    if (count == 0) {
+        return;
+    }
+
+    auto futures = std::vector<std::future<void>>{};
+    auto error = std::exception_ptr{};
+
+    try {
+        futures.reserve(count - 1);
+        for (size_t i = 1; i < count; ++i) {
+            futures.push_back(submit([&f, i] { f(i); }));
+        }
+
+        f(0);
+    }
+    catch (...) {
+        error = std::current_exception();
+    }
+
+    // Jobs refer to `f` and to the locals of the caller, so all of them have
+    // to be done before an error is passed on
+    for (auto &future : futures) {
+        try {
+            future.get();
+        }
+        catch (...) {
+            if (!error) {
+                error = std::current_exception();
+            }
+        }
+    }
+
+    if (error) {
+        std::rethrow_exception(error);
+    }
+}
+
+size_t ThreadPool::defaultSize() {
+    return std::max(1u, std::thread::hardware_concurrency());
+}
+
+ThreadPool &ThreadPool::global() {
+    static auto pool = ThreadPool{};
+    return pool;
+}
+
+void ThreadPool::work() {
+    for (;;) {
+        auto job = std::function<void()>{};
+        {
+            auto lock = std::unique_lock{_mutex};
+            _cv.wait(lock, [this] { return !_isRunning || !_jobs.empty(); });
+            if (_jobs.empty()) {
+                return;
+            }
+            job = std::move(_jobs.front());
+            _jobs.pop();
+        }
+        job();
+    }
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+/// Fixed set of worker threads that run submitted jobs in order
+class ThreadPool {
+public:
+    ThreadPool(const ThreadPool &) = delete;
+    ThreadPool(ThreadPool &&) = delete;
+    ThreadPool &operator=(const ThreadPool &) = delete;
+    ThreadPool &operator=(ThreadPool &&) = delete;
+
+    explicit ThreadPool(size_t numThreads = defaultSize());
+    ~ThreadPool();
+
+    template <typename F>
+    auto submit(F f) -> std::future<decltype(f())> {
+        auto task =
+            std::make_shared<std::packaged_task<decltype(f())()>>(std::move(f));
+        auto future = task->get_future();
+        {
+            auto lock = std::scoped_lock{_mutex};
+            _jobs.push([task] { (*task)(); });
+        }
+        _cv.notify_one();
+        return future;
+    }
+
+    /// Run `f(i)` for every i in [0, count) and wait for all of them.
+    /// The calling thread runs one of the jobs. If jobs throw, the first
+    /// exception is rethrown when all jobs are done. Do not call from a job
+    /// running on the same pool, since it could wait for itself
+    void parallelFor(size_t count, const std::function<void(size_t)> &f);
+
+    size_t size() const {
+        return _threads.size();
+    }
+
+    static size_t defaultSize();
+
+    /// Pool shared by everything that needs threads
+    static ThreadPool &global();
+
+private:
+    void work();
+
+    std::vector<std::jthread> _threads;
+    std::queue<std::function<void()>> _jobs;
+    std::mutex _mutex;
+    std::condition_variable _cv;
+    bool _isRunning = true;
+};
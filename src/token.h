@@ -1,9 +1,119 @@
 #pragma once
 
+#include "sourcefiles.h"
+#include "symbol.h"
+#include "tokentable.h"
+#include <cstdint>
 #include <filesystem>
-#include <memory>
 #include <ostream>
 #include <string>
+#include <string_view>
+
+/// Text of a token. Usually a view into the source buffer that the token was
+/// read from. Text that does not exist verbatim in the source (for example
+/// tokens created with `t()` or numbers with digit separators removed) is owned
+/// by the token instead
+class TokenText {
+public:
+    TokenText() = default;
+
+    TokenText(std::string text)
+        : _owned{std::move(text)}
+        , _view{_owned}
+        , _isOwned{true} {}
+
+    TokenText(const char *text)
+        : TokenText{std::string{text}} {}
+
+    TokenText(const TokenText &other)
+        : _owned{other._owned}
+        , _view{other._isOwned ? std::string_view{_owned} : other._view}
+        , _isOwned{other._isOwned} {}
+
+    TokenText(TokenText &&other) noexcept
+        : _owned{std::move(other._owned)}
+        , _view{other._isOwned ? std::string_view{_owned} : other._view}
+        , _isOwned{other._isOwned} {}
+
+    TokenText &operator=(const TokenText &other) {
+        if (this != &other) {
+            _owned = other._owned;
+            _isOwned = other._isOwned;
+            _view = _isOwned ? std::string_view{_owned} : other._view;
+        }
+        return *this;
+    }
+
+    TokenText &operator=(TokenText &&other) noexcept {
+        if (this != &other) {
+            _owned = std::move(other._owned);
+            _isOwned = other._isOwned;
+            _view = _isOwned ? std::string_view{_owned} : other._view;
+        }
+        return *this;
+    }
+
+    /// Reference text that is kept alive by someone else
+    static TokenText view(std::string_view text) {
+        auto ret = TokenText{};
+        ret._view = text;
+        return ret;
+    }
+
+    std::string_view view() const {
+        return _view;
+    }
+
+    std::string str() const {
+        return std::string{_view};
+    }
+
+    operator std::string_view() const {
+        return _view;
+    }
+
+    bool isOwned() const {
+        return _isOwned;
+    }
+
+    size_t size() const {
+        return _view.size();
+    }
+
+    bool empty() const {
+        return _view.empty();
+    }
+
+    char front() const {
+        return _view.front();
+    }
+
+    friend bool operator==(const TokenText &a, const TokenText &b) {
+        return a._view == b._view;
+    }
+
+    friend bool operator==(const TokenText &a, std::string_view b) {
+        return a._view == b;
+    }
+
+    friend bool operator==(const TokenText &a, const char *b) {
+        return a._view == b;
+    }
+
+    friend std::string operator+(std::string a, const TokenText &b) {
+        return a.append(b._view);
+    }
+
+    friend std::ostream &operator<<(std::ostream &stream,
+                                    const TokenText &text) {
+        return stream << text._view;
+    }
+
+private:
+    std::string _owned;
+    std::string_view _view;
+    bool _isOwned = false;
+};
 
 struct Word {
     std::string text;
@@ -16,110 +126,35 @@ struct Word {
     }
 };
 
-/// Any is not a type but a selector that can be used to select any of the
-/// others Unknown is when the tokenizer cannot tell what type it is
-// clang-format off
-#define TYPE_LIST \
-KEYWORD(Fn)\
-    KEYWORD(Pub)\
-    KEYWORD(Impl)\
-    KEYWORD(True)\
-    KEYWORD(False)\
-    KEYWORD(Let)\
-    KEYWORD(Mut)\
-    \
-    ITEM(Text)\
-    KEYWORD(Struct)\
-    KEYWORD(Operator)\
-    KEYWORD(StringLiteral)\
-    KEYWORD(If)\
-    KEYWORD(Else)\
-    KEYWORD(Enum)\
-    KEYWORD(Int)\
-    KEYWORD(For)\
-    KEYWORD(Float)\
-    KEYWORD(Double)\
-    KEYWORD(I8)\
-    KEYWORD(I16)\
-    KEYWORD(I32)\
-    KEYWORD(I64)\
-    KEYWORD(Bool)\
-    KEYWORD(This)\
-    KEYWORD(Const)\
-    KEYWORD(Match)\
-    BOP(Period, ".", 2)\
-    BOP(Star, "*", 5)\
-    BOP(Slash, "/", 5)\
-    BOP(Percent, "%", 5)\
-    BOP(Plus, "+", 6)\
-    BOP(Minus, "-", 6)\
-    BOP(Less, "<", 9)\
-    BOP(LessEqual, "<=", 9)\
-    BOP(Greater, ">", 9)\
-    BOP(GreaterEqual, ">=", 9)\
-    BOP(EqualEqual, "==", 10)\
-    BOP(ExclaimEqual, "!=", 10)\
-    BOP(Amp, "&", 11)\
-    BOP(Equal, "=", 16)\
-    BOP(LeftArrow, "<-", 16)\
-    BOP(PlusEqual, "+=", 16)\
-    BOP(MinusEqual, "-=", 16)\
-    BOP(StarEqual, "*=", 16)\
-    BOP(SlashEqual, "/=", 16)\
-    BOP(PercentEqual, "%=", 16)\
-    OP(Comma, ",")\
-    OP(PlusPlus, "++")\
-    OP(Colon, ":")\
-    OP(Semi, ";")\
-    OP(LParen, "(")\
-    OP(RParen, ")")\
-    OP(LBrace, "{")\
-    OP(RBrace, "}")\
-    OP(LSquare, "[")\
-    OP(RSquare, "]")\
-    OP(Arrow, "->")\
-    OP(Exclaim, "!")\
-    OP(At, "@")\
-    ITEM(NumericConstant)\
-    KEYWORD(Return)\
-    ITEM(Any)\
-    ITEM(Unknown)\
-    ITEM(Eof) // clang-format on
-
-#define KEYWORD(x) x,
-#define ITEM(x) x,
-#define OP(x, y) x,
-#define BOP(x, y, z) x,
-
-enum class TokenType { TYPE_LIST };
-
-#undef ITEM
-#undef KEYWORD
-#undef OP
-#undef BOP
+
+/// Line and column are calculated from the offset when needed, see
+/// sourcefiles.h
+struct SourceLocation {
+    sourcefiles::FileId file = 0;
+    uint32_t offset = 0;
+};
 
 struct Token {
-    struct Location {
-        int line = 0;
-        int column = 0;
-        std::shared_ptr<std::filesystem::path> path;
-    };
+    using Location = SourceLocation;
 
-    std::string text;
+    TokenText text;
     TokenType type = TokenType::Unknown;
 
     Location location;
 
-    auto path() const {
-        return location.path ? *location.path : "";
+    /// Set for identifiers
+    Symbol symbol;
+
+    const std::filesystem::path &path() const {
+        return sourcefiles::path(location.file);
     }
 
-    auto column() const {
-        return location.column;
+    int column() const {
+        return sourcefiles::lineColumn(location.file, location.offset).column;
     }
 
-    auto line() const {
-        return location.line;
+    int line() const {
+        return sourcefiles::lineColumn(location.file, location.offset).line;
     }
 
     bool operator==(TokenType type) const {
@@ -138,22 +173,11 @@ struct Token {
         return type != TokenType::Eof;
     }
 
-    static Token from(std::string_view text,
-                      Location location = {0, 0, nullptr});
-
-    static Token fromPath(std::filesystem::path path,
-                          int line = 0,
-                          int column = 0) {
-        return Token{
-            "",
-            TokenType::Eof,
-            {line, column, std::make_shared<std::filesystem::path>(path)}};
-    }
+    static Token from(std::string_view text, Location location = {});
 };
 
-inline Token t(std::string_view text,
-               Token::Location location = {0, 0, nullptr}) {
-    return Token::from(text);
+inline Token t(std::string_view text, Token::Location location = {}) {
+    return Token::from(text, location);
 }
 
 inline std::ostream &operator<<(std::ostream &stream, const Token &token) {
@@ -161,7 +185,4 @@ inline std::ostream &operator<<(std::ostream &stream, const Token &token) {
     return stream;
 }
 
-std::string_view tokenTypeToName(TokenType);
-TokenType tokenNameToType(std::string_view, std::string_view text);
-
 inline auto eofToken = Token{"", TokenType::Eof};
@@ -0,0 +1,71 @@
+#pragma once
+
+#include "parsererror.h"
+#include "tokeniterator.h"
+#include <vector>
+
+/// Error from reading tokens in advance, at the position in the stream where it
+/// was found
+struct TokenError {
+    /// Number of tokens before the error
+    size_t index = 0;
+    ParserError error;
+};
+
+/// Token stream over tokens that are already read, for example by the parallel
+/// tokenizer. Returns Eof tokens when the end is reached. Errors are thrown
+/// when the stream reaches them, like a tokenizer throws them while reading
+struct TokenBuffer final : public TokenIterator {
+    TokenBuffer(std::vector<Token> tokens,
+                Token eof,
+                std::vector<TokenError> errors = {})
+        : _tokens{std::move(tokens)}
+        , _eof{std::move(eof)}
+        , _errors{std::move(errors)} {
+        _eof.type = TokenType::Eof;
+    }
+
+    Token pop(TokenType expectedType = TokenType::Any) override {
+        auto token = get(_index);
+        consume();
+        expect(token, expectedType);
+        return token;
+    }
+
+    const Token &current(TokenType expectedType = TokenType::Any) override {
+        auto &token = get(_index);
+        expect(token, expectedType);
+        return token;
+    }
+
+    const Token &next(TokenType expectedType = TokenType::Any) override {
+        auto &token = get(_index + 1);
+        expect(token, expectedType);
+        return token;
+    }
+
+    void consume() override {
+        if (_index < _tokens.size()) {
+            ++_index;
+        }
+    }
+
+    const std::vector<Token> &tokens() const {
+        return _tokens;
+    }
+
+private:
+    const Token &get(size_t index) {
+        if (_nextError < _errors.size() && index >= _errors[_nextError].index) {
+            throw std::move(_errors[_nextError++].error);
+        }
+        return index < _tokens.size() ? _tokens[index] : _eof;
+    }
+
+    std::vector<Token> _tokens;
+    Token _eof;
+    size_t _index = 0;
+
+    std::vector<TokenError> _errors;
+    size_t _nextError = 0;
+};
@@ -1,4 +1,5 @@
 #include "token.h"
+#include <concepts>
 
 #pragma once
 
@@ -16,3 +17,13 @@ public:
     virtual const Token &next(TokenType expectedType = TokenType::Any) = 0;
     virtual void consume() = 0;
 };
+
+/// Anything that can be used as a token source for the parser. Either a
+/// `TokenIterator` or a concrete stream type
+template <typename T>
+concept TokenStream = requires(T &it, TokenType type) {
+    { it.pop(type) } -> std::same_as<Token>;
+    { it.current(type) } -> std::same_as<const Token &>;
+    { it.next(type) } -> std::same_as<const Token &>;
+    it.consume();
+};
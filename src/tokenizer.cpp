@@ -1,68 +1,13 @@
 
 #include "tokenizer.h"
 #include "token.h"
-#include <unordered_map>
+#include "tokentable.h"
 
 namespace {
 
-std::string convertTypeName(std::string_view name) {
-    if (name == "Text") {
-        return "identifier";
-    }
-
-    auto ret = std::string{};
+using CurrentType = charscan::CharClass;
 
-    ret += std::tolower(name.front());
-    name.remove_prefix(1);
-
-    for (auto c : name) {
-        if (c > 'A' && c <= 'Z') {
-            ret += '_';
-            ret += std::tolower(c);
-        }
-        else {
-            ret += c;
-        }
-    }
-
-    return ret;
-}
-
-#define ITEM(x)
-#define KEYWORD(x) {convertTypeName(#x), TokenType::x},
-#define OP(x, y) {y, TokenType::x},
-#define BOP(x, y, z) {y, TokenType::x},
-
-auto tokenizerMap = std::unordered_map<std::string, TokenType>{TYPE_LIST};
-
-#undef ITEM
-#undef OP
-#undef BOP
-#undef KEYWORD
-
-enum class CurrentType {
-    Space,
-    Alpha,
-    Number,
-    Quote,
-    Operator,
-};
-
-auto TokenizerGetType = [](char c) {
-    if (std::isalpha(c) || c == '_') {
-        return CurrentType::Alpha;
-    }
-    if (std::isdigit(c)) {
-        return CurrentType::Number;
-    }
-    if (std::isspace(c)) {
-        return CurrentType::Space;
-    }
-    if (c == '"') {
-        return CurrentType::Quote;
-    }
-    return CurrentType::Operator;
-};
+constexpr auto TokenizerGetType = charscan::classOf;
 
 } // namespace
 
@@ -79,12 +24,17 @@ Token Tokenizer::from(std::string_view str, Token::Location location) {
         token.type = TokenType::StringLiteral;
         return token;
     }
-    if (auto f = tokenizerMap.find(token.text); f != tokenizerMap.end()) {
-        token.type = f->second;
+    if (auto type = tokentable::findType(str); type != TokenType::Unknown) {
+        token.type = type;
+        if (firstType == CurrentType::Alpha) {
+            // Makes it possible to use keywords like `this` as names
+            token.symbol = Symbol{str};
+        }
         return token;
     }
     if (firstType == CurrentType::Alpha) {
         token.type = TokenType::Text;
+        token.symbol = Symbol{str};
         return token;
     }
     if (firstType == CurrentType::Number) {
@@ -92,138 +42,117 @@ Token Tokenizer::from(std::string_view str, Token::Location location) {
         return token;
     }
 
-    if (auto f = tokenizerMap.find(std::string{str}); f != tokenizerMap.end()) {
-        token.text = str;
-        token.type = f->second;
-    }
-
     return token;
 }
 
+void Tokenizer::skipSpace() {
+    auto begin = _data.data();
+    auto end = begin + _data.size();
+    for (;;) {
+        _index = _scanner.skipSpace(begin + _index, end) - begin;
+        if (currentChar() == '/' && nextChar() == '/') {
+            // Comments, the newline is handled as a space
+            _index = _scanner.find(begin + _index, end, '\n') - begin;
+            continue;
+        }
+        break;
+    }
+}
+
 void Tokenizer::readOneToken() {
+    skipSpace();
 
     auto &token = _outBuffer.emplace_back();
-    token.location.path = _path;
-    token.location.line = _currentLine;
-    token.location.column = _index + 1;
+    token.location = {_file, static_cast<uint32_t>(_index)};
 
-    auto currentC = currentChar();
-
-    if (currentC == '\0') {
+    if (_index >= _data.size()) {
         token.type = TokenType::Eof;
-        _outBuffer.emplace_back().type = TokenType::Eof;
         return;
     }
 
-    auto type = TokenizerGetType(currentC);
-
-    auto finalize = [&] {
-        if (type == CurrentType::Quote) {
-            token.type = TokenType::StringLiteral;
-            return;
+    auto begin = _data.data();
+    auto end = begin + _data.size();
+    auto start = _index;
+
+    switch (TokenizerGetType(currentChar())) {
+    case CurrentType::Space:
+        break;
+    case CurrentType::Alpha:
+        _index = _scanner.skipIdentifier(begin + start, end) - begin;
+        token.text = TokenText::view(_data.substr(start, _index - start));
+        token.type = tokentable::findType(token.text);
+        if (token.type == TokenType::Unknown) {
+            token.type = TokenType::Text;
+            token.symbol = Symbol{token.text};
         }
-        if (auto f = tokenizerMap.find(token.text); f != tokenizerMap.end()) {
-            token.type = f->second;
-            return;
+        return;
+    case CurrentType::Number: {
+        _index = _scanner.skipNumber(begin + start, end) - begin;
+        auto str = _data.substr(start, _index - start);
+        if (str.find('\'') != std::string_view::npos) {
+            // Digit separators is the only case where the text is rewritten
+            auto text = std::string{};
+            for (auto c : str) {
+                if (c != '\'') {
+                    text += c;
+                }
+            }
+            token.text = std::move(text);
         }
-        if (type == CurrentType::Alpha) {
-            token.type = TokenType::Text;
-            return;
+        else {
+            token.text = TokenText::view(str);
+        }
+        token.type = TokenType::NumericConstant;
+        return;
+    }
+    case CurrentType::Quote: {
+        auto quote = _scanner.find(begin + start + 1, end, '"');
+        if (quote == end) {
+            token.text = TokenText::view(_data.substr(start, 1));
+            auto error = ParserError{token, "unterminated string literal"};
+            // The rest of the file is part of the string, so the stream ends
+            // here. This lets a recovering parser continue to the end
+            token.type = TokenType::Eof;
+            _index = _data.size();
+            throw error;
         }
-        if (type == CurrentType::Number) {
-            token.type = TokenType::NumericConstant;
+        _index = quote + 1 - begin;
+        token.text = TokenText::view(_data.substr(start, _index - start));
+        token.type = TokenType::StringLiteral;
+        return;
+    }
+    case CurrentType::Operator:
+        if (auto match = tokentable::matchOperator(_data.substr(start));
+            match.length) {
+            _index += match.length;
+            token.text = TokenText::view(_data.substr(start, match.length));
+            token.type = match.type;
             return;
         }
+        consumeChar();
+        token.text = TokenText::view(_data.substr(start, 1));
+        token.type = TokenType::Unknown;
+        return;
+    }
+}
 
-        // Operators
-
-        auto copy = token; // Since `token` is a reference
-        _outBuffer.pop_back();
-
-        for (bool repeat = true; repeat;) {
-            repeat = false;
-            for (size_t i = copy.text.size(); i > 0; --i) {
-                auto str = copy.text.substr(0, i);
-                if (auto f = tokenizerMap.find(str); f != tokenizerMap.end()) {
-                    auto &ntoken = _outBuffer.emplace_back(copy);
-                    ntoken.text = str;
-                    ntoken.type = f->second;
-                    repeat = true;
-                    copy.text = copy.text.substr(i);
-                    copy.location.column += i;
-                    break;
-                }
-            }
+std::vector<Token> Tokenizer::readAll(std::vector<TokenError> *errors) {
+    auto tokens = std::vector<Token>{};
+    for (;;) {
+        try {
+            fill(1);
         }
-    };
-
-    for (char c; (c = currentChar()) != '\0'; consumeChar()) {
-        auto nextType = TokenizerGetType(c);
-        switch (type) {
-        case CurrentType::Space:
-            if (nextType != CurrentType::Space) {
-                token.text += c;
-                token.location.column = _index;
-                type = nextType;
-            }
-            break;
-        case CurrentType::Alpha:
-            if (nextType == CurrentType::Alpha ||
-                nextType == CurrentType::Number) {
-                token.text += c;
+        catch (ParserError &error) {
+            if (!errors) {
+                throw;
             }
-            else {
-                finalize();
-                return;
-            }
-            break;
-        case CurrentType::Number:
-            if (nextType == CurrentType::Number) {
-                token.text += c;
-            }
-            else if (nextType == CurrentType::Operator && c == '.') {
-                token.text += c;
-            }
-            else if (c == '\'') {
-            }
-            else {
-                finalize();
-                return;
-            }
-            break;
-        case CurrentType::Quote:
-            token.text += c;
-            if (token.text.size() > 1 && nextType == CurrentType::Quote) {
-                consumeChar();
-                finalize();
-                return;
-            }
-            break;
-        case CurrentType::Operator:
-            if (nextType == CurrentType::Operator) {
-                token.text += c;
-
-                if (token.text == "//") {
-                    // Comments
-                    // TODO: If needed handle for example cases like "+//"
-                    // TODO: Fix comments at start of line
-                    _inBuffer = {};
-                    token.text = {};
-                    type = CurrentType::Space;
-                    continue;
-                }
-            }
-            else {
-                finalize();
-                return;
-            }
-            break;
+            errors->push_back({tokens.size(), std::move(error)});
+            continue;
         }
+        if (_outBuffer.front().type == TokenType::Eof) {
+            return tokens;
+        }
+        tokens.push_back(std::move(_outBuffer.front()));
+        _outBuffer.pop_front();
     }
-
-    if (token.text.empty()) {
-        token.type = TokenType::Eof;
-        return;
-    }
-    finalize();
 }
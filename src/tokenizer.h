@@ -1,100 +1,124 @@
 #pragma once
 
-#include "matperf/profiler.h"
+#include "charscan.h"
 #include "parsererror.h"
+#include "ringbuffer.h"
+#include "sourcebuffer.h"
+#include "sourcefiles.h"
+#include "tokenbuffer.h"
 #include "tokeniterator.h"
 
 #include <filesystem>
-#include <fstream>
 #include <istream>
 #include <string_view>
 #include <vector>
 
-struct Tokenizer : public TokenIterator {
+/// Reads tokens from a source buffer that is kept in memory as a whole. Token
+/// text is a view into the buffer. The buffer is registered in `sourcefiles`,
+/// which keeps it alive for the tokens
+struct Tokenizer final : public TokenIterator {
+    /// Read the whole stream into memory, used for stdin
     Tokenizer(std::istream &in, std::filesystem::path path)
-        : _in{std::shared_ptr<std::istream>(&in, [](auto) {})}
-        , _path{std::make_shared<std::filesystem::path>(path)} {}
+        : Tokenizer{SourceBuffer::read(in), path} {}
 
+    /// Memory map the file
     Tokenizer(std::filesystem::path path)
-        : _in{std::make_unique<std::ifstream>(path)}
-        , _path{std::make_shared<std::filesystem::path>(path)} {
-        if (!_in->good()) {
-            throw std::runtime_error{"could not open module " + path.string()};
-        }
-    }
-
-    Token pop(TokenType expectedType) override {
-        PROFILE_FUNCTION();
-        while (_outBuffer.empty()) {
-            readOneToken();
-        }
+        : Tokenizer{SourceBuffer::map(path), path} {}
+
+    /// Tokenize memory owned by the caller
+    Tokenizer(std::string_view buffer, std::filesystem::path path)
+        : Tokenizer{SourceBuffer::borrow(buffer), path} {}
+
+    Tokenizer(std::shared_ptr<const SourceBuffer> source,
+              std::filesystem::path path)
+        : _source{std::move(source)}
+        , _file{sourcefiles::add(path, _source)}
+        , _data{_source->view()} {}
+
+    /// Only tokenize [begin, end) of a file that is already registered
+    Tokenizer(sourcefiles::FileId file, size_t begin, size_t end)
+        : _source{sourcefiles::buffer(file)}
+        , _file{file}
+        , _data{_source->view().substr(0, end)}
+        , _index{begin} {}
+
+    // The accessors are called for every token, so they are kept small.
+    // Since the class is final, calls through a `Tokenizer &` (as in the
+    // templated parse functions) are statically dispatched
+    Token pop(TokenType expectedType = TokenType::Any) override {
+        fill(1);
         auto token = std::move(_outBuffer.front());
-        consume();
+        _outBuffer.pop_front();
         expect(token, expectedType);
         return token;
     }
 
-    const Token &current(TokenType expectedType) override {
-        PROFILE_FUNCTION();
-        while (_outBuffer.empty()) {
-            readOneToken();
-        }
-        expect(_outBuffer.front(), expectedType);
-        return _outBuffer.front();
+    const Token &current(TokenType expectedType = TokenType::Any) override {
+        fill(1);
+        auto &token = _outBuffer.front();
+        expect(token, expectedType);
+        return token;
     }
 
-    const Token &next(TokenType expectedType) override {
-        PROFILE_FUNCTION();
-        while (_outBuffer.size() < 2) {
-            readOneToken();
-        }
-        auto &token = _outBuffer.at(1);
+    const Token &next(TokenType expectedType = TokenType::Any) override {
+        fill(2);
+        auto &token = _outBuffer[1];
         expect(token, expectedType);
         return token;
     }
 
     void consume() override {
-        PROFILE_FUNCTION();
         if (_outBuffer.empty()) {
             throw std::runtime_error{"cannot erase without token"};
         }
-        _outBuffer.erase(_outBuffer.begin());
+        _outBuffer.pop_front();
+    }
+
+    const SourceBuffer &source() const {
+        return *_source;
+    }
+
+    /// Read all remaining tokens, not including the final Eof. Errors are added
+    /// to `errors` and reading continues after the bad text. Without `errors`
+    /// the first error is thrown
+    std::vector<Token> readAll(std::vector<TokenError> *errors = nullptr);
+
+    sourcefiles::FileId file() const {
+        return _file;
     }
 
     static Token from(std::string_view, Token::Location location);
 
 private:
-    std::shared_ptr<std::istream> _in;
-    std::shared_ptr<std::filesystem::path> _path;
+    std::shared_ptr<const SourceBuffer> _source;
+    sourcefiles::FileId _file = 0;
 
-    std::string _inBuffer;
-    size_t _index = 0;
-    size_t _currentLine = 0;
+    const charscan::Scanner &_scanner = charscan::scanner();
 
-    std::vector<Token> _outBuffer;
+    std::string_view _data;
+    size_t _index = 0;
 
-    void readOneToken();
+    /// Lookahead. The parser never looks further than `next()`
+    RingBuffer<Token, 4> _outBuffer;
 
-    void readLine() {
-        _index = 0;
-        ++_currentLine;
-        if (!std::getline(*_in, _inBuffer)) {
-            _inBuffer.assign(2, '\0');
+    void fill(size_t count) {
+        while (_outBuffer.size() < count) {
+            readOneToken();
         }
     }
 
-    char currentChar() {
-        while (_index >= _inBuffer.size()) {
-            readLine();
-        }
-        return _inBuffer.at(_index);
+    /// Reads exactly one token into `_outBuffer`
+    void readOneToken();
+
+    /// Skip spaces and comments
+    void skipSpace();
+
+    char currentChar() const {
+        return _index < _data.size() ? _data[_index] : '\0';
     }
 
-    char nextChar() {
-        while (2 + _index >= _inBuffer.size()) {
-            readLine();
-        }
-        return _inBuffer.at(1);
+    char nextChar() const {
+        return _index + 1 < _data.size() ? _data[_index + 1] : '\0';
     }
 
     void consumeChar() {
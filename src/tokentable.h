@@ -0,0 +1,310 @@
+#pragma once
+
+#include "log.h"
+#include "tokentype.h"
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <string_view>
+
+// Lookup tables for token types. Everything here is generated at compile time
+// from TYPE_LIST, so no tables are built at static initialization and no
+// strings are allocated when classifying tokens
+
+namespace tokentable {
+
+/// Fixed size storage for a generated name
+struct TypeName {
+    std::array<char, 24> data = {};
+    size_t size = 0;
+
+    constexpr std::string_view view() const {
+        return {data.data(), size};
+    }
+
+    constexpr void push_back(char c) {
+        if (size >= data.size()) {
+            throw std::length_error{"token type name is too long"};
+        }
+        data[size++] = c;
+    }
+};
+
+constexpr char toLower(char c) {
+    return (c >= 'A' && c <= 'Z') ? static_cast<char>(c - 'A' + 'a') : c;
+}
+
+/// Convert enum names like `LessEqual` to `less_equal`
+constexpr TypeName convertTypeName(std::string_view name) {
+    auto ret = TypeName{};
+
+    if (name == "Text") {
+        for (auto c : std::string_view{"identifier"}) {
+            ret.push_back(c);
+        }
+        return ret;
+    }
+
+    ret.push_back(toLower(name.front()));
+    name.remove_prefix(1);
+
+    for (auto c : name) {
+        if (c > 'A' && c <= 'Z') {
+            ret.push_back('_');
+            ret.push_back(toLower(c));
+        }
+        else {
+            ret.push_back(c);
+        }
+    }
+
+    return ret;
+}
+
+#define ITEM(x) convertTypeName(#x),
+#define KEYWORD(x) ITEM(x)
+#define OP(x, y) ITEM(x)
+#define BOP(x, y, z) ITEM(x)
+
+/// Names indexed by TokenType
+inline constexpr auto typeNames = std::to_array<TypeName>({TYPE_LIST});
+
+#undef ITEM
+#undef KEYWORD
+#undef OP
+#undef BOP
+
+struct TextEntry {
+    std::string_view text;
+    TokenType type;
+};
+
+#define ITEM(x)
+#define KEYWORD(x)                                                             \
+    {typeNames[static_cast<size_t>(TokenType::x)].view(), TokenType::x},
+#define OP(x, y) {y, TokenType::x},
+#define BOP(x, y, z) {y, TokenType::x},
+
+/// All texts that map directly to a token type: keywords and operators
+inline constexpr auto textEntries = std::to_array<TextEntry>({TYPE_LIST});
+
+#undef ITEM
+#undef KEYWORD
+#undef OP
+#undef BOP
+
+// ---- Perfect hash over textEntries ------------------------------------------
+
+constexpr uint32_t hashText(std::string_view text, uint32_t seed) {
+    auto h = 2166136261u ^ seed;
+    for (auto c : text) {
+        h ^= static_cast<uint8_t>(c);
+        h *= 16777619u;
+    }
+    h ^= h >> 15;
+    return h;
+}
+
+struct PerfectHash {
+    static constexpr size_t size = 1024;
+    static constexpr size_t mask = size - 1;
+
+    uint32_t seed = 0;
+    size_t maxLength = 0;
+
+    /// Index + 1 into textEntries, 0 means empty
+    std::array<uint8_t, size> slots = {};
+};
+
+constexpr PerfectHash buildPerfectHash() {
+    static_assert(textEntries.size() < 255);
+
+    for (uint32_t seed = 0; seed < 10'000; ++seed) {
+        auto hash = PerfectHash{.seed = seed};
+        bool collision = false;
+
+        for (size_t i = 0; i < textEntries.size(); ++i) {
+            auto text = textEntries[i].text;
+            auto &slot = hash.slots[hashText(text, seed) & PerfectHash::mask];
+            if (slot) {
+                collision = true;
+                break;
+            }
+            slot = static_cast<uint8_t>(i + 1);
+            hash.maxLength = std::max(hash.maxLength, text.size());
+        }
+
+        if (!collision) {
+            return hash;
+        }
+    }
+
+    throw std::logic_error{"could not find a perfect hash for token texts"};
+}
+
+inline constexpr auto perfectHash = buildPerfectHash();
+
+/// Find keyword or operator that matches the whole text, otherwise Unknown
+constexpr TokenType findType(std::string_view text) {
+    if (text.size() > perfectHash.maxLength) {
+        return TokenType::Unknown;
+    }
+    auto slot =
+        perfectHash.slots[hashText(text, perfectHash.seed) & PerfectHash::mask];
+    if (slot && textEntries[slot - 1].text == text) {
+        return textEntries[slot - 1].type;
+    }
+    return TokenType::Unknown;
+}
+
+// ---- Maximal munch state machine for operators ------------------------------
+
+struct OperatorMachine {
+    static constexpr size_t maxStates = 64;
+    static constexpr size_t maxClasses = 32;
+
+    /// Characters used in operators get a class > 0
+    std::array<uint8_t, 256> charClass = {};
+    size_t classCount = 1;
+
+    /// 0 means no transition. State 0 is the start state
+    std::array<std::array<uint8_t, maxClasses>, maxStates> next = {};
+    std::array<TokenType, maxStates> accept = {};
+    size_t stateCount = 1;
+};
+
+constexpr OperatorMachine buildOperatorMachine() {
+    auto machine = OperatorMachine{};
+
+    for (auto &accept : machine.accept) {
+        accept = TokenType::Unknown;
+    }
+
+    for (auto &entry : textEntries) {
+        auto first = entry.text.front();
+        if ((first >= 'a' && first <= 'z') || (first >= 'A' && first <= 'Z')) {
+            continue; // Keyword
+        }
+
+        size_t state = 0;
+        for (auto c : entry.text) {
+            auto &cls = machine.charClass[static_cast<uint8_t>(c)];
+            if (!cls) {
+                if (machine.classCount >= OperatorMachine::maxClasses) {
+                    throw std::length_error{"too many operator characters"};
+                }
+                cls = static_cast<uint8_t>(machine.classCount++);
+            }
+
+            auto &next = machine.next[state][cls];
+            if (!next) {
+                if (machine.stateCount >= OperatorMachine::maxStates) {
+                    throw std::length_error{"too many operator states"};
+                }
+                next = static_cast<uint8_t>(machine.stateCount++);
+            }
+            state = next;
+        }
+
+        machine.accept[state] = entry.type;
+    }
+
+    return machine;
+}
+
+inline constexpr auto operatorMachine = buildOperatorMachine();
+
+struct OperatorMatch {
+    TokenType type = TokenType::Unknown;
+    size_t length = 0;
+};
+
+/// Longest operator at the start of text
+constexpr OperatorMatch matchOperator(std::string_view text) {
+    auto match = OperatorMatch{};
+    size_t state = 0;
+
+    for (size_t i = 0; i < text.size(); ++i) {
+        auto cls = operatorMachine.charClass[static_cast<uint8_t>(text[i])];
+        if (!cls) {
+            break;
+        }
+        state = operatorMachine.next[state][cls];
+        if (!state) {
+            break;
+        }
+        if (auto type = operatorMachine.accept[state];
+            type != TokenType::Unknown) {
+            match = {type, i + 1};
+        }
+    }
+
+    return match;
+}
+
+// ---- Binary operator precedence ---------------------------------------------
+
+#define ITEM(x) 0,
+#define KEYWORD(x) 0,
+#define OP(x, y) 0,
+#define BOP(x, y, z) z,
+
+/// Precedence indexed by TokenType. Lower binds tighter, 0 means that the token
+/// is not a binary operator
+inline constexpr auto precedences = std::to_array<int>({TYPE_LIST});
+
+#undef ITEM
+#undef KEYWORD
+#undef OP
+#undef BOP
+
+constexpr int precedence(TokenType type) {
+    return precedences[static_cast<size_t>(type)];
+}
+
+/// Assignments have the loosest precedence and group right to left
+inline constexpr int assignmentPrecedence = precedence(TokenType::Equal);
+
+static_assert(findType("let") == TokenType::Let);
+static_assert(findType("<=") == TokenType::LessEqual);
+static_assert(findType("letter") == TokenType::Unknown);
+static_assert(matchOperator("+=1").type == TokenType::PlusEqual);
+static_assert(matchOperator("<-x").length == 2);
+static_assert(matchOperator("+-").length == 1);
+static_assert(precedence(TokenType::Star) < precedence(TokenType::Plus));
+static_assert(precedence(TokenType::Comma) == 0);
+
+} // namespace tokentable
+
+constexpr std::string_view tokenTypeToName(TokenType type) {
+    return tokentable::typeNames.at(static_cast<size_t>(type)).view();
+}
+
+constexpr TokenType tokenNameToType(std::string_view name,
+                                    std::string_view text) {
+    if (text == "fn") {
+        return TokenType::Fn;
+    }
+    else if (text == "true") {
+        return TokenType::True;
+    }
+    else if (text == "false") {
+        return TokenType::False;
+    }
+    else if (text == "let") {
+        return TokenType::Let;
+    }
+
+    for (size_t i = 0; i < tokentable::typeNames.size(); ++i) {
+        if (tokentable::typeNames[i].view() == name) {
+            return static_cast<TokenType>(i);
+        }
+    }
+
+    if !consteval {
+        vlog("unknown token type ", name, " with text ", text);
+    }
+    return TokenType::Unknown;
+}
@@ -0,0 +1,83 @@
+#pragma once
+
+/// Any is not a type but a selector that can be used to select any of the
+/// others Unknown is when the tokenizer cannot tell what type it is
+// clang-format off
+#define TYPE_LIST \
+KEYWORD(Fn)\
+    KEYWORD(Pub)\
+    KEYWORD(Impl)\
+    KEYWORD(True)\
+    KEYWORD(False)\
+    KEYWORD(Let)\
+    KEYWORD(Mut)\
+    \
+    ITEM(Text)\
+    KEYWORD(Struct)\
+    KEYWORD(Operator)\
+    KEYWORD(StringLiteral)\
+    KEYWORD(If)\
+    KEYWORD(Else)\
+    KEYWORD(Enum)\
+    KEYWORD(Int)\
+    KEYWORD(For)\
+    KEYWORD(Float)\
+    KEYWORD(Double)\
+    KEYWORD(I8)\
+    KEYWORD(I16)\
+    KEYWORD(I32)\
+    KEYWORD(I64)\
+    KEYWORD(Bool)\
+    KEYWORD(This)\
+    KEYWORD(Const)\
+    KEYWORD(Match)\
+    BOP(Period, ".", 2)\
+    BOP(Star, "*", 5)\
+    BOP(Slash, "/", 5)\
+    BOP(Percent, "%", 5)\
+    BOP(Plus, "+", 6)\
+    BOP(Minus, "-", 6)\
+    BOP(Less, "<", 9)\
+    BOP(LessEqual, "<=", 9)\
+    BOP(Greater, ">", 9)\
+    BOP(GreaterEqual, ">=", 9)\
+    BOP(EqualEqual, "==", 10)\
+    BOP(ExclaimEqual, "!=", 10)\
+    BOP(Amp, "&", 11)\
+    BOP(Equal, "=", 16)\
+    BOP(LeftArrow, "<-", 16)\
+    BOP(PlusEqual, "+=", 16)\
+    BOP(MinusEqual, "-=", 16)\
+    BOP(StarEqual, "*=", 16)\
+    BOP(SlashEqual, "/=", 16)\
+    BOP(PercentEqual, "%=", 16)\
+    OP(Comma, ",")\
+    OP(PlusPlus, "++")\
+    OP(Colon, ":")\
+    OP(Semi, ";")\
+    OP(LParen, "(")\
+    OP(RParen, ")")\
+    OP(LBrace, "{")\
+    OP(RBrace, "}")\
+    OP(LSquare, "[")\
+    OP(RSquare, "]")\
+    OP(Arrow, "->")\
+    OP(Exclaim, "!")\
+    OP(At, "@")\
+    ITEM(NumericConstant)\
+    KEYWORD(Return)\
+    ITEM(Any)\
+    ITEM(Unknown)\
+    ITEM(Eof) // clang-format on
+
+#define KEYWORD(x) x,
+#define ITEM(x) x,
+#define OP(x, y) x,
+#define BOP(x, y, z) x,
+
+enum class TokenType { TYPE_LIST };
+
+#undef ITEM
+#undef KEYWORD
+#undef OP
+#undef BOP
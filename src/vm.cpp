@@ -1,179 +1,807 @@
 #include "vm.h"
+#include "algorithms.h"
+#include "commands.h"
+#include "dictionary.h"
+#include "nativebinding.h"
+#include "scriptprofiler.h"
+#include <algorithm>
+#include <cmath>
 #include <fstream>
 #include <iostream>
 #include <memory>
+#include <optional>
 #include <ranges>
 #include <stdexcept>
 #include <string>
-#include <variant>
 
 namespace vm {
 
 namespace {
 
-struct File : public OtherValueContent {
+struct File final : public OtherValueContent {
+    static constexpr auto objectType = ObjectType::File;
+
     std::ifstream file;
 };
 
-Value FileNext(Context &context) {
-    auto &self = context.closure->at<Map>(t("this"));
-    auto &file = self.at<File>(t("file"));
+void addFileStuff(Map &std) {
+    bind(std, symbols::Open, [](const String &path) {
+        std::cout << "opening file " << path.value << std::endl;
+
+        auto file = make<File>();
+        file->file.open(path.value);
 
-    std::string line;
-    if (std::getline(file.file, line)) {
-        return String{line};
-    }
-    return Bool{};
+        auto map = make<Map>();
+
+        (*map)[symbols::File] = file;
+
+        // Loops read the lines from the file directly
+        bind(*map, symbols::Lines, [](Context &context) {
+            return context.self().as<Map>().at(symbols::File);
+        });
+
+        return map;
+    });
 }
 
-void addFileStuff(Map &std) {
-    auto fileType = std::make_shared<Map>();
+Ref<Map> createStd() {
+    auto std = make<Map>();
+
+    bind(
+        *std,
+        symbols::Abs,
+        [](Float value) { return Float{std::abs(value.value)}; },
+        [](Int value) { return Int{std::abs(value.value)}; });
+
+    bind(
+        *std,
+        symbols::Range,
+        [](Int begin, Int end) { return make<Range>(begin.value, end.value); },
+        [](Int end) { return make<Range>(0, end.value); });
+
+    bind(
+        *std,
+        symbols::Println,
+        [](Float value) { std::cout << value.value << std::endl; },
+        [](Int value) { std::cout << value.value << std::endl; },
+        [](const String &value) { std::cout << value.value << std::endl; });
+
+    bind(
+        *std,
+        symbols::Help,
+        [](Float) { std::cout << "[Float]" << std::endl; },
+        [](Int) { std::cout << "[Int]" << std::endl; },
+        [](const String &) { std::cout << "[String]" << std::endl; },
+        [](Map &map) {
+            std::cout << "[Map]{\n";
+            for (auto name : map.shape->names()) {
+                std::cout << "  " << name << "\n";
+            }
+            std::cout << "}\n";
+        },
+        [](Function &) { std::cout << "[function]\n"; });
 
-    (*fileType)[t("lines")] = std::make_shared<Function>(
-        std::vector{t("path")},
-        [](Context &context) -> Value { return Value{}; });
+    addFileStuff(*std);
 
-    std[t("File")] = std::move(fileType);
+    return std;
+}
 
-    std[t("open")] = std::make_shared<Function>(
-        std::vector{t("path")}, [](Context &context) -> Value {
-            auto &path = context.closure->at<String>(t("value"));
+std::runtime_error invalidOperands(TokenType op) {
+    return std::runtime_error{"invalid operands to " +
+                              std::string{tokenTypeToName(op)}};
+}
 
-            std::cout << "opening file " << path.value << std::endl;
+template <typename T>
+std::optional<Value> compare(TokenType op, const T &a, const T &b) {
+    switch (op) {
+    case TokenType::Less:
+        return Bool{a < b};
+    case TokenType::LessEqual:
+        return Bool{a <= b};
+    case TokenType::Greater:
+        return Bool{a > b};
+    case TokenType::GreaterEqual:
+        return Bool{a >= b};
+    case TokenType::EqualEqual:
+        return Bool{a == b};
+    case TokenType::ExclaimEqual:
+        return Bool{a != b};
+    default:
+        return std::nullopt;
+    }
+}
 
-            auto file = std::make_shared<File>();
-            file->file.open(path.value);
+Value intOperation(TokenType op, int64_t a, int64_t b) {
+    switch (op) {
+    case TokenType::Star:
+        return Int{a * b};
+    case TokenType::Slash:
+    case TokenType::Percent:
+        if (b == 0) {
+            throw std::runtime_error{"division by zero"};
+        }
+        return Int{op == TokenType::Slash ? a / b : a % b};
+    case TokenType::Plus:
+        return Int{a + b};
+    case TokenType::Minus:
+        return Int{a - b};
+    case TokenType::Amp:
+        return Int{a & b};
+    default:
+        if (auto result = compare(op, a, b)) {
+            return *result;
+        }
+        throw invalidOperands(op);
+    }
+}
 
-            auto map = std::make_shared<Map>();
+Value floatOperation(TokenType op, double a, double b) {
+    switch (op) {
+    case TokenType::Star:
+        return Float{a * b};
+    case TokenType::Slash:
+        return Float{a / b};
+    case TokenType::Percent:
+        return Float{std::fmod(a, b)};
+    case TokenType::Plus:
+        return Float{a + b};
+    case TokenType::Minus:
+        return Float{a - b};
+    default:
+        if (auto result = compare(op, a, b)) {
+            return *result;
+        }
+        throw invalidOperands(op);
+    }
+}
 
-            (*map)[t("file")] = file;
+Value stringOperation(TokenType op,
+                      const std::string &a,
+                      const std::string &b) {
+    if (op == TokenType::Plus) {
+        return String{a + b};
+    }
+    if (auto result = compare(op, a, b)) {
+        return *result;
+    }
+    throw invalidOperands(op);
+}
 
-            return map;
-        });
+/// Int, Float and Bool can be mixed and are then calculated as floats
+std::optional<double> toFloat(const Value &value) {
+    if (value.is<Int>()) {
+        return static_cast<double>(value.as<Int>().value);
+    }
+    if (value.is<Float>()) {
+        return value.as<Float>().value;
+    }
+    if (value.is<Bool>()) {
+        return value.as<Bool>().value ? 1. : 0.;
+    }
+    return std::nullopt;
 }
 
-std::shared_ptr<Map> createStd() {
-    auto std = std::make_shared<Map>();
+} // namespace
 
-    (*std)[t("abs")] = std::make_shared<Function>(
-        std::vector{t("value")}, [](Context &context) -> Value {
-            auto &value = context.closure->at(t("value"));
-            if (std::holds_alternative<Float>(value.value)) {
-                return Float{std::abs(value.as<Float>().value)};
-            }
-            else if (std::holds_alternative<Int>(value.value)) {
-                return Int{std::abs(value.as<Int>().value)};
-            }
-            throw std::runtime_error{"could not run abs on this"};
-        });
+Ref<Map> createModule(const Section *body) {
+    auto map = make<Map>();
+
+    auto mainFunction = make<Function>();
+
+    mainFunction->name = symbols::Main;
+    mainFunction->body = body;
+    mainFunction->module = true;
+
+    (*map)[symbols::Main] = mainFunction;
+
+    for (auto command : body->commands) {
+        if (command->kind() == NodeKind::FunctionDeclaration) {
+            auto &declaration = static_cast<FunctionDeclaration &>(*command);
+            auto function = make<Function>();
+            function->name = declaration.name;
+            function->argumentNames.assign(declaration.arguments.begin(),
+                                           declaration.arguments.end());
+            function->argumentCount =
+                static_cast<uint32_t>(declaration.arguments.size());
+            function->body = declaration.body;
+            (*map)[declaration.name] = function;
+        }
+    }
 
-    (*std)[t("println")] = std::make_shared<Function>(
-        std::vector{t("value")}, [](Context &context) {
-            auto &value = context.closure->at(t("value"));
-            if (value.is<Float>()) {
-                std::cout << value.as<Float>().value << std::endl;
-                return Value{};
-            }
-            else if (value.is<Int>()) {
-                std::cout << value.as<Int>().value << std::endl;
-                return Value{};
-            }
-            else if (value.is<String>()) {
-                std::cout << value.as<String>().value << std::endl;
-                return Value{};
-            }
+    return map;
+}
 
-            throw std::runtime_error{"could not run print on this"};
-        });
+Value binaryOperation(TokenType op, const Value &left, const Value &right) {
+    if (left.is<Int>() && right.is<Int>()) {
+        return intOperation(op, left.as<Int>().value, right.as<Int>().value);
+    }
 
-    (*std)[t("help")] = std::make_shared<Function>(
-        std::vector{t("value")}, [](Context &context) -> Value {
-            auto &value = context.closure->at(t("value"));
-            if (value.is<Float>()) {
-                std::cout << "[Float]" << std::endl;
-                return {};
-            }
-            else if (value.is<Int>()) {
-                std::cout << "[Int]" << std::endl;
-                return {};
-            }
-            else if (value.is<String>()) {
-                std::cout << "[String]" << std::endl;
-                return {};
-            }
-            else if (value.is<Map>()) {
-                auto &v = value.as<Map>();
-
-                std::cout << "[Map]{\n";
-                for (auto &v : v.values) {
-                    std::cout << "  " << v.name << "\n";
-                }
-                std::cout << "}\n";
-                return {};
-            }
-            else if (value.is<Function>()) {
-                auto &v = value.as<Function>();
-                std::cout << "[function]\n";
-                return {};
-            }
+    if (left.is<Float>() && right.is<Float>()) {
+        return floatOperation(
+            op, left.as<Float>().value, right.as<Float>().value);
+    }
 
-            throw std::runtime_error{"no help for this expression"};
-        });
+    if (left.is<String>() && right.is<String>()) {
+        return stringOperation(
+            op, left.as<String>().value, right.as<String>().value);
+    }
 
-    addFileStuff(*std);
+    auto lf = toFloat(left);
+    auto rf = toFloat(right);
+    if (lf && rf) {
+        return floatOperation(op, *lf, *rf);
+    }
 
-    return std;
+    throw invalidOperands(op);
 }
+
+bool same(const Value &a, const Value &b) {
+    if (a.is<Int>() && b.is<Int>()) {
+        return a.as<Int>().value == b.as<Int>().value;
+    }
+    if (a.is<Float>() && b.is<Float>()) {
+        return a.as<Float>().value == b.as<Float>().value;
+    }
+    if (a.is<String>() && b.is<String>()) {
+        return a.as<String>().value == b.as<String>().value;
+    }
+    if (a.is<Bool>() && b.is<Bool>()) {
+        return a.as<Bool>().value == b.as<Bool>().value;
+    }
+    if (auto object = a.object()) {
+        return object == b.object();
+    }
+    return a.is<Void>() && b.is<Void>();
+}
+
+Value unaryOperation(TokenType op, Value value) {
+    switch (op) {
+    case TokenType::Minus:
+        if (value.is<Int>()) {
+            return Int{-value.as<Int>().value};
+        }
+        if (value.is<Float>()) {
+            return Float{-value.as<Float>().value};
+        }
+        break;
+    case TokenType::Exclaim:
+        return Bool{!value.asBool()};
+    default:
+        break;
+    }
+    throw invalidOperands(op);
+}
+
+namespace {
+
+/// Names of the built in types followed by the registered ones
+std::vector<std::string> &objectTypeNames() {
+#define OBJECT_TYPE(x) #x,
+    static auto names = std::vector<std::string>{OBJECT_TYPE_LIST};
+#undef OBJECT_TYPE
+    return names;
+}
+
 } // namespace
 
-const std::shared_ptr<Map> &getStd() {
-    static auto module = createStd();
+ObjectType registerObjectType(std::string_view name) {
+    auto &names = objectTypeNames();
+    if (names.size() > UINT8_MAX) {
+        throw std::runtime_error{"too many object types registered"};
+    }
+    names.emplace_back(name);
+    return static_cast<ObjectType>(names.size() - 1);
+}
 
-    return module;
+std::string_view objectTypeName(ObjectType type) {
+    auto &names = objectTypeNames();
+    auto index = static_cast<size_t>(type);
+    return index < names.size() ? names[index] : "unknown";
 }
 
-Value call(const Function &f,
-           std::vector<Value> values,
-           Context &context,
-           Value self) {
-    auto closure = Map{};
+void destroy(OtherValueContent *object) {
+    switch (object->type) {
+#define OBJECT_TYPE(x)                                                         \
+    case ObjectType::x:                                                        \
+        delete static_cast<x *>(object);                                       \
+        return;
+        OBJECT_TYPE_LIST
+#undef OBJECT_TYPE
+    default:
+        delete object;
+    }
+}
 
-    closure[t("this")] = self;
+void Value::throwWrongType(ObjectType actual, ObjectType expected) {
+    throw std::runtime_error{"Cannot convert value to function " +
+                             std::string{objectTypeName(actual)} + " to " +
+                             std::string{objectTypeName(expected)}};
+}
 
-    auto newContext = Context{
-        .closure = &closure,
-        .parent = &context,
+namespace {
+
+/// Values for all frames of a thread. The values are kept in blocks that are
+/// never moved, so that frames stay valid when the stack grows
+class FrameStack {
+public:
+    std::span<Value> push(size_t size) {
+        if (_blocks.empty() ||
+            _blocks[_current].top + size > _blocks[_current].size) {
+            next(size);
+        }
+        auto &block = _blocks[_current];
+        auto slots = std::span{block.values.get() + block.top, size};
+        block.top += size;
+        return slots;
+    }
+
+    void pop(std::span<Value> slots) {
+        // Release the values now instead of when the slots are reused
+        std::ranges::fill(slots, Value{});
+        auto &block = _blocks[_current];
+        block.top -= slots.size();
+        if (block.top == 0 && _current > 0) {
+            --_current;
+        }
+    }
+
+private:
+    static constexpr size_t blockSize = 64 * 1024;
+
+    struct Block {
+        std::unique_ptr<Value[]> values;
+        size_t size = 0;
+        size_t top = 0;
     };
 
-    for (auto i : std::ranges::iota_view{
-             0uz, std::min(values.size(), f.argumentNames.size())}) {
-        closure[f.argumentNames.at(i)] = std::move(values.at(i));
+    /// Move to the next block that can fit `size` values
+    void next(size_t size) {
+        if (!_blocks.empty()) {
+            ++_current;
+        }
+        if (_current < _blocks.size() && _blocks[_current].size < size) {
+            _blocks.erase(_blocks.begin() + _current, _blocks.end());
+        }
+        if (_current == _blocks.size()) {
+            auto blockValues = std::max(size, blockSize);
+            _blocks.push_back({
+                .values = std::make_unique<Value[]>(blockValues),
+                .size = blockValues,
+            });
+        }
+    }
+
+    std::vector<Block> _blocks;
+    size_t _current = 0;
+};
+
+thread_local auto frameStack = FrameStack{};
+
+} // namespace
+
+Frame::Frame(size_t size) {
+    if (size) {
+        slots = frameStack.push(size);
+    }
+}
+
+Frame::~Frame() {
+    if (!slots.empty()) {
+        frameStack.pop(slots);
+    }
+}
+
+Shape *Shape::empty() {
+    static auto shape = Shape{};
+    return &shape;
+}
+
+Shape *Shape::withMember(Symbol name) {
+    auto &next = _transitions[name.id()];
+    if (!next) {
+        next.reset(new Shape{});
+        next->_names = _names;
+        next->_names.push_back(name);
     }
+    return next.get();
+}
+
+const Ref<Map> &getStd() {
+    static auto module = createStd();
+
+    return module;
+}
+
+Value call(const Function &f, Frame &frame, Context &context) {
+    auto profile = scriptprofiler::Call{f};
 
     if (f.native) {
+        auto newContext = Context{
+            .parent = &context,
+            .slots = frame.slots,
+        };
         return f.native(newContext);
     }
 
+    // Functions see the module, not the variables of the caller
+    auto returning = false;
+    auto newContext = Context{
+        .parent = f.module ? nullptr : &context.root(),
+        .slots = frame.slots,
+        .returning = &returning,
+    };
+    if (f.module) {
+        newContext.closure = context.root().closure;
+    }
+
     return call(*f.body, newContext);
 }
 
+Value call(const Function &f,
+           std::span<const Value> values,
+           Context &context,
+           Value self) {
+    auto frame = Frame{frameSize(f)};
+    frame.slots[0] = std::move(self);
+    auto count = std::min<size_t>(values.size(), f.argumentCount);
+    std::ranges::copy(values.first(count), frame.slots.begin() + 1);
+    if (auto engine = context.root().engine) {
+        return engine->call(f, frame, context);
+    }
+    return call(f, frame, context);
+}
+
 Value call(const Section &section, Context &context) {
     Value ret;
     for (auto &command : section.commands) {
+        if (scriptprofiler::enabled) {
+            scriptprofiler::statement(*command);
+        }
         ret = command->run(context);
+        if (context.returning && *context.returning) {
+            break;
+        }
     }
     return ret;
 }
 
-Value &Context::at(const Token &name) {
-    if (auto f = closure->find(name)) {
-        return *f;
+namespace {
+
+size_t checkedIndex(const Array &array, const Value &index) {
+    auto n = index.as<Int>().value;
+    if (n < 0 || static_cast<size_t>(n) >= array.size()) {
+        throw std::runtime_error{"index " + std::to_string(n) +
+                                 " is out of range"};
+    }
+    return static_cast<size_t>(n);
+}
+
+Array::Storage storageFor(const Value &value) {
+    if (value.is<Int>()) {
+        return Array::Storage::Int;
+    }
+    if (value.is<Float>()) {
+        return Array::Storage::Float;
+    }
+    if (value.is<String>()) {
+        return Array::Storage::String;
+    }
+    return Array::Storage::Values;
+}
+
+Array &thisArray(Context &context) {
+    return context.self().as<Array>();
+}
+
+Ref<Map> createArrayMembers() {
+    auto members = make<Map>();
+
+    bind(*members, symbols::Push, [](Context &context, Value value) {
+        thisArray(context).push(std::move(value));
+    });
+
+    bind(*members, symbols::Size, [](Context &context) {
+        return Int{static_cast<int64_t>(thisArray(context).size())};
+    });
+
+    bind(*members, symbols::Sort, [](Context &context) {
+        algorithms::sort(thisArray(context));
+    });
+
+    bind(*members, symbols::Sum, [](Context &context) {
+        return algorithms::sum(thisArray(context));
+    });
+
+    bind(*members, symbols::Min, [](Context &context) {
+        return algorithms::min(thisArray(context));
+    });
+
+    bind(*members, symbols::Max, [](Context &context) {
+        return algorithms::max(thisArray(context));
+    });
+
+    bind(*members, symbols::CountOf, [](Context &context, Value value) {
+        auto n = algorithms::count(thisArray(context), value);
+        return Int{static_cast<int64_t>(n)};
+    });
+
+    bind(*members, symbols::BinarySearch, [](Context &context, Value value) {
+        return Bool{algorithms::binarySearch(thisArray(context), value)};
+    });
+
+    bind(*members, symbols::Zip, [](Context &context, Array &other) {
+        return algorithms::zip(thisArray(context), other);
+    });
+
+    bind(*members, symbols::Map, [](Context &context, Function &f) {
+        return algorithms::map(thisArray(context), f, context);
+    });
+
+    return members;
+}
+
+Dictionary &thisDictionary(Context &context) {
+    return context.self().as<Dictionary>();
+}
+
+Ref<Map> createDictionaryMembers() {
+    auto members = make<Map>();
+
+    // Missing keys give void, unlike `dictionary[key]`
+    bind(*members, symbols::Get, [](Context &context, Value key) {
+        auto value = thisDictionary(context).find(key);
+        return value ? *value : Value{};
+    });
+
+    bind(*members, symbols::Set, [](Context &context, Value key, Value value) {
+        thisDictionary(context)[key] = std::move(value);
+    });
+
+    bind(*members, symbols::Contains, [](Context &context, Value key) {
+        return Bool{thisDictionary(context).find(key) != nullptr};
+    });
+
+    bind(
+        *members,
+        symbols::Increment,
+        [](Context &context, Value key, Int amount) {
+            return thisDictionary(context).increment(key, amount.value);
+        },
+        [](Context &context, Value key) {
+            return thisDictionary(context).increment(key);
+        });
+
+    bind(*members, symbols::Size, [](Context &context) {
+        return Int{static_cast<int64_t>(thisDictionary(context).size())};
+    });
+
+    bind(*members, symbols::Keys, [](Context &context) {
+        return thisDictionary(context).keys();
+    });
+
+    return members;
+}
+
+} // namespace
+
+void Array::set(size_t index, Value value) {
+    switch (_storage) {
+    case Storage::Int:
+        if (value.is<Int>()) {
+            _ints[index] = value.as<Int>().value;
+            return;
+        }
+        break;
+    case Storage::Float:
+        if (value.is<Float>()) {
+            _floats[index] = value.as<Float>().value;
+            return;
+        }
+        break;
+    case Storage::String:
+        // Strings of other lengths would move the rest of the buffer
+        if (value.is<String>()) {
+            auto &text = value.as<String>().value;
+            auto old = string(index);
+            if (text.size() == old.size()) {
+                auto offset = old.data() - _chars.data();
+                std::ranges::copy(text, _chars.begin() + offset);
+                return;
+            }
+        }
+        break;
+    default:
+        _values[index] = std::move(value);
+        return;
+    }
+
+    unpack();
+    _values[index] = std::move(value);
+}
+
+void Array::push(Value value) {
+    if (_storage == Storage::Empty) {
+        _storage = storageFor(value);
+    }
+
+    switch (_storage) {
+    case Storage::Int:
+        if (value.is<Int>()) {
+            _ints.push_back(value.as<Int>().value);
+            return;
+        }
+        break;
+    case Storage::Float:
+        if (value.is<Float>()) {
+            _floats.push_back(value.as<Float>().value);
+            return;
+        }
+        break;
+    case Storage::String:
+        if (value.is<String>()) {
+            auto &text = value.as<String>().value;
+            _chars.insert(_chars.end(), text.begin(), text.end());
+            _ints.push_back(static_cast<int64_t>(_chars.size()));
+            return;
+        }
+        break;
+    default:
+        _values.push_back(std::move(value));
+        return;
+    }
+
+    unpack();
+    _values.push_back(std::move(value));
+}
+
+void Array::permute(std::span<const size_t> order) {
+    auto reorder = [order](auto &items) {
+        auto reordered = std::remove_cvref_t<decltype(items)>{};
+        reordered.reserve(order.size());
+        for (auto i : order) {
+            reordered.push_back(std::move(items[i]));
+        }
+        items = std::move(reordered);
+    };
+
+    switch (_storage) {
+    case Storage::Empty:
+        return;
+    case Storage::Int:
+        reorder(_ints);
+        return;
+    case Storage::Float:
+        reorder(_floats);
+        return;
+    case Storage::String: {
+        auto chars = std::vector<char>{};
+        chars.reserve(_chars.size());
+        auto ends = std::vector<int64_t>{};
+        ends.reserve(order.size());
+        for (auto i : order) {
+            auto text = string(i);
+            chars.insert(chars.end(), text.begin(), text.end());
+            ends.push_back(static_cast<int64_t>(chars.size()));
+        }
+        _chars = std::move(chars);
+        _ints = std::move(ends);
+        return;
+    }
+    case Storage::Values:
+        reorder(_values);
+        return;
+    }
+}
+
+size_t Array::memory() const {
+    return _ints.capacity() * sizeof(int64_t) +
+           _floats.capacity() * sizeof(double) + _chars.capacity() +
+           _values.capacity() * sizeof(Value);
+}
+
+void Array::unpack() {
+    auto values = std::vector<Value>{};
+    values.reserve(size() + 1);
+    for (size_t i = 0; i < size(); ++i) {
+        values.push_back(at(i));
+    }
+
+    _ints = {};
+    _floats = {};
+    _chars = {};
+    _values = std::move(values);
+    _storage = Storage::Values;
+}
+
+Value element(const Value &array, const Value &index) {
+    if (array.is<Dictionary>()) {
+        return array.as<Dictionary>().at(index);
+    }
+    auto &a = array.as<Array>();
+    return a.at(checkedIndex(a, index));
+}
+
+void setElement(const Value &array, const Value &index, Value value) {
+    if (array.is<Dictionary>()) {
+        array.as<Dictionary>()[index] = std::move(value);
+        return;
+    }
+    auto &a = array.as<Array>();
+    a.set(checkedIndex(a, index), std::move(value));
+}
+
+Map &members(const Value &object) {
+    if (object.is<Array>()) {
+        static auto arrayMembers = createArrayMembers();
+        return *arrayMembers;
+    }
+    if (object.is<Dictionary>()) {
+        static auto dictionaryMembers = createDictionaryMembers();
+        return *dictionaryMembers;
+    }
+    return object.as<Map>();
+}
+
+Value iterator(const Value &range) {
+    if (range.is<Range>()) {
+        auto &r = range.as<Range>();
+        return make<Range>(r.begin, r.end);
+    }
+    if (range.is<Array>()) {
+        return make<ArrayIterator>(range);
+    }
+    return range;
+}
+
+bool advance(const Value &iterator, Value &value) {
+    auto object = iterator.object();
+    if (!object) {
+        throw std::runtime_error{"value is not iterable"};
+    }
+
+    switch (object->type) {
+    case ObjectType::Range: {
+        auto &range = static_cast<Range &>(*object);
+        if (range.begin >= range.end) {
+            return false;
+        }
+        value = Int{range.begin++};
+        return true;
+    }
+    case ObjectType::ArrayIterator: {
+        auto &position = static_cast<ArrayIterator &>(*object);
+        auto &array = position.array.as<Array>();
+        if (position.index >= array.size()) {
+            return false;
+        }
+        value = array.at(position.index++);
+        return true;
+    }
+    case ObjectType::File: {
+        auto line = std::string{};
+        if (!std::getline(static_cast<File &>(*object).file, line)) {
+            return false;
+        }
+        value = String{std::move(line)};
+        return true;
+    }
+    default:
+        throw std::runtime_error{"can not iterate over " +
+                                 std::string{objectTypeName(object->type)}};
+    }
+}
+
+Value &Context::at(Symbol name) {
+    if (closure) {
+        if (auto f = closure->find(name)) {
+            return *f;
+        }
     }
 
     if (parent) {
         return parent->at(name);
     }
 
-    throw std::runtime_error{"can not find " + name.text};
+    throw std::runtime_error{"can not find " + std::string{name.text()}};
 }
 } // namespace vm
@@ -1,16 +1,26 @@
 #pragma once
 
+#include "gc.h"
 #include "parsererror.h"
+#include "symbol.h"
 #include "token.h"
+#include <cstdint>
+#include <cstring>
+#include <functional>
 #include <memory>
+#include <span>
 #include <stdexcept>
 #include <string>
 #include <string_view>
 #include <type_traits>
-#include <typeinfo>
-#include <variant>
+#include <unordered_map>
+#include <utility>
 #include <vector>
 
+namespace bytecode {
+struct Chunk;
+} // namespace bytecode
+
 namespace vm {
 
 struct Vector {};
@@ -19,30 +29,174 @@ struct Variable {
     Token name;
 };
 
+// clang-format off
+#define OBJECT_TYPE_LIST \
+    OBJECT_TYPE(Map) \
+    OBJECT_TYPE(Function) \
+    OBJECT_TYPE(Array) \
+    OBJECT_TYPE(Dictionary) \
+    OBJECT_TYPE(StringObject) \
+    OBJECT_TYPE(IntObject) \
+    OBJECT_TYPE(File) \
+    OBJECT_TYPE(Range) \
+    OBJECT_TYPE(ArrayIterator) // clang-format on
+
+#define OBJECT_TYPE(x) x,
+
+/// Type tag of a heap object. Every object type has a static `objectType`
+/// member with its tag. Types defined outside of the vm get tags after
+/// `FirstRegistered` from `registerObjectType`
+enum class ObjectType : uint8_t { OBJECT_TYPE_LIST FirstRegistered };
+
+#undef OBJECT_TYPE
+
+/// Tag for an embedder type, for example
+/// `static inline const auto objectType = vm::registerObjectType("Image");`
+ObjectType registerObjectType(std::string_view name);
+
+std::string_view objectTypeName(ObjectType type);
+
+/// Base of all values that live on the heap. Objects are reference counted by
+/// the Values and Refs that point to them
 struct OtherValueContent {
     virtual ~OtherValueContent() = default;
+
+    static void *operator new(size_t size) {
+        return gc::allocate(size);
+    }
+
+    static void operator delete(void *pointer, size_t size) {
+        gc::deallocate(pointer, size);
+    }
+
+    uint32_t references = 0;
+
+    /// Set by `make`
+    ObjectType type = ObjectType::FirstRegistered;
+
+    /// Set for containers that the cycle collector keeps track of
+    bool tracked = false;
 };
 
-struct OtherValue {
-    decltype(typeid(void).hash_code()) type = typeid(void).hash_code();
-    std::string_view tName = typeid(void).name();
+struct Value;
 
-    template <typename T>
-    void set(std::shared_ptr<T> ptr) {
-        type = typeid(T).hash_code();
-        tName = typeid(T).name();
-        _content = ptr;
+/// Base of objects that hold Values. Containers made with `make` are tracked
+/// by the cycle collector, since they can be part of reference cycles
+struct Container : public OtherValueContent {
+    Container() = default;
+
+    /// Copies are not tracked until they are made by `make`
+    Container(const Container &)
+        : OtherValueContent{} {}
+
+    Container &operator=(const Container &) {
+        return *this;
+    }
+
+    ~Container() override;
+
+    /// Call `visit` for every Value that the object holds
+    virtual void trace(const std::function<void(Value &)> &visit) = 0;
+
+private:
+    friend class Heap;
+
+    Container *_previous = nullptr;
+    Container *_next = nullptr;
+
+    /// References from outside of the collected generations, during a
+    /// collection
+    uint32_t _externalReferences = 0;
+
+    uint8_t _generation = 0;
+    bool _reachable = false;
+};
+
+namespace gc {
+
+/// Start tracking a new container, and collect if enough containers were
+/// made since the last collection
+void track(Container *container);
+
+} // namespace gc
+
+/// Delete an object whose last reference is gone. Built in types are deleted
+/// without a virtual call
+void destroy(OtherValueContent *object);
+
+inline void retain(OtherValueContent *object) {
+    if (object) {
+        ++object->references;
+    }
+}
+
+inline void release(OtherValueContent *object) {
+    if (object && --object->references == 0) {
+        destroy(object);
+    }
+}
+
+template <typename T>
+concept InheritsOther = std::is_base_of_v<OtherValueContent, T> &&
+                        requires { ObjectType{T::objectType}; };
+
+/// Owning pointer to a heap object, that shares the reference count with Value
+template <typename T>
+class Ref {
+public:
+    Ref() = default;
+    Ref(std::nullptr_t) {}
+
+    explicit Ref(T *object)
+        : _object{object} {
+        retain(_object);
+    }
+
+    Ref(const Ref &other)
+        : Ref{other._object} {}
+
+    Ref(Ref &&other)
+        : _object{std::exchange(other._object, nullptr)} {}
+
+    Ref &operator=(Ref other) {
+        std::swap(_object, other._object);
+        return *this;
     }
 
-    const std::shared_ptr<OtherValueContent> content() {
-        return _content;
+    ~Ref() {
+        release(_object);
+    }
+
+    T *get() const {
+        return _object;
+    }
+
+    T *operator->() const {
+        return _object;
+    }
+
+    T &operator*() const {
+        return *_object;
+    }
+
+    explicit operator bool() const {
+        return _object;
     }
 
 private:
-    std::shared_ptr<OtherValueContent> _content;
+    T *_object = nullptr;
 };
 
-using OtherPtr = std::shared_ptr<OtherValueContent>;
+/// Create a heap object that can be stored in a Value
+template <InheritsOther T, typename... Args>
+Ref<T> make(Args &&...args) {
+    auto object = Ref<T>{new T(std::forward<Args>(args)...)};
+    object->type = T::objectType;
+    if constexpr (std::is_base_of_v<Container, T>) {
+        gc::track(object.get());
+    }
+    return object;
+}
 
 struct String {
     std::string value;
@@ -73,214 +227,708 @@ template <typename T>
 concept IntegralTypes =
     std::same_as<T, Int> || std::same_as<T, Float> || std::same_as<T, Bool>;
 
-template <typename T>
-concept InheritsOther = std::is_base_of_v<OtherValueContent, T>;
+/// Strings and ints that do not fit in a Value are stored on the heap
+struct StringObject final : public OtherValueContent {
+    static constexpr auto objectType = ObjectType::StringObject;
 
-struct Value {
-    std::variant<Void, String, Int, Float, Bool, OtherValue> value;
+    explicit StringObject(String string)
+        : string{std::move(string)} {}
 
-    Value() = default;
+    String string;
+};
 
-    template <BuiltinTypes T>
-    Value(const T &value)
+struct IntObject final : public OtherValueContent {
+    static constexpr auto objectType = ObjectType::IntObject;
+
+    explicit IntObject(int64_t value)
         : value{value} {}
 
-    template <InheritsOther T>
-    Value(std::shared_ptr<T> v) {
-        auto o = OtherValue{};
-        o.set(v);
-        value = std::move(o);
+    int64_t value;
+};
+
+/// A value is 8 bytes, NaN-boxed: doubles are stored as they are, and the
+/// other types use the NaN bit patterns that arithmetic never produces. The top
+/// 16 bits are the tag and the lower 48 bits the payload. Ints outside of 48
+/// bits and strings are stored as objects
+struct Value {
+    Value() = default;
+
+    Value(const String &value)
+        : Value{make<StringObject>(value)} {}
+
+    Value(Int value) {
+        if (value.value >= minImmediateInt && value.value <= maxImmediateInt) {
+            _bits = intTag | (static_cast<uint64_t>(value.value) & payloadMask);
+        }
+        else {
+            *this = Value{make<IntObject>(value.value)};
+        }
     }
 
-    Value(const Value &) = default;
+    Value(Float value) {
+        if (value.value != value.value) {
+            _bits = canonicalNan;
+        }
+        else {
+            std::memcpy(&_bits, &value.value, sizeof(_bits));
+        }
+    }
+
+    Value(Bool value)
+        : _bits{boolTag | value.value} {}
 
     template <InheritsOther T>
-    Value &operator=(std::shared_ptr<T> v) {
-        auto o = OtherValue{};
-        o.set(v);
-        value = std::move(o);
+    Value(const Ref<T> &object)
+        : _bits{objectTag | reinterpret_cast<uint64_t>(
+                                static_cast<OtherValueContent *>(
+                                    object.get()))} {
+        retain(this->object());
+    }
 
+    Value(const Value &other)
+        : _bits{other._bits} {
+        retain(object());
+    }
+
+    Value(Value &&other)
+        : _bits{std::exchange(other._bits, voidBits)} {}
+
+    Value &operator=(Value other) {
+        std::swap(_bits, other._bits);
         return *this;
     }
 
+    ~Value() {
+        release(object());
+    }
+
     template <InheritsOther T>
-    T &as() {
-        if (!std::holds_alternative<OtherValue>(value)) {
+    T &as() const {
+        auto o = object();
+        if (!o) {
             throw std::runtime_error{"Cannot convert value to function"};
         }
 
-        auto &o = std::get<OtherValue>(value);
-        auto hash = typeid(T).hash_code();
-        if (o.type != hash) {
-            throw std::runtime_error{"Cannot convert value to function " +
-                                     std::string{o.tName} + " to " +
-                                     std::string{typeid(T).name()}};
+        if (o->type != T::objectType) {
+            throwWrongType(o->type, T::objectType);
         }
 
-        return static_cast<T &>(*o.content());
+        return static_cast<T &>(*o);
     }
 
+    /// Strings are returned by reference, the immediate types by value
     template <BuiltinTypes T>
-    T &as() {
-        if (!std::holds_alternative<T>(value)) {
+    auto as() const -> std::conditional_t<std::same_as<T, String>, T &, T> {
+        if (!is<T>()) {
             throw std::runtime_error{"Cannot convert value to float"};
         }
 
-        return std::get<T>(value);
-    }
-
-    template <InheritsOther T>
-    bool is() {
-        if (std::holds_alternative<OtherValue>(value)) {
-            if (std::get<OtherValue>(value).type == typeid(T).hash_code()) {
-                return true;
+        if constexpr (std::same_as<T, String>) {
+            return static_cast<StringObject *>(object())->string;
+        }
+        else if constexpr (std::same_as<T, Int>) {
+            if (tag() == intTag) {
+                // Sign extend the 48 bit payload
+                return Int{static_cast<int64_t>(_bits << 16) >> 16};
             }
+            return Int{static_cast<IntObject *>(object())->value};
+        }
+        else if constexpr (std::same_as<T, Float>) {
+            auto value = Float{};
+            std::memcpy(&value.value, &_bits, sizeof(_bits));
+            return value;
+        }
+        else {
+            return Bool{static_cast<bool>(_bits & 1)};
         }
+    }
 
-        return false;
+    template <InheritsOther T>
+    bool is() const {
+        auto o = object();
+        return o && o->type == T::objectType;
     }
 
     template <BuiltinTypes T>
-    bool is() {
-        if (std::holds_alternative<T>(value)) {
-            return true;
+    bool is() const {
+        if constexpr (std::same_as<T, String>) {
+            return is<StringObject>();
+        }
+        else if constexpr (std::same_as<T, Int>) {
+            return tag() == intTag || is<IntObject>();
+        }
+        else if constexpr (std::same_as<T, Float>) {
+            return _bits < voidBits;
+        }
+        else {
+            return tag() == boolTag;
         }
-
-        return false;
     }
 
     template <IsVoid T>
-    bool is() {
-        return std::holds_alternative<T>();
+    bool is() const {
+        return _bits == voidBits;
+    }
+
+    /// Ints that are stored in the value itself and not on the heap
+    bool isImmediateInt() const {
+        return tag() == intTag;
+    }
+
+    /// The heap object, or null for immediate values. Pointers on the
+    /// supported platforms fit in 48 bits
+    OtherValueContent *object() const {
+        if (tag() != objectTag) {
+            return nullptr;
+        }
+        return reinterpret_cast<OtherValueContent *>(_bits & payloadMask);
     }
 
-    bool asBool() {
-        if (std::holds_alternative<Int>(value)) {
-            return std::get<Int>(value).value;
+    bool asBool() const {
+        if (is<Int>()) {
+            return as<Int>().value;
         }
-        if (std::holds_alternative<Bool>(value)) {
-            return std::get<Bool>(value).value;
+        if (is<Bool>()) {
+            return as<Bool>().value;
         }
-        if (std::holds_alternative<Float>(value)) {
-            return std::get<Float>(value).value;
+        if (is<Float>()) {
+            return as<Float>().value;
         }
 
         throw std::runtime_error{"Type is not convertible to bool"};
     }
+
+    // The representation, for code that works on the bits directly like the
+    // jit. Floats are all values below `voidBits`
+
+    static constexpr uint64_t voidBits = 0xFFF9'0000'0000'0000;
+    static constexpr uint64_t boolTag = 0xFFFA'0000'0000'0000;
+    static constexpr uint64_t intTag = 0xFFFB'0000'0000'0000;
+    static constexpr uint64_t objectTag = 0xFFFC'0000'0000'0000;
+    static constexpr uint64_t tagMask = 0xFFFF'0000'0000'0000;
+    static constexpr uint64_t payloadMask = ~tagMask;
+    static constexpr uint64_t canonicalNan = 0x7FF8'0000'0000'0000;
+
+    static constexpr int64_t maxImmediateInt = (int64_t{1} << 47) - 1;
+    static constexpr int64_t minImmediateInt = -(int64_t{1} << 47);
+
+    uint64_t bits() const {
+        return _bits;
+    }
+
+private:
+    /// Out of line so that the error message is not built in every `as`
+    [[noreturn]] static void throwWrongType(ObjectType actual,
+                                            ObjectType expected);
+
+    uint64_t tag() const {
+        return _bits & tagMask;
+    }
+
+
+    uint64_t _bits = voidBits;
+};
+
+static_assert(sizeof(Value) == 8);
+
+/// Position of a variable found by the resolver: `depth` scopes out from the
+/// current one, at index `slot` in that scope
+struct SlotAddress {
+    static constexpr uint32_t unresolved = UINT32_MAX;
+
+    uint32_t depth = 0;
+    uint32_t slot = unresolved;
+
+    bool isResolved() const {
+        return slot != unresolved;
+    }
+};
+
+class Frame;
+struct Context;
+struct Function;
+
+/// Runs the script functions that native functions call, like the function
+/// given to `map`, so that they run in the same engine as the rest of the
+/// script
+struct Engine {
+    virtual Value call(const Function &f, Frame &frame, Context &context) = 0;
+
+protected:
+    ~Engine() = default;
 };
 
 struct Context {
+    /// Variables looked up by name, like module members and `std`. Can be null
     struct Map *closure = nullptr;
 
+    /// The enclosing scope. For function calls this is the module context, so
+    /// that functions only see their own variables and the module variables,
+    /// wherever they are called from. Null for the module itself
     Context *parent = nullptr;
 
-    Value &at(const Token &name);
+    /// Variables of this scope, indexed by slot. In a function call the frame
+    /// starts with `this` and the arguments
+    std::span<Value> slots;
+
+    /// Set by `return`. Shared by a function call and its loop scopes
+    bool *returning = nullptr;
+
+    /// Set on the root context by engines other than the tree interpreter
+    Engine *engine = nullptr;
+
+    /// The outermost context, which holds the module and its variables
+    Context &root() {
+        auto context = this;
+        while (context->parent) {
+            context = context->parent;
+        }
+        return *context;
+    }
+
+    /// `this` in the frame of a function call
+    Value &self() {
+        return slots[0];
+    }
+
+    /// Argument `index` in the frame of a function call
+    Value &argument(size_t index) {
+        return slots[1 + index];
+    }
+
+    /// Search the closures of this and all parent contexts
+    Value &at(Symbol name);
+
+    Value &at(SlotAddress address) {
+        auto context = this;
+        for (auto i = address.depth; i > 0; --i) {
+            context = context->parent;
+        }
+        return context->slots[address.slot];
+    }
 };
 
+// clang-format off
+#define NODE_LIST \
+    NODE(VariableDeclaration) \
+    NODE(DestructuringDeclaration) \
+    NODE(Assignment) \
+    NODE(CompoundAssignment) \
+    NODE(BinaryOperation) \
+    NODE(UnaryOperation) \
+    NODE(VariableAccessor) \
+    NODE(FunctionCall) \
+    NODE(StringLiteral) \
+    NODE(Constant) \
+    NODE(ArrayDeclaration) \
+    NODE(DictionaryDeclaration) \
+    NODE(ForDeclaration) \
+    NODE(IndexAccessor) \
+    NODE(MemberFunctionCall) \
+    NODE(FunctionDeclaration) \
+    NODE(IfStatement) \
+    NODE(ReturnStatement) // clang-format on
+
+#define NODE(x) x,
+
+/// Every type of syntax node in commands.h
+enum class NodeKind : uint8_t { NODE_LIST };
+
+#undef NODE
+
 struct Expression {
-    virtual ~Expression() = default;
+    /// Start of the statement in the source. Only set for the statements of
+    /// sections, which is where the script profiler counts
+    SourceLocation location;
+
+    /// Index of the statement's counts in the script profiler, zero until it
+    /// has been counted
+    uint32_t profileIndex = 0;
+
     virtual Value run(struct Context &context) = 0;
+    virtual NodeKind kind() const = 0;
+
+    /// Store a value in the variable or element that the expression refers to.
+    /// Used for the left side of assignments
+    virtual void assign(Context &context, Value value) {
+        throw std::runtime_error{"expression is not assignable"};
+    }
+
+protected:
+    /// Not virtual. Nodes are never deleted through a base pointer, and the
+    /// arena frees them without running any destructors
+    ~Expression() = default;
 };
 
+/// Syntax nodes are owned by the Arena of the module that they were parsed in
 struct Section {
-    std::vector<std::shared_ptr<Expression>> commands;
+    std::span<Expression *> commands;
+
+    /// Number of variables declared in the scope, set by the resolver
+    uint32_t slotCount = 0;
+
+    /// Byte code of the section in the interpreter with id `chunkOwner`, so
+    /// that calls do not have to look it up. Not saved in the module cache
+    mutable bytecode::Chunk *chunk = nullptr;
+    mutable uint32_t chunkOwner = 0;
 };
 
-struct Function : public OtherValueContent {
+struct Function final : public OtherValueContent {
+    static constexpr auto objectType = ObjectType::Function;
+
     using FunctionType = Value (*)(Context &);
 
     Function() = default;
-    Function(std::vector<Token> args, FunctionType f)
+    Function(std::vector<Symbol> args, FunctionType f)
         : argumentNames{std::move(args)}
+        , argumentCount{static_cast<uint32_t>(argumentNames.size())}
         , native{f} {}
 
-    std::vector<Token> argumentNames;
+    /// For profiles. Empty for functions made directly by C++ code
+    Symbol name;
+
+    /// Not needed for native functions
+    std::vector<Symbol> argumentNames;
 
-    std::shared_ptr<Section> body;
+    /// Number of arguments that are stored in the frame of a call
+    uint32_t argumentCount = 0;
+
+    const Section *body = nullptr;
 
     FunctionType native = nullptr;
+
+    /// `main` of a module. Its frame holds the variables of the module, and
+    /// it runs in a root context of its own, where the functions of the module
+    /// find them
+    bool module = false;
 };
 
-struct Map : public OtherValueContent {
-    struct Declaration {
-        Token name;
-        Value value;
-    };
+/// Member layout of a Map: the member names in slot order. Maps that get the
+/// same members in the same order share one shape, so a shape pointer can be
+/// used to check that a member is still in the same slot
+class Shape {
+public:
+    static constexpr uint32_t notFound = UINT32_MAX;
 
-    std::vector<Declaration> values;
+    Shape(const Shape &) = delete;
+    Shape &operator=(const Shape &) = delete;
 
-    Value protoype;
+    /// The shape of new maps, which all other shapes are derived from
+    static Shape *empty();
 
-    Value &operator[](const Token &name) {
-        for (auto &it : values) {
-            if (it.name == name.text) {
-                return it.value;
+    uint32_t find(Symbol name) const {
+        for (uint32_t i = 0; i < _names.size(); ++i) {
+            if (_names[i] == name) {
+                return i;
             }
         }
+        return notFound;
+    }
+
+    /// The shape with `name` added as the last slot. Shapes are never freed
+    Shape *withMember(Symbol name);
+
+    std::span<const Symbol> names() const {
+        return _names;
+    }
+
+private:
+    Shape() = default;
+
+    std::vector<Symbol> _names;
+    std::unordered_map<uint32_t, std::unique_ptr<Shape>> _transitions;
+};
+
+/// Remembers the shape and slot that a member access site found last time
+struct MemberCache {
+    const Shape *shape = nullptr;
+    uint32_t slot = 0;
+};
+
+struct Map final : public Container {
+    static constexpr auto objectType = ObjectType::Map;
+
+    void trace(const std::function<void(Value &)> &visit) override {
+        for (auto &value : values) {
+            visit(value);
+        }
+        visit(protoype);
+    }
+
+    Shape *shape = Shape::empty();
 
-        values.push_back({
-            .name = name,
-        });
-        return values.back().value;
+    /// Member values, indexed by the slots in `shape`
+    std::vector<Value> values;
+
+    Value protoype;
+
+    /// Find or add the member
+    Value &operator[](Symbol name) {
+        if (auto value = find(name)) {
+            return *value;
+        }
+
+        shape = shape->withMember(name);
+        return values.emplace_back();
     }
 
     template <typename T>
-    T &at(const Token &name) {
-        for (auto &it : values) {
-            if (it.name == name.text) {
-                return it.value.as<T>();
-            }
+    T &at(Symbol name) {
+        return at(name).as<T>();
+    }
+
+    Value &at(Symbol name) {
+        if (auto value = find(name)) {
+            return *value;
         }
 
-        throw std::runtime_error{"could not find member " + name.text +
-                                 " in map"};
+        throw missingMember(name);
     }
 
-    Value &at(const Token &name) {
-        for (auto &it : values) {
-            if (it.name == name.text) {
-                return it.value;
+    /// Same as `at(name)`, but skips the search while the shape is the same
+    /// as the last time `cache` was used
+    Value &at(Symbol name, MemberCache &cache) {
+        if (cache.shape != shape) {
+            auto slot = shape->find(name);
+            if (slot == Shape::notFound) {
+                throw missingMember(name);
             }
+            cache = {.shape = shape, .slot = slot};
         }
 
-        throw std::runtime_error{"could not find member " + name.text +
-                                 " in map"};
+        return values[cache.slot];
     }
 
-    Value *find(const Token &name) {
-        for (auto &it : values) {
-            if (it.name == name.text) {
-                return &it.value;
-            }
+    Value *find(Symbol name) {
+        auto slot = shape->find(name);
+        if (slot == Shape::notFound) {
+            return nullptr;
         }
 
-        return {};
+        return &values[slot];
     }
 
     // Create a variable and expect it to not exist
-    Value &define(const Token &name) {
-        for (auto &v : values) {
-            if (v.name == name.text) {
-                std::runtime_error{"variable already exists"};
-            }
+    Value &define(Symbol name) {
+        if (find(name)) {
+            throw std::runtime_error{"variable already exists"};
         }
 
-        values.push_back({name});
-        return values.back().value;
+        return (*this)[name];
+    }
+
+private:
+    static std::runtime_error missingMember(Symbol name) {
+        return std::runtime_error{"could not find member " +
+                                  std::string{name.text()} + " in map"};
     }
 };
 
-struct Array : public OtherValueContent {
-    std::vector<Value> values;
+/// Items are packed while they all have the same type: ints and floats as
+/// plain numbers, and strings after each other in one buffer. The first item
+/// of another type moves all items to Values. An empty array takes the type
+/// of its first item
+struct Array final : public Container {
+    static constexpr auto objectType = ObjectType::Array;
+
+    enum class Storage : uint8_t {
+        Empty,
+        Int,
+        Float,
+        String,
+        Values,
+    };
+
+    void trace(const std::function<void(Value &)> &visit) override {
+        for (auto &value : _values) {
+            visit(value);
+        }
+    }
+
+    Storage storage() const {
+        return _storage;
+    }
+
+    size_t size() const {
+        switch (_storage) {
+        case Storage::Empty:
+            return 0;
+        case Storage::Int:
+        case Storage::String:
+            return _ints.size();
+        case Storage::Float:
+            return _floats.size();
+        case Storage::Values:
+            return _values.size();
+        }
+        return 0;
+    }
+
+    /// Not bounds checked. Strings are copied to a new value
+    Value at(size_t index) const {
+        switch (_storage) {
+        case Storage::Int:
+            return Int{_ints[index]};
+        case Storage::Float:
+            return Float{_floats[index]};
+        case Storage::String:
+            return String{std::string{string(index)}};
+        default:
+            return _values[index];
+        }
+    }
+
+    /// Not bounds checked
+    void set(size_t index, Value value);
+
+    void push(Value value);
+
+    /// Reorder the items so that item `i` is the old item `order[i]`
+    void permute(std::span<const size_t> order);
+
+    /// Packed items. Empty when the array has another storage
+    std::span<int64_t> ints() {
+        return _storage == Storage::Int ? std::span{_ints}
+                                        : std::span<int64_t>{};
+    }
+
+    std::span<const int64_t> ints() const {
+        return _storage == Storage::Int ? std::span{_ints}
+                                        : std::span<const int64_t>{};
+    }
+
+    std::span<double> floats() {
+        return _storage == Storage::Float ? std::span{_floats}
+                                          : std::span<double>{};
+    }
+
+    std::span<const double> floats() const {
+        return _storage == Storage::Float ? std::span{_floats}
+                                          : std::span<const double>{};
+    }
+
+    /// Items of an array with Values storage, empty for the others
+    std::span<Value> values() {
+        return _values;
+    }
+
+    std::span<const Value> values() const {
+        return _values;
+    }
+
+    /// Packed string `index`
+    std::string_view string(size_t index) const {
+        auto begin = index ? _ints[index - 1] : 0;
+        return {_chars.data() + begin, _chars.data() + _ints[index]};
+    }
+
+    /// Bytes allocated for the items, without strings that are objects
+    size_t memory() const;
+
+private:
+    /// Move the items to `_values`
+    void unpack();
+
+    Storage _storage = Storage::Empty;
+
+    /// Int items, or where each string ends in `_chars`
+    std::vector<int64_t> _ints;
+    std::vector<double> _floats;
+    std::vector<char> _chars;
+    std::vector<Value> _values;
+};
+
+/// `std.range(begin, end)`, the integers from `begin` up to but not including
+/// `end`. Loops count through it without calling anything
+struct Range final : public OtherValueContent {
+    static constexpr auto objectType = ObjectType::Range;
+
+    Range(int64_t begin, int64_t end)
+        : begin{begin}
+        , end{end} {}
+
+    int64_t begin = 0;
+    int64_t end = 0;
+};
+
+/// Position of a loop in an array. Items pushed during the loop are included
+struct ArrayIterator final : public OtherValueContent {
+    static constexpr auto objectType = ObjectType::ArrayIterator;
+
+    explicit ArrayIterator(Value array)
+        : array{std::move(array)} {}
+
+    Value array;
+    size_t index = 0;
 };
 
 Value call(const Section &section, Context &context);
 
+/// Slots taken from a stack that is reused between calls, for function calls
+/// and loop scopes. Frames have to be destroyed in the reverse order of
+/// creation, which scoped variables do by themselves
+class Frame {
+public:
+    explicit Frame(size_t size);
+    ~Frame();
+
+    Frame(const Frame &) = delete;
+    Frame &operator=(const Frame &) = delete;
+
+    std::span<Value> slots;
+};
+
+/// Slots needed to call `f`: `this`, the arguments and the local variables
+inline size_t frameSize(const Function &f) {
+    return f.body ? f.body->slotCount : 1 + f.argumentCount;
+}
+
+/// Call `f` with `this` and the arguments already stored in `frame`, which has
+/// at least `frameSize(f)` slots
+Value call(const Function &f, Frame &frame, Context &context);
+
+/// Copy `self` and `values` into a new frame and call `f`, with the engine of
+/// `context`. For native functions that call script functions
 Value call(const Function &f,
-           std::vector<Value> values,
+           std::span<const Value> values,
            Context &context,
            Value self = {});
 
-const std::shared_ptr<Map> &getStd();
+/// Bounds checked `array[index]`, or `dictionary[key]` which throws for
+/// missing keys
+Value element(const Value &array, const Value &index);
+
+/// Bounds checked `array[index] = value`, or `dictionary[key] = value` which
+/// adds missing keys
+void setElement(const Value &array, const Value &index, Value value);
+
+/// The map that `object.name(...)` finds `name` in: the map itself, or the
+/// methods of native types like Array and Dictionary
+Map &members(const Value &object);
+
+/// The iterator that a for loop advances for `range`. A range gets a copy that
+/// counts up and an array gets an ArrayIterator. Files are their own
+/// iterators, and so are maps, which are advanced by calling their `next`
+/// member until it returns void
+Value iterator(const Value &range);
+
+/// Set `value` to the next item of a native iterator. False when it is done.
+/// Maps are advanced by the caller, which knows how to call `next`
+bool advance(const Value &iterator, Value &value);
+
+/// Module map with `main` running `body`
+Ref<Map> createModule(const Section *body);
+
+/// Arithmetic and comparisons for binary operator tokens like `+` and `<`
+Value binaryOperation(TokenType op, const Value &left, const Value &right);
+
+/// Same type and value, for `count` and dictionary keys. Objects other than
+/// strings are the same when they are the same object
+bool same(const Value &a, const Value &b);
+
+/// Prefix `-` and `!`
+Value unaryOperation(TokenType op, Value value);
+
+const Ref<Map> &getStd();
 
 } // namespace vm
@@ -0,0 +1,42 @@
+#!/bin/sh
+# Runs every script with the tree interpreter, the byte code interpreter, the
+# jit for hot code and the jit compiling everything, and fails if the output
+# or the exit status differs from the .expected file next to the script
+#
+# Usage: scripttest.sh path/to/matscript script.msc...
+#
+# With UPDATE=1 the .expected files are written with the tree interpreter
+
+matscript=$1
+shift
+
+# stderr is left out, since the text of uncaught errors depends on the
+# standard library
+run() {
+    "$matscript" --no-cache "$@" 2>/dev/null
+    echo "exit status $?"
+}
+
+status=0
+for script in "$@"; do
+    expected=${script%.msc}.expected
+    if [ -n "$UPDATE" ]; then
+        run --engine=ast "$script" >"$expected"
+        continue
+    fi
+
+    for mode in "--engine=ast" \
+        "--engine=bytecode --jit=off" \
+        "--engine=bytecode --jit=on" \
+        "--engine=bytecode --jit=always"; do
+        # $mode is split into its options on purpose
+        actual=$(run $mode "$script")
+        if [ "$actual" != "$(cat "$expected")" ]; then
+            echo "$script: $mode differs from $expected"
+            printf '%s\n' "$actual" | diff "$expected" -
+            status=1
+        fi
+    done
+done
+
+exit $status